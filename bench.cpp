@@ -0,0 +1,731 @@
+// Microbenchmarks and macrobenchmarks over the fonts bundled in test/.
+//
+//   swiftglyph_bench [-filter text] [-min-time seconds] [-threads n] [-out file] [-fonts dir] [-scratch dir]
+//
+// Every benchmark runs once to warm up, then repeatedly until both -min-time and
+// kMinIterations are reached.  Inputs are fixed, so runs on the same machine are
+// comparable.  Progress goes to stderr and the results are written as json to
+// stdout, or to -out.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+#include "raster.h"
+#include "kerning.h"
+#include "pack.h"
+#include "sdf.h"
+#include "metrics.h"
+#include "mip.h"
+#include "png.h"
+#include "tga.h"
+#include "pixels.h"
+#include "mapfile.h"
+#include "sgfont.h"
+#include "sglayout.h"
+#include "bbq.h"
+
+#ifndef SWIFTGLYPH_TEST_DIR
+#define SWIFTGLYPH_TEST_DIR "test"
+#endif
+
+static const int kMinIterations = 5;
+static const int kPixels = 32;
+static const int kAtlasWidth = 512;
+
+struct BenchSettings
+{
+    std::string filter;
+    double minSeconds;
+    int numThreads;
+};
+
+struct BenchResult
+{
+    std::string name;
+    int iterations;
+    double minNs;
+    double medianNs;
+    double meanNs;
+    double items;           // work done by one iteration, in unit
+    const char* unit;
+};
+
+static std::vector<BenchResult> s_results;
+
+// times fn, items is how much work one call does so the json can report a rate.
+static void Run(const BenchSettings& settings, const std::string& name, double items, const char* unit,
+                const std::function<void()>& fn)
+{
+    if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos)
+        return;
+
+    typedef std::chrono::steady_clock Clock;
+    fn();
+    std::vector<double> times;
+    const Clock::time_point start = Clock::now();
+    while ((int)times.size() < kMinIterations ||
+           std::chrono::duration<double>(Clock::now() - start).count() < settings.minSeconds)
+    {
+        const Clock::time_point t0 = Clock::now();
+        fn();
+        times.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = (int)times.size();
+    std::sort(times.begin(), times.end());
+    result.minNs = times[0];
+    result.medianNs = times[times.size() / 2];
+    double total = 0.0;
+    for (size_t i = 0; i < times.size(); ++i)
+        total += times[i];
+    result.meanNs = total / times.size();
+    result.items = items;
+    result.unit = unit;
+    s_results.push_back(result);
+
+    fprintf(stderr, "%-40s %12.1f us %14.0f %s/s\n", name.c_str(), result.medianNs / 1000.0,
+            items * 1e9 / result.medianNs, unit);
+}
+
+static bool WriteResults(FILE* fp, const BenchSettings& settings)
+{
+    fprintf(fp, "{\n");
+    fprintf(fp, "    \"threads\": %d,\n", settings.numThreads);
+    fprintf(fp, "    \"min_time\": %g,\n", settings.minSeconds);
+    fprintf(fp, "    \"benchmarks\": [\n");
+    for (size_t i = 0; i < s_results.size(); ++i)
+    {
+        const BenchResult& r = s_results[i];
+        fprintf(fp, "        { \"name\": \"%s\", \"iterations\": %d, \"min_ns\": %.0f, \"median_ns\": %.0f, "
+                "\"mean_ns\": %.0f, \"items\": %.0f, \"unit\": \"%s\", \"items_per_second\": %.1f }%s\n",
+                r.name.c_str(), r.iterations, r.minNs, r.medianNs, r.meanNs, r.items, r.unit,
+                r.items * 1e9 / r.medianNs, (i + 1 == s_results.size()) ? "" : ",");
+    }
+    fprintf(fp, "    ]\n");
+    fprintf(fp, "}\n");
+    return ferror(fp) == 0;
+}
+
+//
+// the structures bbq-burn generates from test/font.dd.  The bbq tools aren't
+// available here, so the bench cooks its own file in the layout bbq_load expects.
+// Pointers are read with BBQ_PTR.
+//
+
+struct BbqGlyphMetrics
+{
+    uint32_t codepoint;
+    uint32_t char_index;
+    float xy_lower_left[2];
+    float xy_upper_right[2];
+    float uv_lower_left[2];
+    float uv_upper_right[2];
+    float advance[2];
+};
+
+struct BbqGlyphKerning
+{
+    uint32_t first_index;
+    uint32_t second_index;
+    float kerning[2];
+};
+
+struct BbqFont
+{
+    int32_t texture_width;
+    const char* texture_filename;
+    uint32_t glyph_metrics_array_size;
+    BbqGlyphMetrics* glyph_metrics_array;
+    uint32_t glyph_kerning_array_size;
+    BbqGlyphKerning* glyph_kerning_array;
+};
+
+// the array checks test.c makes after loading.
+static bool CheckBbq(const BbqFont* font)
+{
+    return bbq_check_array(font, font, 1, sizeof(BbqFont)) &&
+           bbq_check_array(font, BBQ_PTR(BbqGlyphMetrics, font->glyph_metrics_array),
+                           font->glyph_metrics_array_size, sizeof(BbqGlyphMetrics)) &&
+           bbq_check_array(font, BBQ_PTR(BbqGlyphKerning, font->glyph_kerning_array),
+                           font->glyph_kerning_array_size, sizeof(BbqGlyphKerning));
+}
+
+static void PutSlot(std::vector<unsigned char>* data, size_t slot, size_t target)
+{
+    // pointers are stored relative to themselves, see bbq_resolve
+    int32_t relative = (int32_t)(target - slot);
+    memcpy(&(*data)[slot], &relative, sizeof(relative));
+}
+
+// num_offsets, the offset of every pointer in the data, num_offsets again, then the data.
+static bool CookBbq(const char* filename, const std::vector<GlyphInfo>& glyphs, float line_height,
+                    const std::vector<KerningPair>& kerning)
+{
+    const size_t glyphStart = sizeof(BbqFont);
+    const size_t kerningStart = glyphStart + glyphs.size() * sizeof(BbqGlyphMetrics);
+    const size_t filenameStart = kerningStart + kerning.size() * sizeof(BbqGlyphKerning);
+    const char* textureFilename = "bench.raw";
+    std::vector<unsigned char> data(filenameStart + strlen(textureFilename) + 1, 0);
+
+    BbqFont font;
+    memset(&font, 0, sizeof(font));
+    font.texture_width = kAtlasWidth;
+    font.glyph_metrics_array_size = (uint32_t)glyphs.size();
+    font.glyph_kerning_array_size = (uint32_t)kerning.size();
+    memcpy(&data[0], &font, sizeof(font));
+    PutSlot(&data, offsetof(BbqFont, texture_filename), filenameStart);
+    PutSlot(&data, offsetof(BbqFont, glyph_metrics_array), glyphStart);
+    PutSlot(&data, offsetof(BbqFont, glyph_kerning_array), kerningStart);
+
+    for (size_t i = 0; i < glyphs.size(); ++i)
+    {
+        BbqGlyphMetrics m;
+        m.codepoint = glyphs[i].codepoint;
+        m.char_index = glyphs[i].ftGlyphIndex;
+        m.xy_lower_left[0] = glyphs[i].xy_lower_left.x;
+        m.xy_lower_left[1] = glyphs[i].xy_lower_left.y;
+        m.xy_upper_right[0] = glyphs[i].xy_upper_right.x;
+        m.xy_upper_right[1] = glyphs[i].xy_upper_right.y;
+        m.uv_lower_left[0] = glyphs[i].uv_lower_left.x;
+        m.uv_lower_left[1] = glyphs[i].uv_lower_left.y;
+        m.uv_upper_right[0] = glyphs[i].uv_upper_right.x;
+        m.uv_upper_right[1] = glyphs[i].uv_upper_right.y;
+        m.advance[0] = glyphs[i].advance.x;
+        m.advance[1] = glyphs[i].advance.y;
+        memcpy(&data[glyphStart + i * sizeof(m)], &m, sizeof(m));
+    }
+    for (size_t k = 0; k < kerning.size(); ++k)
+    {
+        BbqGlyphKerning g;
+        g.first_index = glyphs[kerning[k].first].ftGlyphIndex;
+        g.second_index = glyphs[kerning[k].second].ftGlyphIndex;
+        g.kerning[0] = FIXED_TO_FLOAT(kerning[k].kerning.x) / line_height;
+        g.kerning[1] = FIXED_TO_FLOAT(kerning[k].kerning.y) / line_height;
+        memcpy(&data[kerningStart + k * sizeof(g)], &g, sizeof(g));
+    }
+    memcpy(&data[filenameStart], textureFilename, strlen(textureFilename));
+
+    const uint32_t header[5] =
+    {
+        3, (uint32_t)offsetof(BbqFont, texture_filename), (uint32_t)offsetof(BbqFont, glyph_metrics_array),
+        (uint32_t)offsetof(BbqFont, glyph_kerning_array), 3
+    };
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header) &&
+        fwrite(&data[0], 1, data.size(), fp) == data.size();
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok;
+}
+
+//
+// the text layout of test/test.c, with the quads written to memory instead of OpenGL
+//
+
+static const int TAB_SIZE = 4;
+
+static const BbqGlyphMetrics* BinarySearchGlyphMetrics(const BbqFont* font, unsigned int codepoint)
+{
+    const BbqGlyphMetrics* glyphs = BBQ_PTR(BbqGlyphMetrics, font->glyph_metrics_array);
+    unsigned int lo = 0;
+    unsigned int hi = font->glyph_metrics_array_size;
+    while (lo < hi)
+    {
+        unsigned int mid = lo + (hi - lo) / 2;
+        if (glyphs[mid].codepoint < codepoint)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < font->glyph_metrics_array_size && glyphs[lo].codepoint == codepoint)
+        return glyphs + lo;
+    return 0;
+}
+
+static const BbqGlyphMetrics* FindGlyphMetrics(const BbqFont* font, unsigned int codepoint)
+{
+    const BbqGlyphMetrics* glyph = BinarySearchGlyphMetrics(font, codepoint);
+    if (!glyph)
+        glyph = BinarySearchGlyphMetrics(font, '?');
+    return glyph;
+}
+
+static unsigned int NextCodepoint(const char** p)
+{
+    const unsigned char* s = (const unsigned char*)*p;
+    unsigned int c = s[0];
+    int length = 1;
+    if (c >= 0xf0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80 && (s[3] & 0xc0) == 0x80)
+    {
+        c = ((c & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) | (s[3] & 0x3f);
+        length = 4;
+    }
+    else if (c >= 0xe0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80)
+    {
+        c = ((c & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+        length = 3;
+    }
+    else if (c >= 0xc0 && (s[1] & 0xc0) == 0x80)
+    {
+        c = ((c & 0x1f) << 6) | (s[1] & 0x3f);
+        length = 2;
+    }
+    else if (c >= 0x80)
+    {
+        c = '?';
+    }
+    *p += length;
+    return c;
+}
+
+static void KerningLookup(const BbqFont* font, unsigned int curr_index, unsigned int next_index,
+                          float* kerning_x, float* kerning_y)
+{
+    const BbqGlyphKerning* pairs = BBQ_PTR(BbqGlyphKerning, font->glyph_kerning_array);
+    for (unsigned int i = 0; i < font->glyph_kerning_array_size; ++i)
+    {
+        if ((pairs[i].first_index == curr_index) &&
+            (pairs[i].second_index == next_index))
+        {
+            *kerning_x = pairs[i].kerning[0];
+            *kerning_y = pairs[i].kerning[1];
+            return;
+        }
+    }
+}
+
+// x, y, u, v for the 4 corners of the glyph
+static void EmitGlyph(float pen_x, float pen_y, const BbqGlyphMetrics* glyph, float* out)
+{
+    const float corners[4][4] =
+    {
+        { glyph->xy_lower_left[0], glyph->xy_lower_left[1], glyph->uv_lower_left[0], glyph->uv_lower_left[1] },
+        { glyph->xy_upper_right[0], glyph->xy_lower_left[1], glyph->uv_upper_right[0], glyph->uv_lower_left[1] },
+        { glyph->xy_upper_right[0], glyph->xy_upper_right[1], glyph->uv_upper_right[0], glyph->uv_upper_right[1] },
+        { glyph->xy_lower_left[0], glyph->xy_upper_right[1], glyph->uv_lower_left[0], glyph->uv_upper_right[1] }
+    };
+    for (int i = 0; i < 4; ++i)
+    {
+        out[i * 4 + 0] = pen_x + corners[i][0];
+        out[i * 4 + 1] = pen_y + corners[i][1];
+        out[i * 4 + 2] = corners[i][2];
+        out[i * 4 + 3] = corners[i][3];
+    }
+}
+
+// DrawString from test.c, returns the number of quads written.
+static size_t LayoutString(const BbqFont* font, const char* str, float* out)
+{
+    size_t quads = 0;
+    int cursor = 0;
+    float pen_x = 0;
+    float pen_y = 0;
+
+    const char* p = str;
+    unsigned int c = *p ? NextCodepoint(&p) : 0;
+    while (c)
+    {
+        unsigned int next = *p ? NextCodepoint(&p) : 0;
+        if (c == '\n')
+        {
+            pen_x = 0;
+            pen_y -= 1;
+            cursor = 0;
+        }
+        else if (c == 9)
+        {
+            int numSpaces = TAB_SIZE - (cursor % TAB_SIZE);
+            const BbqGlyphMetrics* curr = FindGlyphMetrics(font, ' ');
+            for (int i = 0; i < numSpaces; ++i)
+            {
+                EmitGlyph(pen_x, pen_y, curr, out + 16 * quads++);
+                pen_x += curr->advance[0];
+                pen_y += curr->advance[1];
+                cursor++;
+            }
+        }
+        else
+        {
+            const BbqGlyphMetrics* curr = FindGlyphMetrics(font, c);
+            EmitGlyph(pen_x, pen_y, curr, out + 16 * quads++);
+
+            float kerning_x = 0;
+            float kerning_y = 0;
+            if (next && !(next < 128 && isspace(next)))
+            {
+                const BbqGlyphMetrics* next_glyph = FindGlyphMetrics(font, next);
+                KerningLookup(font, curr->char_index, next_glyph->char_index, &kerning_x, &kerning_y);
+            }
+
+            pen_x += curr->advance[0] + kerning_x;
+            pen_y += curr->advance[1] + kerning_y;
+            cursor++;
+        }
+        c = next;
+    }
+    return quads;
+}
+
+//
+// atlas building blocks shared by the benchmarks
+//
+
+struct BenchFont
+{
+    std::string name;
+    MappedFile file;
+    FT_Library library;
+    FT_Face face;
+    std::vector<FT_UInt> glyphIndices;
+    std::vector<uint32_t> codepoints;
+    float line_height;
+};
+
+// printable ascii, the default swiftglyph character set
+static bool OpenFont(const std::string& directory, const char* name, BenchFont* font)
+{
+    font->name = name;
+    const std::string filename = directory + "/" + name + ".otf";
+    if (!MAP_Open(filename.c_str(), &font->file))
+    {
+        fprintf(stderr, "Error Loading Font \"%s\"\n", filename.c_str());
+        return false;
+    }
+    if (RASTER_OpenFace(font->file.data, font->file.size, kPixels, &font->library, &font->face))
+    {
+        fprintf(stderr, "Error Loading Font \"%s\"\n", filename.c_str());
+        MAP_Close(&font->file);
+        return false;
+    }
+    for (uint32_t c = 32; c <= 126; ++c)
+    {
+        FT_UInt index = FT_Get_Char_Index(font->face, c);
+        if (index)
+        {
+            font->codepoints.push_back(c);
+            font->glyphIndices.push_back(index);
+        }
+    }
+    font->line_height = FIXED_TO_FLOAT(font->face->size->metrics.height);
+    return true;
+}
+
+static void CloseFont(BenchFont* font)
+{
+    RASTER_CloseFace(font->library, font->face);
+    MAP_Close(&font->file);
+}
+
+static void MakeRects(const std::vector<GlyphBitmap>& bitmaps, std::vector<PackRect>* rects)
+{
+    rects->resize(bitmaps.size());
+    for (size_t i = 0; i < bitmaps.size(); ++i)
+    {
+        (*rects)[i].width = bitmaps[i].width + 2;
+        (*rects)[i].height = bitmaps[i].rows + 2;
+    }
+}
+
+// the metrics and coverage swiftglyph would produce with -padding 1
+static void BuildAtlas(const BenchFont& font, const std::vector<GlyphBitmap>& bitmaps,
+                       const std::vector<PackRect>& rects, std::vector<GlyphInfo>* glyphs,
+                       std::vector<unsigned char>* coverage)
+{
+    coverage->assign((size_t)kAtlasWidth * kAtlasWidth, 0);
+    glyphs->resize(bitmaps.size());
+    for (size_t i = 0; i < bitmaps.size(); ++i)
+    {
+        const GlyphBitmap& bitmap = bitmaps[i];
+        const PackRect& rect = rects[i];
+        for (int j = 0; j < bitmap.rows; ++j)
+            memcpy(&(*coverage)[(size_t)(rect.y + 1 + j) * kAtlasWidth + rect.x + 1],
+                   &bitmap.pixels[(size_t)j * bitmap.width], bitmap.width);
+
+        GlyphInfo& glyph = (*glyphs)[i];
+        glyph.ftGlyphIndex = font.glyphIndices[i];
+        glyph.codepoint = font.codepoints[i];
+        glyph.xy_lower_left = Vec2(FIXED_TO_FLOAT(bitmap.metrics.horiBearingX),
+                                   FIXED_TO_FLOAT(bitmap.metrics.horiBearingY - bitmap.metrics.height)) /
+            font.line_height;
+        glyph.xy_upper_right = glyph.xy_lower_left +
+            Vec2(FIXED_TO_FLOAT(bitmap.metrics.width), FIXED_TO_FLOAT(bitmap.metrics.height)) / font.line_height;
+        Vec2 upper_left = Vec2(rect.x, rect.y) / kAtlasWidth;
+        Vec2 lower_right = upper_left + Vec2(rect.width, rect.height) / kAtlasWidth;
+        glyph.uv_lower_left = Vec2(upper_left.x, 1.0f - lower_right.y);
+        glyph.uv_upper_right = Vec2(lower_right.x, 1.0f - upper_left.y);
+        glyph.advance = Vec2(FIXED_TO_FLOAT(bitmap.metrics.horiAdvance) / font.line_height, 0.0f);
+        glyph.rotated = false;
+    }
+}
+
+static const char* kSampleText =
+    "WoWAW\nHello\nWorld!\n"
+    "The quick brown fox jumps over the lazy dog.\n"
+    "\tAVAST Ye, To Wit: \"Yonder LT. Tyrell's Wagon\" (1999) = $42.07 & 98% {kerned}?\n"
+    "Sphinx of black quartz, judge my vow! 0123456789 [x*y] <a/b> ~_^|\\@#\n";
+
+static void BenchFontSuite(const BenchSettings& settings, BenchFont& font, const std::string& scratch)
+{
+    const int numGlyphs = (int)font.glyphIndices.size();
+    const std::string prefix = "/" + font.name + "/";
+
+    // rasterization
+    std::vector<GlyphBitmap> bitmaps(numGlyphs);
+    Run(settings, "raster" + prefix + "ascii_32px", numGlyphs, "glyphs", [&]() {
+        RASTER_RenderGlyphs(font.file.data, font.file.size, kPixels, &font.glyphIndices[0], numGlyphs,
+                            &bitmaps[0], settings.numThreads);
+    });
+    std::vector<GlyphBitmap> fields;
+    Run(settings, "sdf" + prefix + "ascii_32px_spread4", numGlyphs, "glyphs", [&]() {
+        fields = bitmaps;
+        for (int i = 0; i < numGlyphs; ++i)
+            SDF_Generate(&fields[i], 4);
+    });
+
+    // the kerning loop.  Without kerning KERNING_Build returns straight away, which
+    // would only show up as a meaningless rate, so those fonts are skipped.
+    std::vector<KerningPair> kerning;
+    if (FT_HAS_KERNING(font.face))
+    {
+        Run(settings, "kerning" + prefix + "ascii_32px", (double)numGlyphs * numGlyphs, "pairs", [&]() {
+            kerning.clear();
+            KERNING_Build(font.face, font.file.data, font.file.size, kPixels, &font.glyphIndices[0], numGlyphs,
+                          settings.numThreads, &kerning);
+        });
+    }
+
+    // packing
+    std::vector<PackRect> rects;
+    MakeRects(bitmaps, &rects);
+    Run(settings, "pack" + prefix + "skyline", numGlyphs, "glyphs", [&]() {
+        PACK_Rects(&rects[0], numGlyphs, kAtlasWidth, kAtlasWidth, PACK_SKYLINE, false);
+    });
+    Run(settings, "pack" + prefix + "maxrects", numGlyphs, "glyphs", [&]() {
+        PACK_Rects(&rects[0], numGlyphs, kAtlasWidth, kAtlasWidth, PACK_MAXRECTS, false);
+    });
+
+    // exporters
+    std::vector<GlyphInfo> glyphs;
+    std::vector<unsigned char> coverage;
+    BuildAtlas(font, bitmaps, rects, &glyphs, &coverage);
+    const std::string out = scratch + "/swiftglyph_bench_" + font.name;
+    Run(settings, "export" + prefix + "yaml", numGlyphs, "glyphs", [&]() {
+        ExportYAMLMetrics(glyphs, out, font.name, kAtlasWidth, 0, font.line_height, kerning);
+    });
+    Run(settings, "export" + prefix + "lua", numGlyphs, "glyphs", [&]() {
+        ExportLuaMetrics(glyphs, out, font.name, kAtlasWidth, 0, font.line_height, kerning);
+    });
+    Run(settings, "export" + prefix + "json", numGlyphs, "glyphs", [&]() {
+        ExportJSONMetrics(glyphs, out, kAtlasWidth, 0, font.line_height, kerning);
+    });
+    Run(settings, "export" + prefix + "bin", numGlyphs, "glyphs", [&]() {
+        ExportBinaryMetrics(glyphs, out, "bench.raw", kAtlasWidth, 0, font.line_height, false, kerning);
+    });
+
+    // the old test.c loader and layout
+    const std::string bbqName = out + ".bbq";
+    if (CookBbq(bbqName.c_str(), glyphs, font.line_height, kerning))
+    {
+        Run(settings, "bbq_load" + prefix + "load_free", 1, "files", [&]() {
+            const BbqFont* loaded = (const BbqFont*)bbq_load(bbqName.c_str());
+            if (loaded)
+                CheckBbq(loaded);
+            bbq_free(loaded);
+        });
+        const BbqFont* bbq = (const BbqFont*)bbq_load(bbqName.c_str());
+        if (bbq)
+        {
+            if (CheckBbq(bbq))
+            {
+                std::vector<float> quads(strlen(kSampleText) * 4 * 16);
+                size_t numQuads = LayoutString(bbq, kSampleText, &quads[0]);
+                Run(settings, "layout" + prefix + "test_c", (double)numQuads, "glyphs", [&]() {
+                    LayoutString(bbq, kSampleText, &quads[0]);
+                });
+            }
+            bbq_free(bbq);
+        }
+    }
+
+    // the runtime library over the .bin written above
+    const std::string binName = out + ".bin";
+    SGFont* runtime = sgfont_load(binName.c_str());
+    if (runtime)
+    {
+        const size_t length = strlen(kSampleText);
+        volatile uint32_t sink = 0;
+        Run(settings, "runtime" + prefix + "glyph_index", (double)length, "lookups", [&]() {
+            uint32_t sum = 0;
+            for (size_t i = 0; i < length; ++i)
+                sum += sgfont_glyph_index(runtime, (unsigned char)kSampleText[i]);
+            sink = sum;
+        });
+        Run(settings, "runtime" + prefix + "kerning", (double)length, "lookups", [&]() {
+            float sum = 0.0f;
+            for (size_t i = 0; i + 1 < length; ++i)
+            {
+                float x, y;
+                sgfont_kerning(runtime, sgfont_glyph_index(runtime, (unsigned char)kSampleText[i]),
+                               sgfont_glyph_index(runtime, (unsigned char)kSampleText[i + 1]), &x, &y);
+                sum += x;
+            }
+            sink = (uint32_t)sum;
+        });
+
+        // a batch of labels like a frame of a game ui would draw
+        std::vector<SGTextString> strings(256);
+        for (size_t i = 0; i < strings.size(); ++i)
+        {
+            strings[i].text = kSampleText;
+            strings[i].length = length;
+            strings[i].pen_x = 0.0f;
+            strings[i].pen_y = (float)i;
+            strings[i].scale = 16.0f;
+        }
+        const size_t maxQuads = sgfont_count_quads(runtime, &strings[0], strings.size());
+        std::vector<SGTextVertex> vertices(maxQuads * 4);
+        std::vector<uint32_t> indices(maxQuads * 6);
+        Run(settings, "runtime" + prefix + "build_quads_256", (double)maxQuads, "glyphs", [&]() {
+            sgfont_build_quads(runtime, &strings[0], strings.size(), &vertices[0], &indices[0], 0, maxQuads,
+                               settings.numThreads);
+        });
+
+        // the same labels redrawn every frame, laid out once and then copied
+        SGLayoutCache* cache = sglayout_create(4 << 20);
+        sglayout_build_quads(cache, runtime, &strings[0], strings.size(), &vertices[0], &indices[0], 0, maxQuads);
+        Run(settings, "runtime" + prefix + "layout_cache_256", (double)maxQuads, "glyphs", [&]() {
+            sglayout_begin_frame(cache);
+            sglayout_build_quads(cache, runtime, &strings[0], strings.size(), &vertices[0], &indices[0], 0, maxQuads);
+        });
+        sglayout_free(cache);
+        (void)sink;
+        sgfont_free(runtime);
+    }
+
+    // targa round trip of the atlas as 32 bit rgba, uncompressed and run length encoded
+    std::vector<unsigned char> rgba((size_t)kAtlasWidth * kAtlasWidth * 4);
+    PIXEL_ConvertImage(&coverage[0], kAtlasWidth, kAtlasWidth, PIXEL_RGBA8, false, false, &rgba[0]);
+    const std::string tgaName = out + ".tga";
+    Run(settings, "tga" + prefix + "save_512_rgba", (double)rgba.size(), "bytes", [&]() {
+        TGA_Save(tgaName.c_str(), kAtlasWidth, kAtlasWidth, 32, &rgba[0]);
+    });
+    Run(settings, "tga" + prefix + "load_512_rgba", (double)rgba.size(), "bytes", [&]() {
+        TGA_Destroy(TGA_Load(tgaName.c_str()));
+    });
+    Run(settings, "tga" + prefix + "save_512_rgba_rle", (double)rgba.size(), "bytes", [&]() {
+        TGA_Save(tgaName.c_str(), kAtlasWidth, kAtlasWidth, 32, &rgba[0], true);
+    });
+    Run(settings, "tga" + prefix + "load_512_rgba_rle", (double)rgba.size(), "bytes", [&]() {
+        TGA_Destroy(TGA_Load(tgaName.c_str()));
+    });
+
+    Run(settings, "png" + prefix + "save_512_ga", (double)coverage.size() * 2, "bytes", [&]() {
+        const std::string png = out + ".png";
+        PNG_Save(png.c_str(), kAtlasWidth, kAtlasWidth, PNG_COLOR_GRAY_ALPHA,
+                 [&](int firstRow, int numRows, unsigned char* dest) {
+                     memcpy(dest, &coverage[(size_t)firstRow * kAtlasWidth], (size_t)numRows * kAtlasWidth);
+                 }, kAtlasWidth, settings.numThreads);
+    });
+
+    // the whole default pipeline: render, kern, pack, write the raw mip chain and yaml
+    Run(settings, "atlas" + prefix + "ascii_32px_raw_yaml", numGlyphs, "glyphs", [&]() {
+        std::vector<GlyphBitmap> rendered(numGlyphs);
+        RASTER_RenderGlyphs(font.file.data, font.file.size, kPixels, &font.glyphIndices[0], numGlyphs,
+                            &rendered[0], settings.numThreads);
+        std::vector<KerningPair> pairs;
+        KERNING_Build(font.face, font.file.data, font.file.size, kPixels, &font.glyphIndices[0], numGlyphs,
+                      settings.numThreads, &pairs);
+        std::vector<PackRect> packed;
+        MakeRects(rendered, &packed);
+        PACK_Rects(&packed[0], numGlyphs, kAtlasWidth, kAtlasWidth, PACK_MAXRECTS, false);
+        std::vector<GlyphInfo> info;
+        std::vector<unsigned char> atlas;
+        BuildAtlas(font, rendered, packed, &info, &atlas);
+        const std::string raw = out + ".raw";
+        MIP_SaveRaw(raw.c_str(), kAtlasWidth,
+                    [&](int firstRow, int numRows, unsigned char* dest) {
+                        memcpy(dest, &atlas[(size_t)firstRow * kAtlasWidth], (size_t)numRows * kAtlasWidth);
+                    }, kAtlasWidth, MIP_FILTER_BOX, PIXEL_LA8, false);
+        ExportYAMLMetrics(info, out, font.name, kAtlasWidth, 0, font.line_height, pairs);
+    });
+    static const char* kScratchExtensions[] = { ".yaml", ".lua", ".json", ".bin", ".bbq", ".tga", ".raw", ".png" };
+    for (size_t i = 0; i < sizeof(kScratchExtensions) / sizeof(kScratchExtensions[0]); ++i)
+        remove((out + kScratchExtensions[i]).c_str());
+}
+
+static void Usage()
+{
+    printf("Runs the swiftglyph benchmarks and prints the results as json.\n");
+    printf("    Usage: swiftglyph_bench [options]\n");
+    printf("        -filter text     : only run benchmarks whose name contains text.\n");
+    printf("        -min-time secs   : minimum time spent on each benchmark, defaults to 0.25.\n");
+    printf("        -threads integer : threads used by the parallel stages, defaults to 1.\n");
+    printf("        -out file        : write the json to file instead of stdout.\n");
+    printf("        -fonts dir       : directory holding FreeSans.otf and Inconsolata.otf.\n");
+    printf("        -scratch dir     : directory for the files written by the benchmarks, defaults to the current one.\n");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    BenchSettings settings;
+    settings.minSeconds = 0.25;
+    settings.numThreads = 1;
+    std::string outFilename;
+    std::string fontDirectory = SWIFTGLYPH_TEST_DIR;
+    std::string scratch = ".";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = (i + 1) < argc;
+        if (strcmp(argv[i], "-filter") == 0 && hasValue)
+            settings.filter = argv[++i];
+        else if (strcmp(argv[i], "-min-time") == 0 && hasValue)
+            settings.minSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-threads") == 0 && hasValue && atoi(argv[i + 1]) > 0)
+            settings.numThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-out") == 0 && hasValue)
+            outFilename = argv[++i];
+        else if (strcmp(argv[i], "-fonts") == 0 && hasValue)
+            fontDirectory = argv[++i];
+        else if (strcmp(argv[i], "-scratch") == 0 && hasValue)
+            scratch = argv[++i];
+        else
+            Usage();
+    }
+
+    static const char* kFonts[] = { "FreeSans", "Inconsolata" };
+    for (size_t i = 0; i < sizeof(kFonts) / sizeof(kFonts[0]); ++i)
+    {
+        BenchFont font;
+        if (!OpenFont(fontDirectory, kFonts[i], &font))
+            return 1;
+        BenchFontSuite(settings, font, scratch);
+        CloseFont(&font);
+    }
+
+    FILE* fp = outFilename.empty() ? stdout : fopen(outFilename.c_str(), "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Error Writing \"%s\"\n", outFilename.c_str());
+        return 1;
+    }
+    bool ok = WriteResults(fp, settings);
+    if (fp != stdout && fclose(fp) != 0)
+        ok = false;
+    return ok ? 0 : 1;
+}
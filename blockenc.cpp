@@ -0,0 +1,386 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+#include "blockenc.h"
+#include "jobs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLOCK_SSE2 1
+#endif
+
+static const int kBlockBytes = 8;
+
+// ETC2 alpha / EAC modifier tables
+static const int kEacModifiers[16][8] =
+{
+    { -3, -6,  -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5,  -8, -13, 1, 4, 7, 12 },
+    { -2, -4,  -6, -13, 1, 3, 5, 12 },
+    { -3, -6,  -8, -12, 2, 5, 7, 11 },
+    { -3, -7,  -9, -11, 2, 6, 8, 10 },
+    { -4, -7,  -8, -11, 3, 6, 7, 10 },
+    { -3, -5,  -8, -11, 2, 4, 7, 10 },
+    { -2, -6,  -8, -10, 1, 5, 7,  9 },
+    { -2, -5,  -8, -10, 1, 4, 7,  9 },
+    { -2, -4,  -8, -10, 1, 3, 7,  9 },
+    { -2, -5,  -7, -10, 1, 4, 6,  9 },
+    { -3, -4,  -7, -10, 2, 3, 6,  9 },
+    { -1, -2,  -3, -10, 0, 1, 2,  9 },
+    { -4, -6,  -8,  -9, 3, 5, 7,  8 },
+    { -3, -5,  -7,  -9, 2, 4, 6,  8 }
+};
+
+// the result of fitting a block, palette values are in the units of the format,
+// 8 bits for BC4 and 11 bits for EAC.
+struct BlockFit
+{
+    int16_t palette[8];
+    unsigned char indices[16];
+    int error;
+};
+
+// picks the closest palette entry for each of the 16 pixels and returns the sum of
+// squared errors.  Ties go to the lowest index in both versions.
+static int FitPalette(const int16_t* pixels, const int16_t* palette, unsigned char* indices)
+{
+#ifdef BLOCK_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i p0 = _mm_loadu_si128((const __m128i*)pixels);
+    const __m128i p1 = _mm_loadu_si128((const __m128i*)(pixels + 8));
+    __m128i best0 = _mm_set1_epi16(0x7fff);
+    __m128i best1 = best0;
+    __m128i index0 = zero;
+    __m128i index1 = zero;
+    for (int k = 0; k < 8; ++k)
+    {
+        const __m128i value = _mm_set1_epi16(palette[k]);
+        const __m128i index = _mm_set1_epi16((short)k);
+        __m128i d0 = _mm_sub_epi16(p0, value);
+        __m128i d1 = _mm_sub_epi16(p1, value);
+        d0 = _mm_max_epi16(d0, _mm_sub_epi16(zero, d0));
+        d1 = _mm_max_epi16(d1, _mm_sub_epi16(zero, d1));
+        const __m128i closer0 = _mm_cmplt_epi16(d0, best0);
+        const __m128i closer1 = _mm_cmplt_epi16(d1, best1);
+        best0 = _mm_min_epi16(d0, best0);
+        best1 = _mm_min_epi16(d1, best1);
+        index0 = _mm_or_si128(_mm_andnot_si128(closer0, index0), _mm_and_si128(closer0, index));
+        index1 = _mm_or_si128(_mm_andnot_si128(closer1, index1), _mm_and_si128(closer1, index));
+    }
+
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(best0, best0), _mm_madd_epi16(best1, best1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    _mm_storel_epi64((__m128i*)indices, _mm_packus_epi16(index0, zero));
+    _mm_storel_epi64((__m128i*)(indices + 8), _mm_packus_epi16(index1, zero));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int error = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int best = 0x7fff;
+        for (int k = 0; k < 8; ++k)
+        {
+            int d = abs(pixels[i] - palette[k]);
+            if (d < best)
+            {
+                best = d;
+                indices[i] = (unsigned char)k;
+            }
+        }
+        error += best * best;
+    }
+    return error;
+#endif
+}
+
+static int Clamp(int value, int low, int high)
+{
+    return value < low ? low : (value > high ? high : value);
+}
+
+static void BC4Palette(int r0, int r1, int16_t* palette)
+{
+    palette[0] = (int16_t)r0;
+    palette[1] = (int16_t)r1;
+    if (r0 > r1)
+    {
+        for (int k = 2; k < 8; ++k)
+            palette[k] = (int16_t)(((8 - k) * r0 + (k - 1) * r1 + 3) / 7);
+    }
+    else
+    {
+        for (int k = 2; k < 6; ++k)
+            palette[k] = (int16_t)(((6 - k) * r0 + (k - 1) * r1 + 2) / 5);
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static void TryBC4(const int16_t* pixels, int r0, int r1, BlockFit* best, int* bestR0, int* bestR1)
+{
+    BlockFit fit;
+    BC4Palette(r0, r1, fit.palette);
+    fit.error = FitPalette(pixels, fit.palette, fit.indices);
+    if (fit.error < best->error)
+    {
+        *best = fit;
+        *bestR0 = r0;
+        *bestR1 = r1;
+    }
+}
+
+// pixels are 8-bit values
+static void EncodeBC4(const int16_t* pixels, BlockQuality quality, unsigned char* out, BlockFit* best)
+{
+    // the full range for the 8 value mode, and the range without the 0 and 255
+    // the 6 value mode gets for free, which suits antialiased edges.
+    int low = 255, high = 0, innerLow = 255, innerHigh = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int p = pixels[i];
+        low = p < low ? p : low;
+        high = p > high ? p : high;
+        if (p != 0 && p != 255)
+        {
+            innerLow = p < innerLow ? p : innerLow;
+            innerHigh = p > innerHigh ? p : innerHigh;
+        }
+    }
+    if (innerLow > innerHigh)
+        innerLow = innerHigh = low;
+
+    int r0 = 0, r1 = 0;
+    best->error = 0x7fffffff;
+    if (low == high)
+    {
+        TryBC4(pixels, low, low, best, &r0, &r1);
+    }
+    else
+    {
+        TryBC4(pixels, high, low, best, &r0, &r1);
+        if (quality != BLOCK_QUALITY_FAST)
+            TryBC4(pixels, innerLow, innerHigh, best, &r0, &r1);
+
+        // nudge the endpoints inwards, the extremes are rarely the best fit.
+        const int radius = (quality == BLOCK_QUALITY_BEST) ? 4 : (quality == BLOCK_QUALITY_NORMAL ? 1 : 0);
+        for (int a = 0; a <= radius && best->error > 0; ++a)
+        {
+            for (int b = 0; b <= radius && best->error > 0; ++b)
+            {
+                if (a == 0 && b == 0)
+                    continue;
+                if (high - a > low + b)
+                    TryBC4(pixels, high - a, low + b, best, &r0, &r1);
+                if (innerLow + a <= innerHigh - b)
+                    TryBC4(pixels, innerLow + a, innerHigh - b, best, &r0, &r1);
+            }
+        }
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+        bits |= (uint64_t)best->indices[i] << (3 * i);
+    out[0] = (unsigned char)r0;
+    out[1] = (unsigned char)r1;
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+static void EacPalette(int base, int multiplier, int table, int16_t* palette)
+{
+    for (int k = 0; k < 8; ++k)
+    {
+        int modifier = kEacModifiers[table][k];
+        int value = base * 8 + 4 + (multiplier ? modifier * multiplier * 8 : modifier);
+        palette[k] = (int16_t)Clamp(value, 0, 2047);
+    }
+}
+
+// pixels are 11-bit values
+static void EncodeEac(const int16_t* pixels, BlockQuality quality, unsigned char* out, BlockFit* best)
+{
+    int low = 2047, high = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        low = pixels[i] < low ? pixels[i] : low;
+        high = pixels[i] > high ? pixels[i] : high;
+    }
+
+    const int multiplierRadius = (quality == BLOCK_QUALITY_BEST) ? 2 : (quality == BLOCK_QUALITY_NORMAL ? 1 : 0);
+    const int baseRadius = (quality == BLOCK_QUALITY_BEST) ? 3 : (quality == BLOCK_QUALITY_NORMAL ? 1 : 0);
+    int bestBase = 0, bestMultiplier = 0, bestTable = 0;
+    best->error = 0x7fffffff;
+
+    for (int table = 0; table < 16 && best->error > 0; ++table)
+    {
+        // spread the table over the block range, centred on the middle of it.
+        const int* modifiers = kEacModifiers[table];
+        const int span = (modifiers[7] - modifiers[3]) * 8;
+        const int multiplier = Clamp((high - low + span / 2) / span, 1, 15);
+        for (int m = multiplier - multiplierRadius; m <= multiplier + multiplierRadius; ++m)
+        {
+            if (m < 0 || m > 15)
+                continue;
+            const int scale = m ? m * 8 : 1;
+            const int centre = (low + high) / 2 - (modifiers[7] + modifiers[3]) * scale / 2;
+            const int base = Clamp(centre / 8, 0, 255);
+            for (int b = base - baseRadius; b <= base + baseRadius && best->error > 0; ++b)
+            {
+                if (b < 0 || b > 255)
+                    continue;
+                BlockFit fit;
+                EacPalette(b, m, table, fit.palette);
+                fit.error = FitPalette(pixels, fit.palette, fit.indices);
+                if (fit.error < best->error)
+                {
+                    *best = fit;
+                    bestBase = b;
+                    bestMultiplier = m;
+                    bestTable = table;
+                }
+            }
+        }
+    }
+
+    // indices go in column major order, most significant bits first
+    uint64_t bits = 0;
+    for (int x = 0; x < 4; ++x)
+        for (int y = 0; y < 4; ++y)
+            bits = (bits << 3) | best->indices[y * 4 + x];
+    out[0] = (unsigned char)bestBase;
+    out[1] = (unsigned char)((bestMultiplier << 4) | bestTable);
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = (unsigned char)(bits >> (40 - 8 * i));
+}
+
+uint64_t BLOCK_LevelSize(int width)
+{
+    uint64_t blocks = (uint64_t)(width + 3) / 4;
+    return blocks * blocks * kBlockBytes;
+}
+
+uint64_t BLOCK_ChainSize(int width)
+{
+    uint64_t size = 0;
+    for (int w = width; w >= 1; w /= 2)
+        size += BLOCK_LevelSize(w);
+    return size;
+}
+
+double BLOCK_EncodeRows(const unsigned char* src, int width, int numRows, BlockFormat format,
+                        BlockQuality quality, unsigned char* dest, int numThreads)
+{
+    const int blocksPerRow = (width + 3) / 4;
+    const int blockRows = (numRows + 3) / 4;
+    std::vector<double> rowErrors(blockRows, 0.0);
+
+    JOB_ParallelFor(blockRows, numThreads, [&](int, int by)
+    {
+        int64_t rowError = 0;
+        for (int bx = 0; bx < blocksPerRow; ++bx)
+        {
+            // levels smaller than a block repeat their last row and column
+            int16_t pixels[16];
+            int16_t targets[16];
+            for (int y = 0; y < 4; ++y)
+            {
+                int sy = by * 4 + y < numRows ? by * 4 + y : numRows - 1;
+                const unsigned char* row = src + (size_t)sy * width;
+                for (int x = 0; x < 4; ++x)
+                {
+                    int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+                    pixels[y * 4 + x] = row[sx];
+                    targets[y * 4 + x] = (format == BLOCK_BC4) ? row[sx] : (int16_t)((row[sx] * 2047 + 127) / 255);
+                }
+            }
+
+            BlockFit fit;
+            unsigned char* out = dest + ((size_t)by * blocksPerRow + bx) * kBlockBytes;
+            if (format == BLOCK_BC4)
+                EncodeBC4(targets, quality, out, &fit);
+            else
+                EncodeEac(targets, quality, out, &fit);
+
+            // measure against the original 8-bit pixels, skipping the repeated ones
+            for (int y = 0; y < 4 && by * 4 + y < numRows; ++y)
+            {
+                for (int x = 0; x < 4 && bx * 4 + x < width; ++x)
+                {
+                    int i = y * 4 + x;
+                    int value = fit.palette[fit.indices[i]];
+                    if (format == BLOCK_EAC_R11)
+                        value = (value * 255 * 2 + 2047) / (2047 * 2);
+                    rowError += (value - pixels[i]) * (value - pixels[i]);
+                }
+            }
+        }
+        rowErrors[by] = (double)rowError;
+    });
+
+    double error = 0.0;
+    for (int by = 0; by < blockRows; ++by)
+        error += rowErrors[by];
+    return error;
+}
+
+static double PSNR(double squaredError, double numPixels)
+{
+    if (squaredError <= 0.0)
+        return 99.99;
+    return 10.0 * log10(255.0 * 255.0 * numPixels / squaredError);
+}
+
+int BLOCK_SaveChain(const char* filename, int width, const RowSource& alpha, int bandRows, BlockFormat format,
+                    BlockQuality quality, MipFilter filter, int numThreads, double psnr[2])
+{
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL)
+        return BLOCK_ERROR_FILE_OPEN;
+
+    // like MIP_SaveRaw, each band of each level is compressed and written into its
+    // place as soon as it's done.  Bands are a multiple of 4 rows so they always
+    // cover whole blocks.
+    bandRows = bandRows < width ? bandRows : width;
+    std::vector<unsigned char> blocks((size_t)((width + 3) / 4) * ((bandRows + 3) / 4) * kBlockBytes);
+    std::vector<uint64_t> levelOffsets;
+    for (int w = width; w >= 1; w /= 2)
+        levelOffsets.push_back(levelOffsets.empty() ? 0 : levelOffsets.back() + BLOCK_LevelSize(w * 2));
+
+    bool ok = true;
+    double levelError = 0.0, totalError = 0.0;
+    MipStream* stream = MIP_CreateStream(width, bandRows, filter,
+        [&](int level, int w, int firstRow, int numRows, const unsigned char* rows)
+        {
+            double error = BLOCK_EncodeRows(rows, w, numRows, format, quality, &blocks[0], numThreads);
+            if (level == 0)
+                levelError += error;
+            totalError += error;
+
+            const uint64_t rowBytes = (uint64_t)((w + 3) / 4) * kBlockBytes;
+            const uint64_t offset = levelOffsets[level] + (uint64_t)(firstRow / 4) * rowBytes;
+            if (ok)
+                ok = STREAM_WriteAt(fp, offset, &blocks[0], (size_t)(rowBytes * ((numRows + 3) / 4)));
+        });
+
+    MIP_PushSource(stream, alpha, width, bandRows, true);
+    MIP_FreeStream(stream);
+
+    if (psnr)
+    {
+        double totalPixels = 0.0;
+        for (int w = width; w >= 1; w /= 2)
+            totalPixels += (double)w * w;
+        psnr[0] = PSNR(levelError, (double)width * width);
+        psnr[1] = PSNR(totalError, totalPixels);
+    }
+
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok ? BLOCK_OK : BLOCK_ERROR_WRITING_FILE;
+}
@@ -0,0 +1,54 @@
+// Single channel block compression (BC4 and EAC R11) of the atlas mip chain.
+
+#ifndef BLOCKENCH
+#define BLOCKENCH
+
+#include <stdint.h>
+#include "mip.h"
+#include "stream.h"
+
+enum
+{
+    BLOCK_ERROR_FILE_OPEN,
+    BLOCK_ERROR_WRITING_FILE,
+    BLOCK_ERROR_MEMORY,
+    BLOCK_OK
+};
+
+enum BlockFormat
+{
+    BLOCK_BC4,          // BC4 unorm, also known as RGTC1 or ATI1, desktop GPUs
+    BLOCK_EAC_R11       // EAC R11 unorm, part of ETC2, every OpenGL ES 3 GPU
+};
+
+enum BlockQuality
+{
+    BLOCK_QUALITY_FAST,     // endpoints straight from the block range
+    BLOCK_QUALITY_NORMAL,   // a few candidate endpoints per block
+    BLOCK_QUALITY_BEST      // wide endpoint search, several times slower
+};
+
+// both formats store a 4x4 block in 8 bytes.  Levels smaller than a block still
+// take a whole block.
+uint64_t BLOCK_LevelSize(int width);
+
+// number of bytes used by a full chain from width x width down to 1x1.
+uint64_t BLOCK_ChainSize(int width);
+
+// compresses numRows rows of a width wide 8-bit level into dest, which must hold
+// a row of blocks for every 4 rows.  numRows is a multiple of 4 unless it's a whole
+// level smaller than a block.  Rows of blocks are spread over numThreads threads,
+// the output doesn't depend on the count.
+// Returns the sum of squared errors in 8-bit units.
+double BLOCK_EncodeRows(const unsigned char* src, int width, int numRows, BlockFormat format,
+                        BlockQuality quality, unsigned char* dest, int numThreads);
+
+// writes every mip level of the width x width coverage into filename, bottom row
+// first and level 0 first like MIP_SaveRaw, reading it in bands of bandRows rows.
+// bandRows must be a multiple of 4.  If psnr isn't NULL it receives the peak signal
+// to noise ratio in dB of level 0 and of the whole chain, against the uncompressed
+// levels.  A lossless result reports 99.99.
+int BLOCK_SaveChain(const char* filename, int width, const RowSource& alpha, int bandRows, BlockFormat format,
+                    BlockQuality quality, MipFilter filter, int numThreads, double psnr[2]);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+
+#include "charset.h"
+
+static const uint32_t kMaxCodepoint = 0x10FFFF;
+
+// parses a decimal, 0x hex or U+ hex codepoint, advancing str past it.
+static bool ParseCodepoint(const char** str, uint32_t* codepoint)
+{
+    const char* p = *str;
+    while (isspace((unsigned char)*p))
+        p++;
+
+    int base = 10;
+    if ((p[0] == 'U' || p[0] == 'u') && p[1] == '+')
+    {
+        base = 16;
+        p += 2;
+    }
+    else if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+        base = 16;
+        p += 2;
+    }
+
+    char* end;
+    unsigned long value = strtoul(p, &end, base);
+    if (end == p || value > kMaxCodepoint)
+        return false;
+
+    while (isspace((unsigned char)*end))
+        end++;
+    *str = end;
+    *codepoint = (uint32_t)value;
+    return true;
+}
+
+int CHARSET_ParseRanges(const char* spec, std::vector<uint32_t>* codepoints)
+{
+    const char* p = spec;
+    while (*p)
+    {
+        uint32_t first, last;
+        if (!ParseCodepoint(&p, &first))
+            return CHARSET_ERROR_SYNTAX;
+        last = first;
+        if (*p == '-')
+        {
+            p++;
+            if (!ParseCodepoint(&p, &last) || last < first)
+                return CHARSET_ERROR_SYNTAX;
+        }
+
+        for (uint32_t c = first; c <= last; ++c)
+            codepoints->push_back(c);
+
+        if (*p == ',')
+            p++;
+        else if (*p != 0)
+            return CHARSET_ERROR_SYNTAX;
+    }
+    return CHARSET_OK;
+}
+
+int CHARSET_DecodeUTF8(const unsigned char* str, const unsigned char* end, uint32_t* codepoint)
+{
+    static const uint32_t kMinValue[4] = { 0, 0x80, 0x800, 0x10000 };
+
+    unsigned char c = str[0];
+    int length;
+    uint32_t value;
+    if (c < 0x80)
+    {
+        *codepoint = c;
+        return 1;
+    }
+    else if ((c & 0xE0) == 0xC0)
+    {
+        length = 2;
+        value = c & 0x1F;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        length = 3;
+        value = c & 0x0F;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        length = 4;
+        value = c & 0x07;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (end - str < length)
+        return 0;
+
+    for (int i = 1; i < length; ++i)
+    {
+        if ((str[i] & 0xC0) != 0x80)
+            return 0;
+        value = (value << 6) | (str[i] & 0x3F);
+    }
+
+    // reject overlong encodings, surrogates and anything past the last plane
+    if (value < kMinValue[length - 1] || value > kMaxCodepoint || (value >= 0xD800 && value <= 0xDFFF))
+        return 0;
+
+    *codepoint = value;
+    return length;
+}
+
+int CHARSET_LoadFile(const char* filename, std::vector<uint32_t>* codepoints)
+{
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL)
+        return CHARSET_ERROR_FILE_OPEN;
+
+    std::vector<unsigned char> text;
+    unsigned char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        text.insert(text.end(), chunk, chunk + n);
+    fclose(fp);
+
+    const unsigned char* p = text.empty() ? NULL : &text[0];
+    const unsigned char* end = p + text.size();
+    while (p < end)
+    {
+        uint32_t codepoint;
+        int length = CHARSET_DecodeUTF8(p, end, &codepoint);
+        if (length == 0)
+            return CHARSET_ERROR_ENCODING;
+        p += length;
+
+        if (codepoint < 32 || codepoint == 0x7F || codepoint == 0xFEFF)
+            continue;
+        codepoints->push_back(codepoint);
+    }
+    return CHARSET_OK;
+}
+
+void CHARSET_Sort(std::vector<uint32_t>* codepoints)
+{
+    std::sort(codepoints->begin(), codepoints->end());
+    codepoints->erase(std::unique(codepoints->begin(), codepoints->end()), codepoints->end());
+}
@@ -0,0 +1,32 @@
+// Selecting which unicode codepoints end up in the atlas.
+
+#ifndef CHARSETH
+#define CHARSETH
+
+#include <stdint.h>
+#include <vector>
+
+enum
+{
+    CHARSET_ERROR_FILE_OPEN,
+    CHARSET_ERROR_SYNTAX,
+    CHARSET_ERROR_ENCODING,
+    CHARSET_OK
+};
+
+// appends the codepoints of a comma separated list of ranges such as
+// "32-126,0xA0-0x17F,U+0391-U+03C9,8364".  Both ends of a range are inclusive.
+int CHARSET_ParseRanges(const char* spec, std::vector<uint32_t>* codepoints);
+
+// appends every codepoint that appears in a utf-8 text file.
+// Control characters and byte order marks are ignored.
+int CHARSET_LoadFile(const char* filename, std::vector<uint32_t>* codepoints);
+
+// sorts the codepoints and removes duplicates, which is the order glyphs are stored in.
+void CHARSET_Sort(std::vector<uint32_t>* codepoints);
+
+// decodes one utf-8 sequence starting at str and returns the number of bytes used,
+// or 0 if the sequence is malformed.
+int CHARSET_DecodeUTF8(const unsigned char* str, const unsigned char* end, uint32_t* codepoint);
+
+#endif
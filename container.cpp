@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <zlib.h>
+
+#include "container.h"
+
+typedef std::vector<unsigned char> Level;
+
+static const unsigned char kKTX2Identifier[12] =
+{
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+static const uint32_t kKTX2HeaderSize = 80;
+static const uint32_t kKTX2LevelIndexEntrySize = 24;
+static const uint32_t kKTX2SupercompressionZlib = 3;
+
+static const uint32_t kVkFormatR8Unorm = 9;
+static const uint32_t kVkFormatR8G8Unorm = 16;
+static const uint32_t kVkFormatR8G8B8A8Unorm = 37;
+static const uint32_t kVkFormatBC4UnormBlock = 139;
+static const uint32_t kVkFormatEacR11UnormBlock = 153;
+
+// khr data format descriptor values
+static const uint32_t kDfModelRGBSDA = 1;
+static const uint32_t kDfModelBC4 = 131;
+static const uint32_t kDfModelETC2 = 161;
+static const uint32_t kDfPrimariesBT709 = 1;
+static const uint32_t kDfTransferLinear = 1;
+static const uint32_t kDfFlagAlphaPremultiplied = 1;
+static const uint32_t kDfChannelAlpha = 15;
+
+static const uint32_t kDDSMagic = 0x20534444; // "DDS "
+static const uint32_t kDDSHeaderSize = 124;
+
+static void PutU32(std::vector<unsigned char>* out, size_t offset, uint32_t value)
+{
+    (*out)[offset + 0] = (unsigned char)(value);
+    (*out)[offset + 1] = (unsigned char)(value >> 8);
+    (*out)[offset + 2] = (unsigned char)(value >> 16);
+    (*out)[offset + 3] = (unsigned char)(value >> 24);
+}
+
+static void PutU64(std::vector<unsigned char>* out, size_t offset, uint64_t value)
+{
+    PutU32(out, offset, (uint32_t)value);
+    PutU32(out, offset + 4, (uint32_t)(value >> 32));
+}
+
+static bool IsBlockFormat(ContainerFormat format)
+{
+    return format == CONTAINER_BC4 || format == CONTAINER_EAC_R11;
+}
+
+// bytes per texel, or per 4x4 block for the compressed formats
+static int TexelBlockBytes(ContainerFormat format)
+{
+    if (IsBlockFormat(format))
+        return 8;
+    return PIXEL_BytesPerTexel((PixelFormat)format);
+}
+
+// bytes used by one level in the container format, before any supercompression.
+static uint64_t LevelSize(ContainerFormat format, int width)
+{
+    if (IsBlockFormat(format))
+        return BLOCK_LevelSize(width);
+    return (uint64_t)width * width * TexelBlockBytes(format);
+}
+
+static uint32_t CountLevels(int width)
+{
+    uint32_t count = 0;
+    for (int w = width; w >= 1; w /= 2)
+        count++;
+    return count;
+}
+
+// receives a converted band of a level, offset counts from the start of the level.
+typedef std::function<bool (int level, uint64_t offset, const unsigned char* data, size_t size)> LevelWriteFn;
+
+// builds the chain from bands of the coverage, bottom row first, and converts each
+// band of each level to the container format as soon as it's done.  Bands arrive in
+// order within a level.
+static bool StreamLevels(int width, const RowSource& alpha, int bandRows, const ContainerSettings& settings,
+                         const LevelWriteFn& write)
+{
+    const bool block = IsBlockFormat(settings.format);
+    bandRows = bandRows < width ? bandRows : width;
+    std::vector<unsigned char> texels(block ? (size_t)((width + 3) / 4) * ((bandRows + 3) / 4) * 8 :
+                                      (size_t)bandRows * width * TexelBlockBytes(settings.format));
+    bool ok = true;
+    MipStream* stream = MIP_CreateStream(width, bandRows, settings.filter,
+        [&](int level, int w, int firstRow, int numRows, const unsigned char* rows)
+        {
+            if (!ok)
+                return;
+            uint64_t rowBytes, offset, size;
+            if (block)
+            {
+                BLOCK_EncodeRows(rows, w, numRows, settings.format == CONTAINER_BC4 ? BLOCK_BC4 : BLOCK_EAC_R11,
+                                 settings.quality, &texels[0], settings.numThreads);
+                rowBytes = (uint64_t)((w + 3) / 4) * 8;
+                offset = (uint64_t)(firstRow / 4) * rowBytes;
+                size = (uint64_t)((numRows + 3) / 4) * rowBytes;
+            }
+            else
+            {
+                PIXEL_ConvertImage(rows, w, numRows, (PixelFormat)settings.format, settings.premultiplied,
+                                   false, &texels[0]);
+                rowBytes = (uint64_t)w * TexelBlockBytes(settings.format);
+                offset = (uint64_t)firstRow * rowBytes;
+                size = (uint64_t)numRows * rowBytes;
+            }
+            ok = write(level, offset, &texels[0], (size_t)size);
+        });
+
+    MIP_PushSource(stream, alpha, width, bandRows, true);
+    MIP_FreeStream(stream);
+    return ok;
+}
+
+// feeds size bytes to a deflate stream, finishing it when finish is set, and appends
+// whatever comes out to out.
+static bool Deflate(z_stream* z, const unsigned char* data, size_t size, bool finish, Level* out)
+{
+    unsigned char buffer[16384];
+    do
+    {
+        // avail_in is 32 bits, very large bands go in pieces
+        const size_t piece = size < (1u << 30) ? size : (1u << 30);
+        z->next_in = (Bytef*)data;
+        z->avail_in = (uInt)piece;
+        data += piece;
+        size -= piece;
+        const int flush = (finish && size == 0) ? Z_FINISH : Z_NO_FLUSH;
+        int ret;
+        do
+        {
+            z->next_out = buffer;
+            z->avail_out = sizeof(buffer);
+            ret = deflate(z, flush);
+            if (ret == Z_STREAM_ERROR)
+                return false;
+            out->insert(out->end(), buffer, buffer + sizeof(buffer) - z->avail_out);
+        } while (z->avail_out == 0);
+        if (flush == Z_FINISH && ret != Z_STREAM_END)
+            return false;
+    } while (size > 0);
+    return true;
+}
+
+// the basic data format descriptor ktx2 requires, describing a single texel block.
+static std::vector<unsigned char> BuildDFD(ContainerFormat format, bool premultiplied, bool supercompressed)
+{
+    const int numSamples = IsBlockFormat(format) ? 1 : TexelBlockBytes(format);
+    const uint32_t blockSize = 24 + 16 * numSamples;
+    std::vector<unsigned char> dfd(4 + blockSize, 0);
+
+    uint32_t model = kDfModelRGBSDA;
+    uint32_t dimensions = 0;
+    if (format == CONTAINER_BC4)
+        model = kDfModelBC4;
+    else if (format == CONTAINER_EAC_R11)
+        model = kDfModelETC2;
+    if (IsBlockFormat(format))
+        dimensions = 3 | (3 << 8);
+
+    PutU32(&dfd, 0, (uint32_t)dfd.size());
+    PutU32(&dfd, 4, 0);                                 // khronos vendor, basic descriptor
+    PutU32(&dfd, 8, 2 | (blockSize << 16));             // version 1.3
+    const uint32_t flags = (premultiplied && numSamples > 1) ? kDfFlagAlphaPremultiplied : 0;
+    PutU32(&dfd, 12, model | (kDfPrimariesBT709 << 8) | (kDfTransferLinear << 16) | (flags << 24));
+    PutU32(&dfd, 16, dimensions);
+    // supercompressed levels have no fixed size per block
+    PutU32(&dfd, 20, supercompressed ? 0 : (uint32_t)TexelBlockBytes(format));
+    PutU32(&dfd, 24, 0);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // red holds the luminance or coverage, green the coverage of luminance-alpha
+        // and the fourth byte of rgba is alpha.
+        const size_t base = 28 + 16 * i;
+        const uint32_t bitLength = IsBlockFormat(format) ? 63 : 7;
+        const uint32_t channel = (i == 3) ? kDfChannelAlpha : (uint32_t)i;
+        PutU32(&dfd, base, (uint32_t)(8 * i) | (bitLength << 16) | (channel << 24));
+        PutU32(&dfd, base + 4, 0);
+        PutU32(&dfd, base + 8, 0);
+        PutU32(&dfd, base + 12, IsBlockFormat(format) ? 0xFFFFFFFFu : 255u);
+    }
+    return dfd;
+}
+
+static void AddKeyValue(std::vector<unsigned char>* kvd, const char* key, const char* value)
+{
+    const size_t start = kvd->size();
+    const uint32_t length = (uint32_t)(strlen(key) + 1 + strlen(value) + 1);
+    kvd->resize(start + 4);
+    PutU32(kvd, start, length);
+    kvd->insert(kvd->end(), key, key + strlen(key) + 1);
+    kvd->insert(kvd->end(), value, value + strlen(value) + 1);
+    kvd->resize((kvd->size() + 3) & ~(size_t)3, 0);
+}
+
+static int WriteFile(const char* filename, const std::vector<unsigned char>& header,
+                     const std::vector<Level>& levels, const std::vector<uint64_t>& offsets)
+{
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL)
+        return CONTAINER_ERROR_FILE_OPEN;
+
+    // levels are written in file order, padding up to each offset.
+    std::vector<size_t> order(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+    static const unsigned char kZeros[8] = { 0 };
+    bool ok = fwrite(&header[0], 1, header.size(), fp) == header.size();
+    uint64_t position = header.size();
+    for (size_t i = 0; i < order.size() && ok; ++i)
+    {
+        const Level& level = levels[order[i]];
+        const size_t padding = (size_t)(offsets[order[i]] - position);
+        ok = fwrite(kZeros, 1, padding, fp) == padding &&
+            fwrite(&level[0], 1, level.size(), fp) == level.size();
+        position = offsets[order[i]] + level.size();
+    }
+
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok ? CONTAINER_OK : CONTAINER_ERROR_WRITING_FILE;
+}
+
+// builds the header, level index, dfd and kvd of a ktx2 file and the offset of each
+// level, given the stored and uncompressed size of every level.
+static std::vector<unsigned char> BuildKTX2Header(int width, const ContainerSettings& settings,
+                                                  const std::vector<uint64_t>& sizes,
+                                                  const std::vector<uint64_t>& uncompressedSizes,
+                                                  std::vector<uint64_t>* offsets)
+{
+    const uint32_t levelCount = (uint32_t)sizes.size();
+    const std::vector<unsigned char> dfd = BuildDFD(settings.format, settings.premultiplied, settings.zlib);
+    std::vector<unsigned char> kvd;
+    AddKeyValue(&kvd, "KTXorientation", "ru");
+    AddKeyValue(&kvd, "KTXwriter", "swiftglyph");
+
+    const uint32_t dfdOffset = kKTX2HeaderSize + levelCount * kKTX2LevelIndexEntrySize;
+    const uint32_t kvdOffset = dfdOffset + (uint32_t)dfd.size();
+    std::vector<unsigned char> header(kvdOffset + kvd.size(), 0);
+
+    // the smallest level comes first in the file, each aligned to the texel block
+    // size and 4 bytes unless the levels are supercompressed.
+    const uint64_t alignment = settings.zlib ? 1 : (IsBlockFormat(settings.format) ? 8 : 4);
+    offsets->resize(levelCount);
+    uint64_t position = header.size();
+    for (int i = (int)levelCount - 1; i >= 0; --i)
+    {
+        position = (position + alignment - 1) / alignment * alignment;
+        (*offsets)[i] = position;
+        position += sizes[i];
+    }
+
+    static const uint32_t kVkFormats[] =
+    {
+        kVkFormatR8G8Unorm, kVkFormatR8Unorm, kVkFormatR8G8B8A8Unorm, kVkFormatBC4UnormBlock,
+        kVkFormatEacR11UnormBlock
+    };
+    memcpy(&header[0], kKTX2Identifier, sizeof(kKTX2Identifier));
+    PutU32(&header, 12, kVkFormats[settings.format]);
+    PutU32(&header, 16, 1);                             // typeSize
+    PutU32(&header, 20, (uint32_t)width);
+    PutU32(&header, 24, (uint32_t)width);
+    PutU32(&header, 28, 0);                             // pixelDepth
+    PutU32(&header, 32, 0);                             // layerCount
+    PutU32(&header, 36, 1);                             // faceCount
+    PutU32(&header, 40, levelCount);
+    PutU32(&header, 44, settings.zlib ? kKTX2SupercompressionZlib : 0);
+    PutU32(&header, 48, dfdOffset);
+    PutU32(&header, 52, (uint32_t)dfd.size());
+    PutU32(&header, 56, kvdOffset);
+    PutU32(&header, 60, (uint32_t)kvd.size());
+    PutU64(&header, 64, 0);                             // no supercompression global data
+    PutU64(&header, 72, 0);
+
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        const size_t base = kKTX2HeaderSize + i * kKTX2LevelIndexEntrySize;
+        PutU64(&header, base, (*offsets)[i]);
+        PutU64(&header, base + 8, sizes[i]);
+        PutU64(&header, base + 16, uncompressedSizes[i]);
+    }
+    memcpy(&header[dfdOffset], &dfd[0], dfd.size());
+    memcpy(&header[kvdOffset], &kvd[0], kvd.size());
+    return header;
+}
+
+// writes the header, then every band straight into its place in the file.
+static int StreamFile(const char* filename, const std::vector<unsigned char>& header,
+                      const std::vector<uint64_t>& offsets, int width, const RowSource& alpha, int bandRows,
+                      const ContainerSettings& settings)
+{
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL)
+        return CONTAINER_ERROR_FILE_OPEN;
+
+    bool ok = fwrite(&header[0], 1, header.size(), fp) == header.size() &&
+        StreamLevels(width, alpha, bandRows, settings,
+            [&](int level, uint64_t offset, const unsigned char* data, size_t size)
+            {
+                return STREAM_WriteAt(fp, offsets[level] + offset, data, size);
+            });
+
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok ? CONTAINER_OK : CONTAINER_ERROR_WRITING_FILE;
+}
+
+int CONTAINER_SaveKTX2(const char* filename, int width, const RowSource& alpha, int bandRows,
+                       const ContainerSettings& settings)
+{
+    const uint32_t levelCount = CountLevels(width);
+    std::vector<uint64_t> uncompressedSizes(levelCount);
+    for (uint32_t i = 0; i < levelCount; ++i)
+        uncompressedSizes[i] = LevelSize(settings.format, width >> i);
+
+    std::vector<uint64_t> offsets;
+    if (!settings.zlib)
+    {
+        const std::vector<unsigned char> header = BuildKTX2Header(width, settings, uncompressedSizes,
+                                                                  uncompressedSizes, &offsets);
+        return StreamFile(filename, header, offsets, width, alpha, bandRows, settings);
+    }
+
+    // the deflated sizes are only known at the end, so the deflated levels are kept
+    // until then.  Each level is its own deflate stream, the same as compress2 gives.
+    std::vector<Level> levels(levelCount);
+    std::vector<z_stream> deflaters(levelCount);
+    std::vector<uint64_t> consumed(levelCount, 0);
+    bool ok = true;
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        memset(&deflaters[i], 0, sizeof(z_stream));
+        if (deflateInit(&deflaters[i], Z_BEST_COMPRESSION) != Z_OK)
+            ok = false;
+    }
+    if (ok)
+    {
+        ok = StreamLevels(width, alpha, bandRows, settings,
+            [&](int level, uint64_t, const unsigned char* data, size_t size)
+            {
+                consumed[level] += size;
+                return Deflate(&deflaters[level], data, size, consumed[level] == uncompressedSizes[level],
+                               &levels[level]);
+            });
+    }
+    for (uint32_t i = 0; i < levelCount; ++i)
+        deflateEnd(&deflaters[i]);
+    if (!ok)
+        return CONTAINER_ERROR_MEMORY;
+
+    std::vector<uint64_t> sizes(levelCount);
+    for (uint32_t i = 0; i < levelCount; ++i)
+        sizes[i] = levels[i].size();
+    const std::vector<unsigned char> header = BuildKTX2Header(width, settings, sizes, uncompressedSizes, &offsets);
+    return WriteFile(filename, header, levels, offsets);
+}
+
+int CONTAINER_SaveDDS(const char* filename, int width, const RowSource& alpha, int bandRows,
+                      const ContainerSettings& settings)
+{
+    if (settings.format == CONTAINER_EAC_R11)
+        return CONTAINER_ERROR_FORMAT;
+
+    const uint32_t kDDSFlags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;    // caps, height, width, pixelformat, mipmapcount
+    const uint32_t kDDSPitch = 0x8;
+    const uint32_t kDDSLinearSize = 0x80000;
+    const uint32_t kDDPFAlphaPixels = 0x1;
+    const uint32_t kDDPFFourCC = 0x4;
+    const uint32_t kDDPFRGB = 0x40;
+    const uint32_t kDDPFAlphaPremultiplied = 0x8000;
+    const uint32_t kDDPFLuminance = 0x20000;
+    const uint32_t kDDSCaps = 0x8 | 0x1000 | 0x400000;                // complex, texture, mipmap
+
+    const uint32_t levelCount = CountLevels(width);
+    std::vector<unsigned char> header(4 + kDDSHeaderSize, 0);
+    std::vector<uint64_t> offsets(levelCount);
+    uint64_t position = header.size();
+    for (uint32_t i = 0; i < levelCount; ++i)
+    {
+        offsets[i] = position;
+        position += LevelSize(settings.format, width >> i);
+    }
+
+    PutU32(&header, 0, kDDSMagic);
+    PutU32(&header, 4, kDDSHeaderSize);
+    PutU32(&header, 12, (uint32_t)width);
+    PutU32(&header, 16, (uint32_t)width);
+    PutU32(&header, 28, levelCount);
+    PutU32(&header, 76, 32);                            // pixel format size
+    if (settings.format == CONTAINER_BC4)
+    {
+        PutU32(&header, 8, kDDSFlags | kDDSLinearSize);
+        PutU32(&header, 20, (uint32_t)LevelSize(settings.format, width));
+        PutU32(&header, 80, kDDPFFourCC);
+        memcpy(&header[84], "ATI1", 4);
+    }
+    else
+    {
+        // luminance-alpha is A8L8, coverage only is L8 and rgba is A8B8G8R8
+        const uint32_t premultiplied = settings.premultiplied ? kDDPFAlphaPremultiplied : 0;
+        PutU32(&header, 8, kDDSFlags | kDDSPitch);
+        PutU32(&header, 20, (uint32_t)(width * TexelBlockBytes(settings.format)));
+        PutU32(&header, 88, (uint32_t)(8 * TexelBlockBytes(settings.format)));
+        PutU32(&header, 92, 0xFF);
+        if (settings.format == CONTAINER_LA8)
+        {
+            PutU32(&header, 80, kDDPFLuminance | kDDPFAlphaPixels | premultiplied);
+            PutU32(&header, 104, 0xFF00);
+        }
+        else if (settings.format == CONTAINER_RGBA8)
+        {
+            PutU32(&header, 80, kDDPFRGB | kDDPFAlphaPixels | premultiplied);
+            PutU32(&header, 96, 0xFF00);
+            PutU32(&header, 100, 0xFF0000);
+            PutU32(&header, 104, 0xFF000000);
+        }
+        else
+            PutU32(&header, 80, kDDPFLuminance);
+    }
+    PutU32(&header, 108, kDDSCaps);
+
+    return StreamFile(filename, header, offsets, width, alpha, bandRows, settings);
+}
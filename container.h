@@ -0,0 +1,57 @@
+// KTX2 and DDS texture containers holding the atlas mip chain.
+
+#ifndef CONTAINERH
+#define CONTAINERH
+
+#include "mip.h"
+#include "pixels.h"
+#include "blockenc.h"
+#include "stream.h"
+
+enum
+{
+    CONTAINER_ERROR_FILE_OPEN,
+    CONTAINER_ERROR_WRITING_FILE,
+    CONTAINER_ERROR_MEMORY,
+    CONTAINER_ERROR_FORMAT,
+    CONTAINER_OK
+};
+
+// texel format stored in the container, the uncompressed ones match PixelFormat
+enum ContainerFormat
+{
+    CONTAINER_LA8,      // luminance-alpha pairs like the .raw file, VK_FORMAT_R8G8_UNORM / A8L8
+    CONTAINER_R8,       // coverage only, VK_FORMAT_R8_UNORM / L8
+    CONTAINER_RGBA8,    // VK_FORMAT_R8G8B8A8_UNORM / A8B8G8R8
+    CONTAINER_BC4,      // VK_FORMAT_BC4_UNORM_BLOCK / ATI1
+    CONTAINER_EAC_R11   // VK_FORMAT_EAC_R11_UNORM_BLOCK, ktx2 only
+};
+
+// the settings shared by both containers.  Levels are stored bottom row first, the
+// same as the .raw file, so the metrics uvs work unchanged.
+struct ContainerSettings
+{
+    ContainerFormat format;
+    BlockQuality quality;   // for CONTAINER_BC4 and CONTAINER_EAC_R11
+    bool premultiplied;     // for CONTAINER_LA8 and CONTAINER_RGBA8, see PIXEL_ConvertRow
+    MipFilter filter;
+    bool zlib;              // deflate each level on its own, ignored by dds
+    int numThreads;
+};
+
+// writes the full mip chain of the width x width coverage as a KTX 2.0 file.
+// The level index gives the offset and size of every level, so a single level can be
+// read from a memory mapped file.  The orientation is recorded as "ru".  The
+// coverage is read in bands of bandRows rows, a multiple of 4, and each band is
+// written into place as soon as it's converted.  With zlib the deflated levels are
+// kept in memory until their sizes are known.
+int CONTAINER_SaveKTX2(const char* filename, int width, const RowSource& alpha, int bandRows,
+                       const ContainerSettings& settings);
+
+// writes the full mip chain as a DDS file with a legacy header, levels follow each
+// other from level 0 down.  DDS has no EAC format, CONTAINER_EAC_R11 returns
+// CONTAINER_ERROR_FORMAT.
+int CONTAINER_SaveDDS(const char* filename, int width, const RowSource& alpha, int bandRows,
+                      const ContainerSettings& settings);
+
+#endif
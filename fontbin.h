@@ -0,0 +1,116 @@
+// Binary font metrics, written by swiftglyph -bin.
+//
+// The file is designed to be memory mapped and used in place: every section is
+// found through byte offsets from the start of the file, all values are little
+// endian and 4 byte aligned, and there are no pointers to fix up.
+//
+// Memory layout
+//
+// 0                      | FontBinHeader
+// glyph_offset           | FontBinGlyph[num_glyphs], sorted by codepoint
+// kerning_offset         | FontBinKerning[num_kerning], sorted by (first, second)
+// texture_filename_offset| nul terminated name of the texture file
+//
+
+#ifndef FONTBINH
+#define FONTBINH
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FONTBIN_MAGIC 0x46475753u   // "SWGF"
+#define FONTBIN_VERSION 1u
+
+// FontBinHeader.flags
+#define FONTBIN_FLAG_VFLIP 0x1u     // uvs were generated with -vflip
+
+// FontBinGlyph.flags
+#define FONTBIN_GLYPH_ROTATED 0x1u  // stored turned 90 degrees clockwise, see README
+
+struct FontBinHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t flags;
+    int32_t texture_width;
+    uint32_t num_glyphs;
+    uint32_t glyph_offset;
+    uint32_t num_kerning;
+    uint32_t kerning_offset;
+    uint32_t texture_filename_offset;
+    uint32_t sdf_spread;        // distance field spread in texels, 0 for a coverage atlas
+    uint32_t reserved[5];
+};
+
+struct FontBinGlyph
+{
+    uint32_t codepoint;
+    uint32_t char_index;        // FreeType glyph index
+    float xy_lower_left[2];
+    float xy_upper_right[2];
+    float uv_lower_left[2];
+    float uv_upper_right[2];
+    float advance[2];
+    uint32_t flags;
+};
+
+struct FontBinKerning
+{
+    uint32_t first;             // index into the glyph array
+    uint32_t second;            // index into the glyph array
+    float kerning[2];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// checks the header and that every section lies inside the size bytes at data.
+// Call this once after mapping, the accessors below don't check anything.
+static inline int fontbin_validate(const void* data, size_t size)
+{
+    const struct FontBinHeader* h = (const struct FontBinHeader*)data;
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t name;
+    if (size < sizeof(struct FontBinHeader) || ((uintptr_t)data & 3) != 0)
+        return 0;
+    if (h->magic != FONTBIN_MAGIC || h->version != FONTBIN_VERSION || h->file_size != size)
+        return 0;
+    if ((h->glyph_offset & 3) || (h->kerning_offset & 3))
+        return 0;
+    if (h->glyph_offset > size || h->num_glyphs > (size - h->glyph_offset) / sizeof(struct FontBinGlyph))
+        return 0;
+    if (h->kerning_offset > size || h->num_kerning > (size - h->kerning_offset) / sizeof(struct FontBinKerning))
+        return 0;
+    if (h->texture_filename_offset >= size)
+        return 0;
+    for (name = h->texture_filename_offset; name < size && bytes[name]; ++name) {}
+    return name < size;
+}
+
+static inline const struct FontBinHeader* fontbin_header(const void* data)
+{
+    return (const struct FontBinHeader*)data;
+}
+
+static inline const struct FontBinGlyph* fontbin_glyphs(const void* data)
+{
+    return (const struct FontBinGlyph*)((const unsigned char*)data + fontbin_header(data)->glyph_offset);
+}
+
+static inline const struct FontBinKerning* fontbin_kerning(const void* data)
+{
+    return (const struct FontBinKerning*)((const unsigned char*)data + fontbin_header(data)->kerning_offset);
+}
+
+static inline const char* fontbin_texture_filename(const void* data)
+{
+    return (const char*)data + fontbin_header(data)->texture_filename_offset;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,167 @@
+// Compact binary font metrics, written by swiftglyph -bin16.
+//
+// The same sections as fontbin.h with quantized values, 28 bytes a glyph instead
+// of 52 and 6 bytes a kerning pair instead of 16:
+//
+// * uvs are unorm16, value / 65535.  Textures are at most 32768 texels wide, so a
+//   decoded uv is within a quarter texel of the float uv of the .bin, and
+//   rounding uv * texture_width gives back the exact texel edge.
+// * xy, advance and kerning are FreeType 26.6 pixels, which is what the font is
+//   rendered from, so they hold the same values as the .bin.  Dividing by
+//   line_height gives the units of line height of the .bin, to float rounding.
+// * kerning is horizontal only.
+//
+// Memory layout
+//
+// 0                      | FontBin16Header
+// glyph_offset           | FontBin16Glyph[num_glyphs], sorted by codepoint
+// kerning_offset         | FontBin16Kerning[num_kerning], sorted by (first, second)
+// texture_filename_offset| nul terminated name of the texture file
+//
+
+#ifndef FONTBIN16H
+#define FONTBIN16H
+
+#include "fontbin.h"
+
+#define FONTBIN16_MAGIC 0x51475753u // "SWGQ"
+#define FONTBIN16_VERSION 1u
+
+struct FontBin16Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t flags;             // FONTBIN_FLAG_ values
+    int32_t texture_width;
+    uint32_t num_glyphs;
+    uint32_t glyph_offset;
+    uint32_t num_kerning;
+    uint32_t kerning_offset;
+    uint32_t texture_filename_offset;
+    uint32_t sdf_spread;
+    float line_height;          // in pixels
+    uint32_t reserved[4];
+};
+
+struct FontBin16Glyph
+{
+    uint32_t codepoint;
+    uint16_t char_index;        // FreeType glyph index
+    uint16_t flags;             // FONTBIN_GLYPH_ values
+    int16_t xy_lower_left[2];   // 26.6 pixels
+    int16_t xy_upper_right[2];
+    uint16_t uv_lower_left[2];  // unorm16
+    uint16_t uv_upper_right[2];
+    int16_t advance[2];
+};
+
+struct FontBin16Kerning
+{
+    uint16_t first;             // index into the glyph array
+    uint16_t second;            // index into the glyph array
+    int16_t kerning;            // horizontal, 26.6 pixels
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// checks the header and that every section lies inside the size bytes at data.
+static inline int fontbin16_validate(const void* data, size_t size)
+{
+    const struct FontBin16Header* h = (const struct FontBin16Header*)data;
+    const unsigned char* bytes = (const unsigned char*)data;
+    size_t name;
+    if (size < sizeof(struct FontBin16Header) || ((uintptr_t)data & 3) != 0)
+        return 0;
+    if (h->magic != FONTBIN16_MAGIC || h->version != FONTBIN16_VERSION || h->file_size != size)
+        return 0;
+    if ((h->glyph_offset & 3) || (h->kerning_offset & 1) || !(h->line_height > 0.0f))
+        return 0;
+    if (h->glyph_offset > size || h->num_glyphs > (size - h->glyph_offset) / sizeof(struct FontBin16Glyph))
+        return 0;
+    if (h->kerning_offset > size || h->num_kerning > (size - h->kerning_offset) / sizeof(struct FontBin16Kerning))
+        return 0;
+    if (h->texture_filename_offset >= size)
+        return 0;
+    for (name = h->texture_filename_offset; name < size && bytes[name]; ++name) {}
+    return name < size;
+}
+
+static inline const struct FontBin16Header* fontbin16_header(const void* data)
+{
+    return (const struct FontBin16Header*)data;
+}
+
+static inline const struct FontBin16Glyph* fontbin16_glyphs(const void* data)
+{
+    return (const struct FontBin16Glyph*)((const unsigned char*)data + fontbin16_header(data)->glyph_offset);
+}
+
+static inline const struct FontBin16Kerning* fontbin16_kerning(const void* data)
+{
+    return (const struct FontBin16Kerning*)((const unsigned char*)data + fontbin16_header(data)->kerning_offset);
+}
+
+static inline const char* fontbin16_texture_filename(const void* data)
+{
+    return (const char*)data + fontbin16_header(data)->texture_filename_offset;
+}
+
+static inline float fontbin16_unorm(uint16_t value)
+{
+    return (float)value / 65535.0f;
+}
+
+// 26.6 pixels to units of line height
+static inline float fontbin16_fixed(const void* data, int16_t value)
+{
+    return (float)value / (64.0f * fontbin16_header(data)->line_height);
+}
+
+// expands glyph i into the float record of fontbin.h.
+static inline void fontbin16_decode_glyph(const void* data, uint32_t i, struct FontBinGlyph* glyph)
+{
+    const struct FontBin16Glyph* g = fontbin16_glyphs(data) + i;
+    int k;
+    glyph->codepoint = g->codepoint;
+    glyph->char_index = g->char_index;
+    for (k = 0; k < 2; ++k)
+    {
+        glyph->xy_lower_left[k] = fontbin16_fixed(data, g->xy_lower_left[k]);
+        glyph->xy_upper_right[k] = fontbin16_fixed(data, g->xy_upper_right[k]);
+        glyph->uv_lower_left[k] = fontbin16_unorm(g->uv_lower_left[k]);
+        glyph->uv_upper_right[k] = fontbin16_unorm(g->uv_upper_right[k]);
+        glyph->advance[k] = fontbin16_fixed(data, g->advance[k]);
+    }
+    glyph->flags = g->flags;
+}
+
+// horizontal kerning between two glyph array positions in units of line height,
+// zero if the pair isn't kerned.  A binary search of the kerning table.
+static inline float fontbin16_find_kerning(const void* data, uint32_t first, uint32_t second)
+{
+    const struct FontBin16Kerning* pairs = fontbin16_kerning(data);
+    const uint32_t key = (first << 16) | second;
+    uint32_t lo = 0;
+    uint32_t hi = fontbin16_header(data)->num_kerning;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t pair = ((uint32_t)pairs[mid].first << 16) | pairs[mid].second;
+        if (pair == key)
+            return fontbin16_fixed(data, pairs[mid].kerning);
+        if (pair < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return 0.0f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
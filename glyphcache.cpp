@@ -0,0 +1,354 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "glyphcache.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+static const uint32_t kCacheMagic = 0x43475753;     // "SWGC"
+static const uint32_t kCacheVersion = 1;
+static const char* kCacheExtension = ".glyph";
+
+struct GlyphCache
+{
+    std::string directory;
+    uint64_t maxBytes;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> bytesEvicted;
+    std::atomic<unsigned int> tempCounter;
+};
+
+// stored at the start of every glyph file, followed by width * rows pixels.
+// The whole key is kept so a hash collision reads as a miss.
+struct CacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fontHash;
+    int32_t pixels;
+    int32_t renderMode;
+    uint32_t glyphIndex;
+    uint32_t freeTypeVersion;
+    int32_t width;
+    int32_t rows;
+    int32_t metrics[8];
+};
+
+struct CacheFileInfo
+{
+    std::string path;
+    uint64_t size;
+    time_t lastUsed;
+};
+
+static const uint32_t kFreeTypeVersion = (FREETYPE_MAJOR << 16) | (FREETYPE_MINOR << 8) | FREETYPE_PATCH;
+
+// 64 bit FNV-1a
+static uint64_t Hash(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static const uint64_t kHashSeed = 0xcbf29ce484222325ull;
+
+#ifdef _WIN32
+
+static bool MakeDirectory(const std::string& path)
+{
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+}
+
+static void Touch(const std::string& path)
+{
+    _utime(path.c_str(), NULL);
+}
+
+static bool ReplaceFile(const std::string& from, const std::string& to)
+{
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+static int ProcessId()
+{
+    return _getpid();
+}
+
+static void ListFiles(const std::string& directory, std::vector<CacheFileInfo>* files)
+{
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        std::string name = data.cFileName;
+        if (name.size() <= strlen(kCacheExtension) ||
+            name.compare(name.size() - strlen(kCacheExtension), std::string::npos, kCacheExtension) != 0)
+            continue;
+        struct _stat st;
+        std::string path = directory + "\\" + name;
+        if (_stat(path.c_str(), &st) != 0)
+            continue;
+        CacheFileInfo info = { path, (uint64_t)st.st_size, st.st_mtime };
+        files->push_back(info);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+}
+
+#else
+
+static bool MakeDirectory(const std::string& path)
+{
+    return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+static void Touch(const std::string& path)
+{
+    utime(path.c_str(), NULL);
+}
+
+static bool ReplaceFile(const std::string& from, const std::string& to)
+{
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+static int ProcessId()
+{
+    return (int)getpid();
+}
+
+static void ListFiles(const std::string& directory, std::vector<CacheFileInfo>* files)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == NULL)
+        return;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        std::string name = entry->d_name;
+        if (name.size() <= strlen(kCacheExtension) ||
+            name.compare(name.size() - strlen(kCacheExtension), std::string::npos, kCacheExtension) != 0)
+            continue;
+        struct stat st;
+        std::string path = directory + "/" + name;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+        CacheFileInfo info = { path, (uint64_t)st.st_size, st.st_mtime };
+        files->push_back(info);
+    }
+    closedir(dir);
+}
+
+#endif
+
+// glyphs are spread over 256 sub directories by the first byte of their hash,
+// which keeps directories small enough for every file system.
+static void GlyphPath(const GlyphCache* cache, const GlyphCacheKey& key, std::string* subdirectory,
+                      std::string* path)
+{
+    uint64_t hash = kHashSeed;
+    hash = Hash(hash, &key.fontHash, sizeof(key.fontHash));
+    hash = Hash(hash, &key.pixels, sizeof(key.pixels));
+    hash = Hash(hash, &key.renderMode, sizeof(key.renderMode));
+    hash = Hash(hash, &key.glyphIndex, sizeof(key.glyphIndex));
+    hash = Hash(hash, &kFreeTypeVersion, sizeof(kFreeTypeVersion));
+
+    char name[32];
+    snprintf(name, sizeof(name), "%02x", (unsigned int)(hash >> 56));
+    *subdirectory = cache->directory + "/" + name;
+    snprintf(name, sizeof(name), "/%014llx", (unsigned long long)(hash & 0x00ffffffffffffffull));
+    *path = *subdirectory + name + kCacheExtension;
+}
+
+uint64_t CACHE_HashFont(const unsigned char* data, size_t size)
+{
+    return Hash(kHashSeed, data, size);
+}
+
+int CACHE_Open(const char* directory, uint64_t maxBytes, GlyphCache** cache)
+{
+    *cache = NULL;
+    if (!MakeDirectory(directory))
+        return CACHE_ERROR_DIRECTORY;
+
+    GlyphCache* result = new GlyphCache;
+    result->directory = directory;
+    result->maxBytes = maxBytes;
+    result->hits = 0;
+    result->misses = 0;
+    result->bytesRead = 0;
+    result->bytesWritten = 0;
+    result->bytesEvicted = 0;
+    result->tempCounter = 0;
+    *cache = result;
+    return CACHE_OK;
+}
+
+bool CACHE_Load(GlyphCache* cache, const GlyphCacheKey& key, GlyphBitmap* bitmap)
+{
+    std::string subdirectory, path;
+    GlyphPath(cache, key, &subdirectory, &path);
+
+    bool ok = false;
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp != NULL)
+    {
+        CacheFileHeader header;
+        ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+            header.magic == kCacheMagic && header.version == kCacheVersion &&
+            header.fontHash == key.fontHash && header.pixels == key.pixels &&
+            header.renderMode == key.renderMode && header.glyphIndex == key.glyphIndex &&
+            header.freeTypeVersion == kFreeTypeVersion &&
+            header.width >= 0 && header.rows >= 0 && header.width <= 0x10000 && header.rows <= 0x10000;
+        if (ok)
+        {
+            size_t numPixels = (size_t)header.width * header.rows;
+            bitmap->width = header.width;
+            bitmap->rows = header.rows;
+            bitmap->metrics.width = header.metrics[0];
+            bitmap->metrics.height = header.metrics[1];
+            bitmap->metrics.horiBearingX = header.metrics[2];
+            bitmap->metrics.horiBearingY = header.metrics[3];
+            bitmap->metrics.horiAdvance = header.metrics[4];
+            bitmap->metrics.vertBearingX = header.metrics[5];
+            bitmap->metrics.vertBearingY = header.metrics[6];
+            bitmap->metrics.vertAdvance = header.metrics[7];
+            bitmap->pixels.resize(numPixels);
+            ok = numPixels == 0 || fread(&bitmap->pixels[0], 1, numPixels, fp) == numPixels;
+            if (ok)
+                cache->bytesRead += sizeof(header) + numPixels;
+        }
+        fclose(fp);
+    }
+
+    if (ok)
+    {
+        cache->hits++;
+        Touch(path);
+    }
+    else
+    {
+        cache->misses++;
+    }
+    return ok;
+}
+
+void CACHE_Store(GlyphCache* cache, const GlyphCacheKey& key, const GlyphBitmap& bitmap)
+{
+    std::string subdirectory, path;
+    GlyphPath(cache, key, &subdirectory, &path);
+    if (!MakeDirectory(subdirectory))
+        return;
+
+    CacheFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kCacheMagic;
+    header.version = kCacheVersion;
+    header.fontHash = key.fontHash;
+    header.pixels = key.pixels;
+    header.renderMode = key.renderMode;
+    header.glyphIndex = key.glyphIndex;
+    header.freeTypeVersion = kFreeTypeVersion;
+    header.width = bitmap.width;
+    header.rows = bitmap.rows;
+    header.metrics[0] = (int32_t)bitmap.metrics.width;
+    header.metrics[1] = (int32_t)bitmap.metrics.height;
+    header.metrics[2] = (int32_t)bitmap.metrics.horiBearingX;
+    header.metrics[3] = (int32_t)bitmap.metrics.horiBearingY;
+    header.metrics[4] = (int32_t)bitmap.metrics.horiAdvance;
+    header.metrics[5] = (int32_t)bitmap.metrics.vertBearingX;
+    header.metrics[6] = (int32_t)bitmap.metrics.vertBearingY;
+    header.metrics[7] = (int32_t)bitmap.metrics.vertAdvance;
+
+    // write under a name of our own and rename it into place, so other threads and
+    // processes never see a partially written glyph.
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%d_%u.tmp", ProcessId(), cache->tempCounter++);
+    std::string tempPath = path + suffix;
+    FILE* fp = fopen(tempPath.c_str(), "wb");
+    if (fp == NULL)
+        return;
+    size_t numPixels = bitmap.pixels.size();
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        (numPixels == 0 || fwrite(&bitmap.pixels[0], 1, numPixels, fp) == numPixels);
+    if (fclose(fp) != 0)
+        ok = false;
+
+    if (ok && ReplaceFile(tempPath, path))
+        cache->bytesWritten += sizeof(header) + numPixels;
+    else
+        remove(tempPath.c_str());
+}
+
+static bool LessRecentlyUsed(const CacheFileInfo& a, const CacheFileInfo& b)
+{
+    return a.lastUsed < b.lastUsed;
+}
+
+void CACHE_Close(GlyphCache* cache, GlyphCacheStats* stats)
+{
+    std::vector<CacheFileInfo> files;
+    uint64_t totalBytes = 0;
+    for (int i = 0; i < 256; ++i)
+    {
+        char name[8];
+        snprintf(name, sizeof(name), "/%02x", i);
+        ListFiles(cache->directory + name, &files);
+    }
+    for (size_t i = 0; i < files.size(); ++i)
+        totalBytes += files[i].size;
+
+    // mtimes only have a resolution of a second or so, glyphs used in the same
+    // second are evicted in no particular order.
+    if (totalBytes > cache->maxBytes)
+    {
+        std::sort(files.begin(), files.end(), LessRecentlyUsed);
+        for (size_t i = 0; i < files.size() && totalBytes > cache->maxBytes; ++i)
+        {
+            if (remove(files[i].path.c_str()) == 0)
+            {
+                totalBytes -= files[i].size;
+                cache->bytesEvicted += files[i].size;
+            }
+        }
+    }
+
+    if (stats)
+    {
+        stats->hits = cache->hits;
+        stats->misses = cache->misses;
+        stats->bytesRead = cache->bytesRead;
+        stats->bytesWritten = cache->bytesWritten;
+        stats->bytesEvicted = cache->bytesEvicted;
+    }
+    delete cache;
+}
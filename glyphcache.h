@@ -0,0 +1,53 @@
+// On-disk cache of rendered glyphs, shared between runs.
+
+#ifndef GLYPHCACHEH
+#define GLYPHCACHEH
+
+#include <stddef.h>
+#include <stdint.h>
+#include "raster.h"
+
+enum
+{
+    CACHE_ERROR_DIRECTORY,
+    CACHE_OK
+};
+
+// everything a rendered glyph depends on.  The FreeType version is added when
+// the key is hashed, so upgrading FreeType starts from an empty cache.
+struct GlyphCacheKey
+{
+    uint64_t fontHash;      // CACHE_HashFont of the whole font file
+    int pixels;
+    int renderMode;         // 0 for coverage, the spread for distance fields
+    FT_UInt glyphIndex;
+};
+
+struct GlyphCacheStats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint64_t bytesEvicted;
+};
+
+struct GlyphCache;
+
+uint64_t CACHE_HashFont(const unsigned char* data, size_t size);
+
+// opens the cache kept in directory, creating the directory if needed.  Once
+// maxBytes is exceeded the least recently used glyphs are removed by CACHE_Close.
+int CACHE_Open(const char* directory, uint64_t maxBytes, GlyphCache** cache);
+
+// both are safe to call from any number of threads at once, and from several
+// processes sharing the directory.  Each glyph is stored as its own file named
+// after the hash of its key, and a hit marks the file as recently used.
+bool CACHE_Load(GlyphCache* cache, const GlyphCacheKey& key, GlyphBitmap* bitmap);
+void CACHE_Store(GlyphCache* cache, const GlyphCacheKey& key, const GlyphBitmap& bitmap);
+
+// evicts down to the size limit and frees the cache.  If stats isn't NULL it
+// receives the totals for everything done since CACHE_Open.
+void CACHE_Close(GlyphCache* cache, GlyphCacheStats* stats);
+
+#endif
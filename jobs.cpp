@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "jobs.h"
+
+// a worker's remaining [begin, end) range packed into one word, so the owner taking
+// from the front and thieves taking from the back can both use compare and swap.
+struct WorkRange
+{
+    std::atomic<uint64_t> range;
+    char pad[64 - sizeof(std::atomic<uint64_t>)];   // keep each range on its own cache line
+};
+
+static uint64_t PackRange(uint32_t begin, uint32_t end)
+{
+    return ((uint64_t)begin << 32) | end;
+}
+
+static bool PopFront(WorkRange* work, int* index)
+{
+    uint64_t value = work->range.load();
+    for (;;)
+    {
+        uint32_t begin = (uint32_t)(value >> 32);
+        uint32_t end = (uint32_t)value;
+        if (begin >= end)
+            return false;
+        if (work->range.compare_exchange_weak(value, PackRange(begin + 1, end)))
+        {
+            *index = (int)begin;
+            return true;
+        }
+    }
+}
+
+static bool StealBack(WorkRange* victim, uint32_t* stolenBegin, uint32_t* stolenEnd)
+{
+    uint64_t value = victim->range.load();
+    for (;;)
+    {
+        uint32_t begin = (uint32_t)(value >> 32);
+        uint32_t end = (uint32_t)value;
+        if (begin >= end)
+            return false;
+        uint32_t mid = begin + (end - begin) / 2;
+        if (victim->range.compare_exchange_weak(value, PackRange(begin, mid)))
+        {
+            *stolenBegin = mid;
+            *stolenEnd = end;
+            return true;
+        }
+    }
+}
+
+static void WorkerLoop(int worker, int numWorkers, WorkRange* ranges,
+                       const std::function<void(int, int)>* fn)
+{
+    for (;;)
+    {
+        int index;
+        while (PopFront(&ranges[worker], &index))
+            (*fn)(worker, index);
+
+        // our own range is empty so nobody can steal from it, safe to just store.
+        bool stole = false;
+        for (int i = 1; i < numWorkers && !stole; ++i)
+        {
+            uint32_t begin, end;
+            if (StealBack(&ranges[(worker + i) % numWorkers], &begin, &end))
+            {
+                ranges[worker].range.store(PackRange(begin, end));
+                stole = true;
+            }
+        }
+        if (!stole)
+            return;
+    }
+}
+
+int JOB_ThreadCount(int numThreads)
+{
+    if (numThreads > 0)
+        return numThreads;
+    int hardware = (int)std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void JOB_ParallelFor(int count, int numThreads, const std::function<void(int worker, int index)>& fn)
+{
+    int numWorkers = JOB_ThreadCount(numThreads);
+    if (numWorkers > count)
+        numWorkers = count;
+    if (numWorkers <= 1)
+    {
+        for (int i = 0; i < count; ++i)
+            fn(0, i);
+        return;
+    }
+
+    std::vector<WorkRange> ranges(numWorkers);
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        uint32_t begin = (uint32_t)((int64_t)count * i / numWorkers);
+        uint32_t end = (uint32_t)((int64_t)count * (i + 1) / numWorkers);
+        ranges[i].range.store(PackRange(begin, end));
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numWorkers; ++i)
+        threads.push_back(std::thread(WorkerLoop, i, numWorkers, &ranges[0], &fn));
+    WorkerLoop(0, numWorkers, &ranges[0], &fn);
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+}
@@ -0,0 +1,18 @@
+// Parallel loops with work stealing.
+
+#ifndef JOBSH
+#define JOBSH
+
+#include <functional>
+
+// returns numThreads, or the number of hardware threads if numThreads is 0 or less.
+int JOB_ThreadCount(int numThreads);
+
+// calls fn(worker, index) once for every index in [0, count) using up to numThreads
+// threads, the calling thread is always worker 0.  Each worker starts on an equal
+// slice of the range, once its own slice runs dry it steals the back half of the
+// slice of another worker.  Indices are not visited in any particular order, so fn
+// must only write to state owned by that index or that worker.
+void JOB_ParallelFor(int count, int numThreads, const std::function<void(int worker, int index)>& fn);
+
+#endif
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "kerning.h"
+#include "raster.h"
+#include "jobs.h"
+#include FT_TRUETYPE_TABLES_H
+#include FT_TRUETYPE_TAGS_H
+
+typedef std::pair<FT_UInt, int> GlyphSlot;  // glyph index, position in the glyph table
+
+static unsigned int ReadU16(const FT_Byte* p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static bool PairLess(const KerningPair& a, const KerningPair& b)
+{
+    return (a.first != b.first) ? a.first < b.first : a.second < b.second;
+}
+
+// reads the left/right glyph pairs out of the format 0 subtables of a version 0 'kern'
+// table, the only kind FT_Get_Kerning looks at for sfnt fonts.  Returns false if
+// the face has no such table and the pairs have to be found the slow way.
+static bool LoadKernTablePairs(FT_Face face, std::vector<std::pair<FT_UInt, FT_UInt> >* glyphPairs)
+{
+    FT_ULong length = 0;
+    if (!FT_IS_SFNT(face) || FT_Load_Sfnt_Table(face, TTAG_kern, 0, NULL, &length) || length < 4)
+        return false;
+
+    std::vector<FT_Byte> table(length);
+    if (FT_Load_Sfnt_Table(face, TTAG_kern, 0, &table[0], &length))
+        return false;
+
+    const FT_Byte* p = &table[0];
+    const FT_Byte* end = p + length;
+    if (ReadU16(p) != 0)
+        return false;
+    unsigned int numTables = ReadU16(p + 2);
+    p += 4;
+
+    for (unsigned int t = 0; t < numTables && p + 14 <= end; ++t)
+    {
+        unsigned int subLength = ReadU16(p + 2);
+        unsigned int coverage = ReadU16(p + 4);
+        unsigned int numPairs = ReadU16(p + 6);
+
+        // same test as FreeType: format 0, horizontal, not minimum, not cross-stream.
+        // The length field overflows for big subtables, so trust the pair count instead.
+        if ((coverage & ~8u) == 0x0001)
+        {
+            const FT_Byte* pair = p + 14;
+            for (unsigned int i = 0; i < numPairs && pair + 6 <= end; ++i, pair += 6)
+                glyphPairs->push_back(std::make_pair((FT_UInt)ReadU16(pair), (FT_UInt)ReadU16(pair + 2)));
+            p += 14 + numPairs * 6;
+        }
+        else
+        {
+            if (subLength < 6)
+                break;
+            p += subLength;
+        }
+    }
+    return true;
+}
+
+// every combination of glyphs, each row of the table is one job.
+static void BuildAllPairs(const unsigned char* fontData, size_t fontSize, int pixels,
+                          const FT_UInt* glyphIndices, int numGlyphs, int numThreads,
+                          std::vector<KerningPair>* pairs)
+{
+    struct Worker
+    {
+        FT_Library library;
+        FT_Face face;
+    };
+    std::vector<Worker> workers(JOB_ThreadCount(numThreads));
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].library = 0;
+        workers[i].face = 0;
+    }
+    std::vector<std::vector<KerningPair> > rows(numGlyphs);
+
+    JOB_ParallelFor(numGlyphs, (int)workers.size(), [&](int worker, int i) {
+        Worker& w = workers[worker];
+        if (w.face == 0 && RASTER_OpenFace(fontData, fontSize, pixels, &w.library, &w.face))
+            return;
+
+        for (int j = 0; j < numGlyphs; ++j)
+        {
+            KerningPair pair;
+            FT_Get_Kerning(w.face, glyphIndices[i], glyphIndices[j], FT_KERNING_UNFITTED, &pair.kerning);
+            if (pair.kerning.x != 0 || pair.kerning.y != 0)
+            {
+                pair.first = i;
+                pair.second = j;
+                rows[i].push_back(pair);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        RASTER_CloseFace(workers[i].library, workers[i].face);
+    for (int i = 0; i < numGlyphs; ++i)
+        pairs->insert(pairs->end(), rows[i].begin(), rows[i].end());
+}
+
+void KERNING_Build(FT_Face face, const unsigned char* fontData, size_t fontSize, int pixels,
+                   const FT_UInt* glyphIndices, int numGlyphs, int numThreads,
+                   std::vector<KerningPair>* pairs)
+{
+    pairs->clear();
+    if (!FT_HAS_KERNING(face))
+        return;
+
+    std::vector<std::pair<FT_UInt, FT_UInt> > glyphPairs;
+    if (!LoadKernTablePairs(face, &glyphPairs))
+    {
+        BuildAllPairs(fontData, fontSize, pixels, glyphIndices, numGlyphs, numThreads, pairs);
+        return;
+    }
+
+    // several codepoints can map to the same glyph, so a glyph index can own more than one slot.
+    std::vector<GlyphSlot> slots(numGlyphs);
+    for (int i = 0; i < numGlyphs; ++i)
+        slots[i] = GlyphSlot(glyphIndices[i], i);
+    std::sort(slots.begin(), slots.end());
+
+    std::sort(glyphPairs.begin(), glyphPairs.end());
+    glyphPairs.erase(std::unique(glyphPairs.begin(), glyphPairs.end()), glyphPairs.end());
+
+    for (size_t i = 0; i < glyphPairs.size(); ++i)
+    {
+        std::vector<GlyphSlot>::const_iterator firstBegin = std::lower_bound(slots.begin(), slots.end(), GlyphSlot(glyphPairs[i].first, -1));
+        if (firstBegin == slots.end() || firstBegin->first != glyphPairs[i].first)
+            continue;
+        std::vector<GlyphSlot>::const_iterator secondBegin = std::lower_bound(slots.begin(), slots.end(), GlyphSlot(glyphPairs[i].second, -1));
+        if (secondBegin == slots.end() || secondBegin->first != glyphPairs[i].second)
+            continue;
+
+        // let FreeType do the scaling so the values match FT_Get_Kerning exactly.
+        FT_Vector kerning;
+        FT_Get_Kerning(face, glyphPairs[i].first, glyphPairs[i].second, FT_KERNING_UNFITTED, &kerning);
+        if (kerning.x == 0 && kerning.y == 0)
+            continue;
+
+        for (std::vector<GlyphSlot>::const_iterator a = firstBegin; a != slots.end() && a->first == glyphPairs[i].first; ++a)
+        {
+            for (std::vector<GlyphSlot>::const_iterator b = secondBegin; b != slots.end() && b->first == glyphPairs[i].second; ++b)
+            {
+                KerningPair pair;
+                pair.first = a->second;
+                pair.second = b->second;
+                pair.kerning = kerning;
+                pairs->push_back(pair);
+            }
+        }
+    }
+
+    std::sort(pairs->begin(), pairs->end(), PairLess);
+}
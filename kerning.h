@@ -0,0 +1,26 @@
+// Kerning table shared by every metrics exporter.
+
+#ifndef KERNINGH
+#define KERNINGH
+
+#include <stddef.h>
+#include <vector>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+struct KerningPair
+{
+    int first;          // index of the first glyph in the glyph table
+    int second;         // index of the second glyph in the glyph table
+    FT_Vector kerning;  // unfitted 26.6 kerning
+};
+
+// collects every non-zero kerning pair between the glyphs in glyphIndices, sorted by
+// (first, second).  Nothing is done if the face has no kerning.  When the face has
+// an sfnt 'kern' table only the pairs listed in it are looked up, otherwise every
+// pair is evaluated, spread over numThreads threads each with its own face.
+void KERNING_Build(FT_Face face, const unsigned char* fontData, size_t fontSize, int pixels,
+                   const FT_UInt* glyphIndices, int numGlyphs, int numThreads,
+                   std::vector<KerningPair>* pairs);
+
+#endif
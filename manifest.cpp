@@ -0,0 +1,538 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "manifest.h"
+#include "charset.h"
+
+FontJob::FontJob() :
+    textureWidth(512),
+    padding(1),
+    pixels(0),
+    sdf(false),
+    sdfSpread(4),
+    packHeuristic(PACK_MAXRECTS),
+    rotate(false),
+    vflip(false),
+    mipFilter(MIP_FILTER_BOX),
+    blockQuality(BLOCK_QUALITY_NORMAL),
+    textureFormat(CONTAINER_LA8),
+    premultiplied(false),
+    zlib(false),
+    rle(false),
+    pngColorType(PNG_COLOR_GRAY_ALPHA),
+    textures(MANIFEST_TEXTURE_RAW),
+    metrics(MANIFEST_METRICS_YAML)
+{
+}
+
+// just enough json for manifests, numbers are kept as doubles.
+struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type;
+    int line;
+    bool boolean;
+    double number;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue> > members;
+};
+
+struct JsonParser
+{
+    const char* p;
+    const char* end;
+    int line;
+    std::string* error;
+};
+
+static bool Fail(JsonParser* parser, const char* message)
+{
+    char text[256];
+    snprintf(text, sizeof(text), "line %d: %s", parser->line, message);
+    *parser->error = text;
+    return false;
+}
+
+static void SkipSpace(JsonParser* parser)
+{
+    while (parser->p < parser->end &&
+           (*parser->p == ' ' || *parser->p == '\t' || *parser->p == '\r' || *parser->p == '\n'))
+    {
+        if (*parser->p == '\n')
+            parser->line++;
+        parser->p++;
+    }
+}
+
+static bool Match(JsonParser* parser, const char* word)
+{
+    size_t length = strlen(word);
+    if ((size_t)(parser->end - parser->p) < length || memcmp(parser->p, word, length) != 0)
+        return false;
+    parser->p += length;
+    return true;
+}
+
+static bool ParseString(JsonParser* parser, std::string* out)
+{
+    parser->p++;    // opening quote
+    while (parser->p < parser->end && *parser->p != '"')
+    {
+        char c = *parser->p++;
+        if (c == '\n')
+            return Fail(parser, "unterminated string");
+        if (c != '\\')
+        {
+            out->push_back(c);
+            continue;
+        }
+
+        if (parser->p >= parser->end)
+            break;
+        c = *parser->p++;
+        switch (c)
+        {
+        case '"': case '\\': case '/': out->push_back(c); break;
+        case 'b': out->push_back('\b'); break;
+        case 'f': out->push_back('\f'); break;
+        case 'n': out->push_back('\n'); break;
+        case 'r': out->push_back('\r'); break;
+        case 't': out->push_back('\t'); break;
+        case 'u':
+        {
+            // paths and ranges are ascii in practice, anything else is passed on as utf-8.
+            char hex[5] = { 0 };
+            if (parser->end - parser->p < 4)
+                return Fail(parser, "bad \\u escape");
+            memcpy(hex, parser->p, 4);
+            parser->p += 4;
+            char* hexEnd;
+            unsigned long value = strtoul(hex, &hexEnd, 16);
+            if (hexEnd != hex + 4)
+                return Fail(parser, "bad \\u escape");
+            if (value < 0x80)
+                out->push_back((char)value);
+            else if (value < 0x800)
+            {
+                out->push_back((char)(0xC0 | (value >> 6)));
+                out->push_back((char)(0x80 | (value & 0x3F)));
+            }
+            else
+            {
+                out->push_back((char)(0xE0 | (value >> 12)));
+                out->push_back((char)(0x80 | ((value >> 6) & 0x3F)));
+                out->push_back((char)(0x80 | (value & 0x3F)));
+            }
+            break;
+        }
+        default:
+            return Fail(parser, "bad escape in string");
+        }
+    }
+    if (parser->p >= parser->end)
+        return Fail(parser, "unterminated string");
+    parser->p++;    // closing quote
+    return true;
+}
+
+static bool ParseValue(JsonParser* parser, JsonValue* value, int depth)
+{
+    SkipSpace(parser);
+    value->line = parser->line;
+    if (depth > 32)
+        return Fail(parser, "nested too deeply");
+    if (parser->p >= parser->end)
+        return Fail(parser, "unexpected end of file");
+
+    char c = *parser->p;
+    if (c == '{')
+    {
+        value->type = JsonValue::Object;
+        parser->p++;
+        SkipSpace(parser);
+        if (parser->p < parser->end && *parser->p == '}')
+        {
+            parser->p++;
+            return true;
+        }
+        for (;;)
+        {
+            SkipSpace(parser);
+            if (parser->p >= parser->end || *parser->p != '"')
+                return Fail(parser, "expected a quoted key");
+            value->members.push_back(std::make_pair(std::string(), JsonValue()));
+            if (!ParseString(parser, &value->members.back().first))
+                return false;
+            SkipSpace(parser);
+            if (parser->p >= parser->end || *parser->p != ':')
+                return Fail(parser, "expected ':' after key");
+            parser->p++;
+            if (!ParseValue(parser, &value->members.back().second, depth + 1))
+                return false;
+            SkipSpace(parser);
+            if (parser->p < parser->end && *parser->p == ',')
+            {
+                parser->p++;
+                continue;
+            }
+            if (parser->p < parser->end && *parser->p == '}')
+            {
+                parser->p++;
+                return true;
+            }
+            return Fail(parser, "expected ',' or '}' in object");
+        }
+    }
+    else if (c == '[')
+    {
+        value->type = JsonValue::Array;
+        parser->p++;
+        SkipSpace(parser);
+        if (parser->p < parser->end && *parser->p == ']')
+        {
+            parser->p++;
+            return true;
+        }
+        for (;;)
+        {
+            value->elements.push_back(JsonValue());
+            if (!ParseValue(parser, &value->elements.back(), depth + 1))
+                return false;
+            SkipSpace(parser);
+            if (parser->p < parser->end && *parser->p == ',')
+            {
+                parser->p++;
+                continue;
+            }
+            if (parser->p < parser->end && *parser->p == ']')
+            {
+                parser->p++;
+                return true;
+            }
+            return Fail(parser, "expected ',' or ']' in array");
+        }
+    }
+    else if (c == '"')
+    {
+        value->type = JsonValue::String;
+        return ParseString(parser, &value->string);
+    }
+    else if (Match(parser, "true") || Match(parser, "false"))
+    {
+        value->type = JsonValue::Bool;
+        value->boolean = (c == 't');
+        return true;
+    }
+    else if (Match(parser, "null"))
+    {
+        value->type = JsonValue::Null;
+        return true;
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        // the buffer is nul terminated, so strtod can't run off the end.
+        char* numberEnd;
+        value->type = JsonValue::Number;
+        value->number = strtod(parser->p, &numberEnd);
+        parser->p = numberEnd;
+        return true;
+    }
+    return Fail(parser, "unexpected character");
+}
+
+static bool ValueError(const JsonValue& value, const std::string& key, const char* expected, std::string* error)
+{
+    char text[256];
+    snprintf(text, sizeof(text), "line %d: \"%s\" should be %s", value.line, key.c_str(), expected);
+    *error = text;
+    return false;
+}
+
+static bool GetInt(const JsonValue& value, const std::string& key, int minValue, int maxValue,
+                   int* out, std::string* error)
+{
+    if (value.type != JsonValue::Number || value.number != (double)(int)value.number ||
+        value.number < minValue || value.number > maxValue)
+    {
+        char expected[64];
+        snprintf(expected, sizeof(expected), "an integer from %d to %d", minValue, maxValue);
+        return ValueError(value, key, expected, error);
+    }
+    *out = (int)value.number;
+    return true;
+}
+
+static bool GetBool(const JsonValue& value, const std::string& key, bool* out, std::string* error)
+{
+    if (value.type != JsonValue::Bool)
+        return ValueError(value, key, "true or false", error);
+    *out = value.boolean;
+    return true;
+}
+
+// looks up a string in a list of names and returns its position, or -1.
+static int GetName(const JsonValue& value, const char* const* names, int numNames)
+{
+    if (value.type != JsonValue::String)
+        return -1;
+    for (int i = 0; i < numNames; ++i)
+        if (value.string == names[i])
+            return i;
+    return -1;
+}
+
+// "textures" and "metrics" are lists of format names, each one sets a bit.
+static bool GetFormats(const JsonValue& value, const std::string& key, const char* const* names,
+                       int numNames, const char* expected, unsigned int* out, std::string* error)
+{
+    if (value.type != JsonValue::Array || value.elements.empty())
+        return ValueError(value, key, expected, error);
+    *out = 0;
+    for (size_t i = 0; i < value.elements.size(); ++i)
+    {
+        int index = GetName(value.elements[i], names, numNames);
+        if (index < 0)
+            return ValueError(value.elements[i], key, expected, error);
+        *out |= 1u << index;
+    }
+    return true;
+}
+
+static bool ParseJob(const JsonValue& value, FontJob* job, std::string* error)
+{
+    static const char* const kPackNames[] = { "skyline", "maxrects" };
+    static const char* const kMipFilterNames[] = { "box", "tent" };
+    static const char* const kPngFormatNames[] = { "gray", "ga", "rgba" };
+    static const char* const kQualityNames[] = { "fast", "normal", "best" };
+    static const char* const kFormatNames[] = { "la8", "r8", "rgba8", "bc4", "eac" };
+    static const char* const kTextureNames[] = { "raw", "tga", "png", "bc4", "eac", "ktx2", "dds" };
+    static const char* const kMetricsNames[] = { "yaml", "lua", "json", "bin", "bin16" };
+
+    if (value.type != JsonValue::Object)
+        return ValueError(value, "jobs", "a list of objects", error);
+
+    bool foundOutput = false;
+    for (size_t i = 0; i < value.members.size(); ++i)
+    {
+        const std::string& key = value.members[i].first;
+        const JsonValue& member = value.members[i].second;
+        bool ok = true;
+        int index;
+        if (key == "font" || key == "output")
+        {
+            if (member.type != JsonValue::String || member.string.empty())
+                return ValueError(member, key, "a filename", error);
+            if (key == "font")
+                job->fontname = member.string;
+            else
+            {
+                job->prefix = member.string;
+                foundOutput = true;
+            }
+        }
+        else if (key == "width")
+        {
+            ok = GetInt(member, key, 1, 1 << 16, &job->textureWidth, error);
+            if (ok && (job->textureWidth & (job->textureWidth - 1)) != 0)
+                return ValueError(member, key, "a power of 2", error);
+        }
+        else if (key == "padding")
+            ok = GetInt(member, key, 0, 10, &job->padding, error);
+        else if (key == "size")
+            ok = GetInt(member, key, 1, 1 << 15, &job->pixels, error);
+        else if (key == "sizes")
+        {
+            if (member.type != JsonValue::Array || member.elements.empty())
+                return ValueError(member, key, "a list of pixel sizes", error);
+            job->sizes.resize(member.elements.size());
+            for (size_t e = 0; e < member.elements.size() && ok; ++e)
+                ok = GetInt(member.elements[e], key, 1, 1 << 15, &job->sizes[e], error);
+        }
+        else if (key == "range")
+        {
+            if (member.type != JsonValue::String ||
+                CHARSET_ParseRanges(member.string.c_str(), &job->codepoints) != CHARSET_OK)
+                return ValueError(member, key, "a list of codepoints or ranges, e.g. \"32-126,0x400-0x4FF\"", error);
+        }
+        else if (key == "charset_file")
+        {
+            if (member.type != JsonValue::String ||
+                CHARSET_LoadFile(member.string.c_str(), &job->codepoints) != CHARSET_OK)
+                return ValueError(member, key, "a readable utf-8 text file", error);
+        }
+        else if (key == "sdf")
+            ok = GetBool(member, key, &job->sdf, error);
+        else if (key == "spread")
+            ok = GetInt(member, key, 1, 64, &job->sdfSpread, error);
+        else if (key == "rotate")
+            ok = GetBool(member, key, &job->rotate, error);
+        else if (key == "vflip")
+            ok = GetBool(member, key, &job->vflip, error);
+        else if (key == "pack")
+        {
+            if ((index = GetName(member, kPackNames, 2)) < 0)
+                return ValueError(member, key, "\"maxrects\" or \"skyline\"", error);
+            job->packHeuristic = (PackHeuristic)index;
+        }
+        else if (key == "mipfilter")
+        {
+            if ((index = GetName(member, kMipFilterNames, 2)) < 0)
+                return ValueError(member, key, "\"box\" or \"tent\"", error);
+            job->mipFilter = (MipFilter)index;
+        }
+        else if (key == "quality")
+        {
+            if ((index = GetName(member, kQualityNames, 3)) < 0)
+                return ValueError(member, key, "\"fast\", \"normal\" or \"best\"", error);
+            job->blockQuality = (BlockQuality)index;
+        }
+        else if (key == "format")
+        {
+            if ((index = GetName(member, kFormatNames, 5)) < 0)
+                return ValueError(member, key, "\"la8\", \"r8\", \"rgba8\", \"bc4\" or \"eac\"", error);
+            job->textureFormat = (ContainerFormat)index;
+        }
+        else if (key == "premultiply")
+            ok = GetBool(member, key, &job->premultiplied, error);
+        else if (key == "zlib")
+            ok = GetBool(member, key, &job->zlib, error);
+        else if (key == "rle")
+            ok = GetBool(member, key, &job->rle, error);
+        else if (key == "pngformat")
+        {
+            if ((index = GetName(member, kPngFormatNames, 3)) < 0)
+                return ValueError(member, key, "\"ga\", \"gray\" or \"rgba\"", error);
+            job->pngColorType = (PngColorType)index;
+        }
+        else if (key == "textures")
+            ok = GetFormats(member, key, kTextureNames, 7,
+                            "a list of \"raw\", \"tga\", \"png\", \"bc4\", \"eac\", \"ktx2\" or \"dds\"",
+                            &job->textures, error);
+        else if (key == "metrics")
+            ok = GetFormats(member, key, kMetricsNames, 5,
+                            "a list of \"yaml\", \"lua\", \"json\", \"bin\" or \"bin16\"",
+                            &job->metrics, error);
+        else
+        {
+            char text[256];
+            snprintf(text, sizeof(text), "line %d: unknown job setting \"%s\"", member.line, key.c_str());
+            *error = text;
+            return false;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    if (job->fontname.empty())
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "line %d: job has no \"font\"", value.line);
+        *error = text;
+        return false;
+    }
+    if ((job->textures & MANIFEST_TEXTURE_DDS) && job->textureFormat == CONTAINER_EAC_R11)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "line %d: dds can't hold eac textures", value.line);
+        *error = text;
+        return false;
+    }
+    if ((job->textures & (MANIFEST_TEXTURE_RAW | MANIFEST_TEXTURE_TGA)) &&
+        (job->textureFormat == CONTAINER_BC4 || job->textureFormat == CONTAINER_EAC_R11))
+    {
+        char text[96];
+        snprintf(text, sizeof(text), "line %d: raw and tga textures can't hold bc4 or eac", value.line);
+        *error = text;
+        return false;
+    }
+    if (!foundOutput)
+        job->prefix = job->fontname.substr(0, job->fontname.find_last_of("."));
+    return true;
+}
+
+int MANIFEST_Load(const char* filename, std::vector<FontJob>* jobs, int* numThreads, std::string* error)
+{
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL)
+    {
+        *error = "file not found";
+        return MANIFEST_ERROR_FILE_OPEN;
+    }
+
+    std::vector<char> text;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        text.insert(text.end(), chunk, chunk + n);
+    fclose(fp);
+    text.push_back(0);
+
+    JsonParser parser;
+    parser.p = &text[0];
+    parser.end = &text[0] + text.size() - 1;
+    parser.line = 1;
+    parser.error = error;
+
+    JsonValue root;
+    if (!ParseValue(&parser, &root, 0))
+        return MANIFEST_ERROR_SYNTAX;
+    SkipSpace(&parser);
+    if (parser.p != parser.end)
+    {
+        Fail(&parser, "unexpected text after the manifest");
+        return MANIFEST_ERROR_SYNTAX;
+    }
+
+    if (root.type != JsonValue::Object)
+    {
+        ValueError(root, "manifest", "an object", error);
+        return MANIFEST_ERROR_VALUE;
+    }
+
+    const JsonValue* jobList = NULL;
+    for (size_t i = 0; i < root.members.size(); ++i)
+    {
+        const std::string& key = root.members[i].first;
+        const JsonValue& member = root.members[i].second;
+        if (key == "threads")
+        {
+            if (!GetInt(member, key, 1, 1024, numThreads, error))
+                return MANIFEST_ERROR_VALUE;
+        }
+        else if (key == "jobs")
+        {
+            if (member.type != JsonValue::Array)
+            {
+                ValueError(member, key, "a list of objects", error);
+                return MANIFEST_ERROR_VALUE;
+            }
+            jobList = &member;
+        }
+        else
+        {
+            char message[256];
+            snprintf(message, sizeof(message), "line %d: unknown setting \"%s\"", member.line, key.c_str());
+            *error = message;
+            return MANIFEST_ERROR_VALUE;
+        }
+    }
+
+    if (jobList == NULL || jobList->elements.empty())
+    {
+        *error = "no \"jobs\" in the manifest";
+        return MANIFEST_ERROR_VALUE;
+    }
+
+    for (size_t i = 0; i < jobList->elements.size(); ++i)
+    {
+        FontJob job;
+        if (!ParseJob(jobList->elements[i], &job, error))
+            return MANIFEST_ERROR_VALUE;
+        jobs->push_back(job);
+    }
+    return MANIFEST_OK;
+}
@@ -0,0 +1,84 @@
+// Settings of a single atlas build, and -manifest files listing many of them.
+
+#ifndef MANIFESTH
+#define MANIFESTH
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "pack.h"
+#include "png.h"
+#include "mip.h"
+#include "blockenc.h"
+#include "container.h"
+
+enum
+{
+    MANIFEST_ERROR_FILE_OPEN,
+    MANIFEST_ERROR_SYNTAX,
+    MANIFEST_ERROR_VALUE,
+    MANIFEST_OK
+};
+
+// FontJob.textures, any combination
+enum
+{
+    MANIFEST_TEXTURE_RAW = 0x1,
+    MANIFEST_TEXTURE_TGA = 0x2,
+    MANIFEST_TEXTURE_PNG = 0x4,
+    MANIFEST_TEXTURE_BC4 = 0x8,
+    MANIFEST_TEXTURE_EAC = 0x10,
+    MANIFEST_TEXTURE_KTX2 = 0x20,
+    MANIFEST_TEXTURE_DDS = 0x40
+};
+
+// FontJob.metrics, any combination
+enum
+{
+    MANIFEST_METRICS_YAML = 0x1,
+    MANIFEST_METRICS_LUA = 0x2,
+    MANIFEST_METRICS_JSON = 0x4,
+    MANIFEST_METRICS_BIN = 0x8,
+    MANIFEST_METRICS_BIN16 = 0x10
+};
+
+// everything needed to turn one font into one atlas, plus the files to write.
+struct FontJob
+{
+    FontJob();
+
+    std::string fontname;
+    std::string prefix;                 // output filenames without extension
+    int textureWidth;
+    int padding;
+    int pixels;                         // 0 picks the largest size that fits a grid
+    std::vector<int> sizes;             // several pixel sizes in one atlas, overrides pixels
+    std::vector<uint32_t> codepoints;   // empty uses the default range
+    bool sdf;
+    int sdfSpread;
+    PackHeuristic packHeuristic;
+    bool rotate;
+    bool vflip;
+    MipFilter mipFilter;
+    BlockQuality blockQuality;          // for the bc4 and eac textures
+    ContainerFormat textureFormat;      // texels of the raw, tga, ktx2 and dds textures
+    bool premultiplied;
+    bool zlib;                          // supercompress ktx2 levels
+    bool rle;                           // run length encode tga textures
+    PngColorType pngColorType;
+    unsigned int textures;
+    unsigned int metrics;
+};
+
+// reads a json manifest of the form
+//
+// { "threads": 8,
+//   "jobs": [ { "font": "FreeSans.otf", "output": "out/FreeSans16", "size": 16,
+//               "textures": ["raw", "png"], "metrics": ["yaml", "bin"] }, ... ] }
+//
+// and appends one FontJob per entry of "jobs", see README for every key.
+// numThreads is left alone when the manifest doesn't set it.
+// On failure error describes the problem and where it is.
+int MANIFEST_Load(const char* filename, std::vector<FontJob>* jobs, int* numThreads, std::string* error);
+
+#endif
@@ -0,0 +1,99 @@
+#include "mapfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MAP_Open(const char* filename, MappedFile* file)
+{
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+
+    HANDLE fh = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fh, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(fh);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(fh);
+    if (mapping == NULL)
+        return false;
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    file->data = (const unsigned char*)data;
+    file->size = (size_t)size.QuadPart;
+    file->handle = mapping;
+    return true;
+}
+
+void MAP_Close(MappedFile* file)
+{
+    if (file->data)
+        UnmapViewOfFile(file->data);
+    if (file->handle)
+        CloseHandle((HANDLE)file->handle);
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+}
+
+#else
+
+bool MAP_Open(const char* filename, MappedFile* file)
+{
+    file->data = NULL;
+    file->size = 0;
+    file->handle = NULL;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // the mapping stays valid after the descriptor is closed.
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    file->data = (const unsigned char*)data;
+    file->size = (size_t)st.st_size;
+    return true;
+}
+
+void MAP_Close(MappedFile* file)
+{
+    if (file->data)
+        munmap((void*)file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+}
+
+#endif
@@ -0,0 +1,21 @@
+// Read-only memory mapped files.
+
+#ifndef MAPFILEH
+#define MAPFILEH
+
+#include <stddef.h>
+
+struct MappedFile
+{
+    const unsigned char* data;
+    size_t size;
+    void* handle;   // platform specific mapping handle
+};
+
+// maps the whole file read-only, pages are shared with any other process mapping it.
+// returns false if the file could not be opened or mapped.
+bool MAP_Open(const char* filename, MappedFile* file);
+
+void MAP_Close(MappedFile* file);
+
+#endif
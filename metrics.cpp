@@ -0,0 +1,443 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "metrics.h"
+#include "fontbin.h"
+#include "fontbin16.h"
+#include "trace.h"
+
+// glyph_metrics and kerning of one size, every line starts with indent
+static void WriteYAMLGlyphs(FILE* fp, const char* indent, const std::vector<GlyphInfo>& glyphs, float line_height,
+                            const std::vector<KerningPair>& kerning)
+{
+    const int numGlyphs = (int)glyphs.size();
+    fprintf(fp, "%sglyph_metrics:\n", indent);
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        fprintf(fp, "%s-\n", indent);
+        fprintf(fp, "%s  codepoint: %u\n", indent, glyphs[i].codepoint);
+        fprintf(fp, "%s  char_index: %u\n", indent, glyphs[i].ftGlyphIndex);
+        fprintf(fp, "%s  xy_lower_left: [%f, %f]\n", indent, glyphs[i].xy_lower_left.x, glyphs[i].xy_lower_left.y);
+        fprintf(fp, "%s  xy_upper_right: [%f, %f]\n", indent, glyphs[i].xy_upper_right.x, glyphs[i].xy_upper_right.y);
+        fprintf(fp, "%s  uv_lower_left: [%f, %f]\n", indent, glyphs[i].uv_lower_left.x, glyphs[i].uv_lower_left.y);
+        fprintf(fp, "%s  uv_upper_right: [%f, %f]\n", indent, glyphs[i].uv_upper_right.x, glyphs[i].uv_upper_right.y);
+        fprintf(fp, "%s  advance: [%f, %f]\n", indent, glyphs[i].advance.x, glyphs[i].advance.y);
+        if (glyphs[i].rotated)
+            fprintf(fp, "%s  rotated: true\n", indent);
+    }
+
+    // dump kerning table
+    fprintf(fp, "%skerning:\n", indent);
+    for (size_t k = 0; k < kerning.size(); ++k)
+    {
+        const GlyphInfo& first = glyphs[kerning[k].first];
+        const GlyphInfo& second = glyphs[kerning[k].second];
+        fprintf(fp, "%s-\n", indent);
+        fprintf(fp, "%s  first_index: %u\n", indent, first.ftGlyphIndex);
+        fprintf(fp, "%s  second_index: %u\n", indent, second.ftGlyphIndex);
+        fprintf(fp, "%s  kerning: [%f, %f]\n", indent, FIXED_TO_FLOAT(kerning[k].kerning.x) / line_height,
+                FIXED_TO_FLOAT(kerning[k].kerning.y) / line_height);
+    }
+}
+
+static FILE* OpenYAML(const std::string& fontprefix, const std::string& fontname, int textureWidth, int sdfSpread)
+{
+    // dump out metrics for each glyph into a yaml file
+    char yamlFilename[512];
+    sprintf(yamlFilename, "%s.yaml", fontprefix.c_str());
+    FILE* fp = fopen(yamlFilename, "w");
+    if (fp == NULL)
+        return NULL;
+    fprintf(fp, "# Font Metrics for %s\n", fontname.c_str());
+    fprintf(fp, "texture_width: %d\n", textureWidth);
+    if (sdfSpread > 0)
+        fprintf(fp, "sdf_spread: %d\n", sdfSpread);
+    return fp;
+}
+
+bool ExportYAMLMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                              const std::string& fontname, int textureWidth, int sdfSpread, float line_height,
+                              const std::vector<KerningPair>& kerning)
+{
+    TRACE_SCOPE("export yaml");
+    FILE* fp = OpenYAML(fontprefix, fontname, textureWidth, sdfSpread);
+    if (fp == NULL)
+        return false;
+    WriteYAMLGlyphs(fp, "", glyphs, line_height, kerning);
+    return fclose(fp) == 0;
+}
+
+bool ExportYAMLSizes(const std::vector<MetricsSize>& sizes, const std::string& fontprefix,
+                     const std::string& fontname, int textureWidth, int sdfSpread)
+{
+    TRACE_SCOPE("export yaml");
+    FILE* fp = OpenYAML(fontprefix, fontname, textureWidth, sdfSpread);
+    if (fp == NULL)
+        return false;
+    fprintf(fp, "sizes:\n");
+    for (size_t s = 0; s < sizes.size(); ++s)
+    {
+        fprintf(fp, "  %d:\n", sizes[s].pixels);
+        fprintf(fp, "    line_height: %f\n", sizes[s].line_height);
+        WriteYAMLGlyphs(fp, "    ", sizes[s].glyphs, sizes[s].line_height, sizes[s].kerning);
+    }
+    return fclose(fp) == 0;
+}
+
+static void WriteLuaGlyphs(FILE* fp, const char* indent, const std::vector<GlyphInfo>& glyphs, float line_height,
+                           const std::vector<KerningPair>& kerning)
+{
+    const int numGlyphs = (int)glyphs.size();
+    fprintf(fp, "%s    glyph_metrics = {\n", indent);
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        fprintf(fp, "%s        [%u] = { codepoint = %u,\n", indent, glyphs[i].codepoint, glyphs[i].codepoint);
+        fprintf(fp, "%s            xy_lower_left = {%f, %f},\n", indent, glyphs[i].xy_lower_left.x, glyphs[i].xy_lower_left.y);
+        fprintf(fp, "%s            xy_upper_right = {%f, %f},\n", indent, glyphs[i].xy_upper_right.x, glyphs[i].xy_upper_right.y);
+        fprintf(fp, "%s            uv_lower_left = {%f, %f},\n", indent, glyphs[i].uv_lower_left.x, glyphs[i].uv_lower_left.y);
+        fprintf(fp, "%s            uv_upper_right = {%f, %f},\n", indent, glyphs[i].uv_upper_right.x, glyphs[i].uv_upper_right.y);
+        if (glyphs[i].rotated)
+            fprintf(fp, "%s            rotated = true,\n", indent);
+        fprintf(fp, "%s            advance = {%f, %f} },\n", indent, glyphs[i].advance.x, glyphs[i].advance.y);
+    }
+    fprintf(fp, "%s    },\n", indent);
+
+    // dump kerning table
+    fprintf(fp, "%s    kerning = {\n", indent);
+    for (size_t k = 0; k < kerning.size(); ++k)
+    {
+        fprintf(fp, "%s        { first_char = %u,\n", indent, glyphs[kerning[k].first].codepoint);
+        fprintf(fp, "%s          second_char = %u,\n", indent, glyphs[kerning[k].second].codepoint);
+        fprintf(fp, "%s          kerning = {%f, %f} },\n", indent, FIXED_TO_FLOAT(kerning[k].kerning.x) / line_height,
+                FIXED_TO_FLOAT(kerning[k].kerning.y) / line_height);
+    }
+    fprintf(fp, "%s    }\n", indent);
+}
+
+static FILE* OpenLua(const std::string& fontprefix, const std::string& fontname, int textureWidth, int sdfSpread)
+{
+    char luaFilename[512];
+    sprintf(luaFilename, "%s.lua", fontprefix.c_str());
+    FILE* fp = fopen(luaFilename, "w");
+    if (fp == NULL)
+        return NULL;
+    fprintf(fp, "-- Font Metrics for %s\n", fontname.c_str());
+    fprintf(fp, "Font {\n");
+    fprintf(fp, "    texture_width = %d,\n", textureWidth);
+    if (sdfSpread > 0)
+        fprintf(fp, "    sdf_spread = %d,\n", sdfSpread);
+    return fp;
+}
+
+bool ExportLuaMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                             const std::string& fontname, int textureWidth, int sdfSpread, float line_height,
+                             const std::vector<KerningPair>& kerning)
+{
+    TRACE_SCOPE("export lua");
+    FILE* fp = OpenLua(fontprefix, fontname, textureWidth, sdfSpread);
+    if (fp == NULL)
+        return false;
+    WriteLuaGlyphs(fp, "", glyphs, line_height, kerning);
+    fprintf(fp, "}\n");
+    return fclose(fp) == 0;
+}
+
+bool ExportLuaSizes(const std::vector<MetricsSize>& sizes, const std::string& fontprefix,
+                    const std::string& fontname, int textureWidth, int sdfSpread)
+{
+    TRACE_SCOPE("export lua");
+    FILE* fp = OpenLua(fontprefix, fontname, textureWidth, sdfSpread);
+    if (fp == NULL)
+        return false;
+    fprintf(fp, "    sizes = {\n");
+    for (size_t s = 0; s < sizes.size(); ++s)
+    {
+        fprintf(fp, "        [%d] = {\n", sizes[s].pixels);
+        fprintf(fp, "            line_height = %f,\n", sizes[s].line_height);
+        WriteLuaGlyphs(fp, "        ", sizes[s].glyphs, sizes[s].line_height, sizes[s].kerning);
+        fprintf(fp, "        },\n");
+    }
+    fprintf(fp, "    }\n");
+    fprintf(fp, "}\n");
+    return fclose(fp) == 0;
+}
+
+static void WriteJSONGlyphs(FILE* fp, const char* indent, const std::vector<GlyphInfo>& glyphs, float line_height,
+                            const std::vector<KerningPair>& kerning)
+{
+    const int numGlyphs = (int)glyphs.size();
+    fprintf(fp, "%s    \"glyph_metrics\": {\n", indent);
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        fprintf(fp, "%s        \"%u\": {\n", indent, glyphs[i].codepoint);
+        fprintf(fp, "%s            \"codepoint\": %u,\n", indent, glyphs[i].codepoint);
+        fprintf(fp, "%s            \"xy_lower_left\": [%f, %f],\n", indent, glyphs[i].xy_lower_left.x, glyphs[i].xy_lower_left.y);
+        fprintf(fp, "%s            \"xy_upper_right\": [%f, %f],\n", indent, glyphs[i].xy_upper_right.x, glyphs[i].xy_upper_right.y);
+        fprintf(fp, "%s            \"uv_lower_left\": [%f, %f],\n", indent, glyphs[i].uv_lower_left.x, glyphs[i].uv_lower_left.y);
+        fprintf(fp, "%s            \"uv_upper_right\": [%f, %f],\n", indent, glyphs[i].uv_upper_right.x, glyphs[i].uv_upper_right.y);
+        if (glyphs[i].rotated)
+            fprintf(fp, "%s            \"rotated\": true,\n", indent);
+        fprintf(fp, "%s            \"advance\": [%f, %f]\n", indent, glyphs[i].advance.x, glyphs[i].advance.y);
+        fprintf(fp, "%s        }%s\n", indent, (i == numGlyphs - 1) ? "" : ",");
+    }
+    fprintf(fp, "%s    },\n", indent);
+
+    // dump kerning table
+    fprintf(fp, "%s    \"kerning\": [\n", indent);
+    for (size_t k = 0; k < kerning.size(); ++k)
+    {
+        fprintf(fp, "%s        {\n", indent);
+        fprintf(fp, "%s            \"first_char\": %u,\n", indent, glyphs[kerning[k].first].codepoint);
+        fprintf(fp, "%s            \"second_char\": %u,\n", indent, glyphs[kerning[k].second].codepoint);
+        fprintf(fp, "%s            \"kerning\": [%f, %f]\n", indent, FIXED_TO_FLOAT(kerning[k].kerning.x) / line_height,
+                FIXED_TO_FLOAT(kerning[k].kerning.y) / line_height);
+        fprintf(fp, "%s        }%s\n", indent, (k == kerning.size() - 1) ? "" : ",");
+    }
+    fprintf(fp, "%s    ]\n", indent);
+}
+
+static FILE* OpenJSON(const std::string& fontprefix, int textureWidth, int sdfSpread)
+{
+    char jsonFilename[512];
+    sprintf(jsonFilename, "%s.json", fontprefix.c_str());
+    FILE* fp = fopen(jsonFilename, "w");
+    if (fp == NULL)
+        return NULL;
+    fprintf(fp, "{\n");
+    fprintf(fp, "    \"texture_width\": %d,\n", textureWidth);
+    if (sdfSpread > 0)
+        fprintf(fp, "    \"sdf_spread\": %d,\n", sdfSpread);
+    return fp;
+}
+
+bool ExportJSONMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                       int textureWidth, int sdfSpread, float line_height,
+                       const std::vector<KerningPair>& kerning)
+{
+    TRACE_SCOPE("export json");
+    FILE* fp = OpenJSON(fontprefix, textureWidth, sdfSpread);
+    if (fp == NULL)
+        return false;
+    WriteJSONGlyphs(fp, "", glyphs, line_height, kerning);
+    fprintf(fp, "}\n");
+    return fclose(fp) == 0;
+}
+
+bool ExportJSONSizes(const std::vector<MetricsSize>& sizes, const std::string& fontprefix,
+                     int textureWidth, int sdfSpread)
+{
+    TRACE_SCOPE("export json");
+    FILE* fp = OpenJSON(fontprefix, textureWidth, sdfSpread);
+    if (fp == NULL)
+        return false;
+    fprintf(fp, "    \"sizes\": {\n");
+    for (size_t s = 0; s < sizes.size(); ++s)
+    {
+        fprintf(fp, "        \"%d\": {\n", sizes[s].pixels);
+        fprintf(fp, "            \"line_height\": %f,\n", sizes[s].line_height);
+        WriteJSONGlyphs(fp, "        ", sizes[s].glyphs, sizes[s].line_height, sizes[s].kerning);
+        fprintf(fp, "        }%s\n", (s == sizes.size() - 1) ? "" : ",");
+    }
+    fprintf(fp, "    }\n");
+    fprintf(fp, "}\n");
+    return fclose(fp) == 0;
+}
+
+// little endian writers for the binary metrics file
+static void PutU32(std::vector<unsigned char>* out, size_t offset, uint32_t value)
+{
+    (*out)[offset + 0] = (unsigned char)(value);
+    (*out)[offset + 1] = (unsigned char)(value >> 8);
+    (*out)[offset + 2] = (unsigned char)(value >> 16);
+    (*out)[offset + 3] = (unsigned char)(value >> 24);
+}
+
+static void PutFloat(std::vector<unsigned char>* out, size_t offset, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutU32(out, offset, bits);
+}
+
+static void PutVec2(std::vector<unsigned char>* out, size_t offset, const Vec2& value)
+{
+    PutFloat(out, offset, value.x);
+    PutFloat(out, offset + 4, value.y);
+}
+
+static void PutU16(std::vector<unsigned char>* out, size_t offset, uint32_t value)
+{
+    (*out)[offset + 0] = (unsigned char)(value);
+    (*out)[offset + 1] = (unsigned char)(value >> 8);
+}
+
+static bool WriteBinaryFile(const std::string& filename, const std::vector<unsigned char>& out)
+{
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(&out[0], 1, out.size(), fp) == out.size();
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok;
+}
+
+bool ExportBinaryMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                                const std::string& textureFilename, int textureWidth, int sdfSpread,
+                                float line_height, bool vflip, const std::vector<KerningPair>& kerning)
+{
+    TRACE_SCOPE("export bin");
+    const int numGlyphs = (int)glyphs.size();
+
+    const uint32_t glyphOffset = sizeof(FontBinHeader);
+    const uint32_t kerningOffset = glyphOffset + numGlyphs * sizeof(FontBinGlyph);
+    const uint32_t filenameOffset = kerningOffset + (uint32_t)kerning.size() * sizeof(FontBinKerning);
+    const uint32_t fileSize = (filenameOffset + (uint32_t)textureFilename.size() + 1 + 3) & ~3u;
+    std::vector<unsigned char> out(fileSize, 0);
+
+    PutU32(&out, offsetof(FontBinHeader, magic), FONTBIN_MAGIC);
+    PutU32(&out, offsetof(FontBinHeader, version), FONTBIN_VERSION);
+    PutU32(&out, offsetof(FontBinHeader, file_size), fileSize);
+    PutU32(&out, offsetof(FontBinHeader, flags), vflip ? FONTBIN_FLAG_VFLIP : 0);
+    PutU32(&out, offsetof(FontBinHeader, texture_width), (uint32_t)textureWidth);
+    PutU32(&out, offsetof(FontBinHeader, num_glyphs), numGlyphs);
+    PutU32(&out, offsetof(FontBinHeader, glyph_offset), glyphOffset);
+    PutU32(&out, offsetof(FontBinHeader, num_kerning), (uint32_t)kerning.size());
+    PutU32(&out, offsetof(FontBinHeader, kerning_offset), kerningOffset);
+    PutU32(&out, offsetof(FontBinHeader, texture_filename_offset), filenameOffset);
+    PutU32(&out, offsetof(FontBinHeader, sdf_spread), (uint32_t)sdfSpread);
+
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        const GlyphInfo& glyph = glyphs[i];
+        size_t base = glyphOffset + i * sizeof(FontBinGlyph);
+        PutU32(&out, base + offsetof(FontBinGlyph, codepoint), glyph.codepoint);
+        PutU32(&out, base + offsetof(FontBinGlyph, char_index), glyph.ftGlyphIndex);
+        PutVec2(&out, base + offsetof(FontBinGlyph, xy_lower_left), glyph.xy_lower_left);
+        PutVec2(&out, base + offsetof(FontBinGlyph, xy_upper_right), glyph.xy_upper_right);
+        PutVec2(&out, base + offsetof(FontBinGlyph, uv_lower_left), glyph.uv_lower_left);
+        PutVec2(&out, base + offsetof(FontBinGlyph, uv_upper_right), glyph.uv_upper_right);
+        PutVec2(&out, base + offsetof(FontBinGlyph, advance), glyph.advance);
+        PutU32(&out, base + offsetof(FontBinGlyph, flags), glyph.rotated ? FONTBIN_GLYPH_ROTATED : 0);
+    }
+
+    for (size_t k = 0; k < kerning.size(); ++k)
+    {
+        size_t base = kerningOffset + k * sizeof(FontBinKerning);
+        PutU32(&out, base + offsetof(FontBinKerning, first), kerning[k].first);
+        PutU32(&out, base + offsetof(FontBinKerning, second), kerning[k].second);
+        PutFloat(&out, base + offsetof(FontBinKerning, kerning), FIXED_TO_FLOAT(kerning[k].kerning.x) / line_height);
+        PutFloat(&out, base + offsetof(FontBinKerning, kerning) + 4, FIXED_TO_FLOAT(kerning[k].kerning.y) / line_height);
+    }
+
+    memcpy(&out[filenameOffset], textureFilename.c_str(), textureFilename.size());
+
+    return WriteBinaryFile(fontprefix + std::string(".bin"), out);
+}
+
+// rounds a value in units of line height to 16 bit 26.6 pixels, false if it doesn't fit
+static bool Fixed16(float value, float line_height, int* result)
+{
+    const float fixed = floorf(value * line_height * 64.0f + 0.5f);
+    if (!(fixed >= -32768.0f && fixed <= 32767.0f))
+        return false;
+    *result = (int)fixed;
+    return true;
+}
+
+static uint32_t Unorm16(float value)
+{
+    const float unorm = floorf(value * 65535.0f + 0.5f);
+    return unorm < 0.0f ? 0 : (unorm > 65535.0f ? 65535 : (uint32_t)unorm);
+}
+
+bool ExportCompactMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                          const std::string& textureFilename, int textureWidth, int sdfSpread,
+                          float line_height, bool vflip, const std::vector<KerningPair>& kerning)
+{
+    TRACE_SCOPE("export bin16");
+    const int numGlyphs = (int)glyphs.size();
+    if (textureWidth > 32768 || numGlyphs > 65536)
+    {
+        fprintf(stderr, "Error : -bin16 holds at most 65536 glyphs and a 32768 texel wide texture\n");
+        return false;
+    }
+
+    const uint32_t glyphOffset = sizeof(FontBin16Header);
+    const uint32_t kerningOffset = glyphOffset + numGlyphs * sizeof(FontBin16Glyph);
+    const uint32_t filenameOffset = kerningOffset + (uint32_t)kerning.size() * sizeof(FontBin16Kerning);
+    const uint32_t fileSize = (filenameOffset + (uint32_t)textureFilename.size() + 1 + 3) & ~3u;
+    std::vector<unsigned char> out(fileSize, 0);
+
+    PutU32(&out, offsetof(FontBin16Header, magic), FONTBIN16_MAGIC);
+    PutU32(&out, offsetof(FontBin16Header, version), FONTBIN16_VERSION);
+    PutU32(&out, offsetof(FontBin16Header, file_size), fileSize);
+    PutU32(&out, offsetof(FontBin16Header, flags), vflip ? FONTBIN_FLAG_VFLIP : 0);
+    PutU32(&out, offsetof(FontBin16Header, texture_width), (uint32_t)textureWidth);
+    PutU32(&out, offsetof(FontBin16Header, num_glyphs), numGlyphs);
+    PutU32(&out, offsetof(FontBin16Header, glyph_offset), glyphOffset);
+    PutU32(&out, offsetof(FontBin16Header, num_kerning), (uint32_t)kerning.size());
+    PutU32(&out, offsetof(FontBin16Header, kerning_offset), kerningOffset);
+    PutU32(&out, offsetof(FontBin16Header, texture_filename_offset), filenameOffset);
+    PutU32(&out, offsetof(FontBin16Header, sdf_spread), (uint32_t)sdfSpread);
+    PutFloat(&out, offsetof(FontBin16Header, line_height), line_height);
+
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        const GlyphInfo& glyph = glyphs[i];
+        if (glyph.ftGlyphIndex > 0xffff)
+        {
+            fprintf(stderr, "Error : glyph %u has a font glyph index above 65535, too large for -bin16, use -bin\n",
+                    glyph.codepoint);
+            return false;
+        }
+        const float xy[6] = { glyph.xy_lower_left.x, glyph.xy_lower_left.y, glyph.xy_upper_right.x,
+                              glyph.xy_upper_right.y, glyph.advance.x, glyph.advance.y };
+        int fixed[6];
+        for (int k = 0; k < 6; ++k)
+        {
+            if (!Fixed16(xy[k], line_height, &fixed[k]))
+            {
+                fprintf(stderr, "Error : glyph %u is too large for the 16 bit metrics of -bin16, use -bin\n",
+                        glyph.codepoint);
+                return false;
+            }
+        }
+
+        size_t base = glyphOffset + i * sizeof(FontBin16Glyph);
+        PutU32(&out, base + offsetof(FontBin16Glyph, codepoint), glyph.codepoint);
+        PutU16(&out, base + offsetof(FontBin16Glyph, char_index), glyph.ftGlyphIndex);
+        PutU16(&out, base + offsetof(FontBin16Glyph, flags), glyph.rotated ? FONTBIN_GLYPH_ROTATED : 0);
+        for (int k = 0; k < 2; ++k)
+        {
+            PutU16(&out, base + offsetof(FontBin16Glyph, xy_lower_left) + 2 * k, (uint32_t)fixed[k]);
+            PutU16(&out, base + offsetof(FontBin16Glyph, xy_upper_right) + 2 * k, (uint32_t)fixed[2 + k]);
+            PutU16(&out, base + offsetof(FontBin16Glyph, advance) + 2 * k, (uint32_t)fixed[4 + k]);
+        }
+        PutU16(&out, base + offsetof(FontBin16Glyph, uv_lower_left), Unorm16(glyph.uv_lower_left.x));
+        PutU16(&out, base + offsetof(FontBin16Glyph, uv_lower_left) + 2, Unorm16(glyph.uv_lower_left.y));
+        PutU16(&out, base + offsetof(FontBin16Glyph, uv_upper_right), Unorm16(glyph.uv_upper_right.x));
+        PutU16(&out, base + offsetof(FontBin16Glyph, uv_upper_right) + 2, Unorm16(glyph.uv_upper_right.y));
+    }
+
+    for (size_t k = 0; k < kerning.size(); ++k)
+    {
+        // kerning is already 26.6 pixels
+        const FT_Vector& value = kerning[k].kerning;
+        if (value.y != 0 || value.x < -32768 || value.x > 32767)
+        {
+            fprintf(stderr, "Error : -bin16 only holds horizontal kerning of less than 512 pixels, use -bin\n");
+            return false;
+        }
+        size_t base = kerningOffset + k * sizeof(FontBin16Kerning);
+        PutU16(&out, base + offsetof(FontBin16Kerning, first), (uint32_t)kerning[k].first);
+        PutU16(&out, base + offsetof(FontBin16Kerning, second), (uint32_t)kerning[k].second);
+        PutU16(&out, base + offsetof(FontBin16Kerning, kerning), (uint32_t)value.x);
+    }
+
+    memcpy(&out[filenameOffset], textureFilename.c_str(), textureFilename.size());
+
+    return WriteBinaryFile(fontprefix + std::string(".bin16"), out);
+}
@@ -0,0 +1,116 @@
+// Glyph metrics of a packed atlas and the yaml, lua, json and binary exporters.
+
+#ifndef METRICSH
+#define METRICSH
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "kerning.h"
+
+// 26.6 Fixed to Float
+#define FIXED_TO_FLOAT(x) ((float)(x) / 64.0f)
+
+struct Vec2
+{
+    Vec2() {}
+    Vec2(float xIn, float yIn) : x(xIn), y(yIn) {}
+    float x;
+    float y;
+};
+
+inline Vec2 operator+(const Vec2& a, const Vec2& b)
+{
+    return Vec2(a.x + b.x, a.y + b.y);
+}
+
+inline Vec2 operator+(const Vec2& a, float scalar)
+{
+    return Vec2(a.x + scalar, a.y + scalar);
+}
+
+inline Vec2 operator-(const Vec2& a, const Vec2& b)
+{
+    return Vec2(a.x - b.x, a.y - b.y);
+}
+
+inline Vec2 operator-(const Vec2& a, float scalar)
+{
+    return Vec2(a.x - scalar, a.y - scalar);
+}
+
+inline Vec2 operator*(const Vec2& a, const Vec2& b)
+{
+    return Vec2(a.x * b.x, a.y * b.y);
+}
+
+inline Vec2 operator*(const Vec2& a, float scalar)
+{
+    return Vec2(a.x * scalar, a.y * scalar);
+}
+
+inline Vec2 operator/(const Vec2& a, const Vec2& b)
+{
+    return Vec2(a.x / b.x, a.y / b.y);
+}
+
+inline Vec2 operator/(const Vec2& a, float scalar)
+{
+    return Vec2(a.x / scalar, a.y / scalar);
+}
+
+// one glyph of a packed atlas.  xy are in units of line height, uv in texture space.
+struct GlyphInfo
+{
+    FT_UInt ftGlyphIndex;
+    uint32_t codepoint;
+    Vec2 xy_lower_left;
+    Vec2 xy_upper_right;
+    Vec2 uv_lower_left;
+    Vec2 uv_upper_right;
+    Vec2 advance;
+    bool rotated;
+};
+
+// writes glyphs and kerning as fontprefix.yaml, fontprefix.lua or fontprefix.json.
+// Kerning is stored in units of line height like every other metric.
+bool ExportYAMLMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                       const std::string& fontname, int textureWidth, int sdfSpread, float line_height,
+                       const std::vector<KerningPair>& kerning);
+bool ExportLuaMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                      const std::string& fontname, int textureWidth, int sdfSpread, float line_height,
+                      const std::vector<KerningPair>& kerning);
+bool ExportJSONMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                       int textureWidth, int sdfSpread, float line_height,
+                       const std::vector<KerningPair>& kerning);
+
+// the glyphs of one pixel size of a -sizes atlas.  Kerning indexes into glyphs, and
+// xy, advance and kerning are in units of this size's line_height, in pixels.
+struct MetricsSize
+{
+    int pixels;
+    float line_height;
+    std::vector<GlyphInfo> glyphs;
+    std::vector<KerningPair> kerning;
+};
+
+// the same files holding every size of a -sizes atlas, keyed by pixel size.
+bool ExportYAMLSizes(const std::vector<MetricsSize>& sizes, const std::string& fontprefix,
+                     const std::string& fontname, int textureWidth, int sdfSpread);
+bool ExportLuaSizes(const std::vector<MetricsSize>& sizes, const std::string& fontprefix,
+                    const std::string& fontname, int textureWidth, int sdfSpread);
+bool ExportJSONSizes(const std::vector<MetricsSize>& sizes, const std::string& fontprefix,
+                     int textureWidth, int sdfSpread);
+
+// writes fontprefix.bin, see fontbin.h.  textureFilename is stored as given.
+bool ExportBinaryMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                         const std::string& textureFilename, int textureWidth, int sdfSpread,
+                         float line_height, bool vflip, const std::vector<KerningPair>& kerning);
+
+// writes fontprefix.bin16, the quantized metrics of fontbin16.h.  Fails with a
+// message if a value doesn't fit its 16 bits.
+bool ExportCompactMetrics(const std::vector<GlyphInfo>& glyphs, const std::string& fontprefix,
+                          const std::string& textureFilename, int textureWidth, int sdfSpread,
+                          float line_height, bool vflip, const std::vector<KerningPair>& kerning);
+
+#endif
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+#include "mip.h"
+
+uint64_t MIP_RawSize(int width, PixelFormat format)
+{
+    return MIP_LevelOffset(width, 32, format);
+}
+
+uint64_t MIP_LevelOffset(int width, int level, PixelFormat format)
+{
+    uint64_t offset = 0;
+    for (int w = width, i = 0; w >= 1 && i < level; w /= 2, ++i)
+        offset += (uint64_t)w * w * PIXEL_BytesPerTexel(format);
+    return offset;
+}
+
+// Both filters are separable, so each destination row is built by first summing the
+// contributing source rows into a 16 bit accumulator row, then filtering that row
+// horizontally.  The loops are kept branch free and unit stride so the compiler can
+// vectorize them.
+static void SumRowsBox(const unsigned char* r0, const unsigned char* r1, int width, uint16_t* accum)
+{
+    for (int x = 0; x < width; ++x)
+        accum[x] = (uint16_t)(r0[x] + r1[x]);
+}
+
+static void SumRowsTent(const unsigned char* r0, const unsigned char* r1, const unsigned char* r2,
+                        const unsigned char* r3, int width, uint16_t* accum)
+{
+    for (int x = 0; x < width; ++x)
+        accum[x] = (uint16_t)(r0[x] + 3 * (r1[x] + r2[x]) + r3[x]);
+}
+
+static bool UseTent(MipFilter filter, int width)
+{
+    return filter == MIP_FILTER_TENT && width >= 4;
+}
+
+// builds one destination row from source rows 2y - 1 to 2y + 2, r0 and r3 are only
+// read by the tent filter and are clamped to the image edge by the caller.
+static void DownsampleRow(const unsigned char* r0, const unsigned char* r1, const unsigned char* r2,
+                          const unsigned char* r3, int width, MipFilter filter, uint16_t* accum,
+                          unsigned char* out)
+{
+    const int half = width / 2;
+    if (UseTent(filter, width))
+    {
+        SumRowsTent(r0, r1, r2, r3, width, accum);
+
+        out[0] = (unsigned char)((accum[0] + 3 * (accum[0] + accum[1]) + accum[2] + 32) >> 6);
+        for (int x = 1; x < half - 1; ++x)
+        {
+            const uint16_t* a = accum + 2 * x - 1;
+            out[x] = (unsigned char)((a[0] + 3 * (a[1] + a[2]) + a[3] + 32) >> 6);
+        }
+        const uint16_t* a = accum + width - 3;
+        out[half - 1] = (unsigned char)((a[0] + 3 * (a[1] + a[2]) + a[2] + 32) >> 6);
+    }
+    else
+    {
+        SumRowsBox(r1, r2, width, accum);
+        for (int x = 0; x < half; ++x)
+            out[x] = (unsigned char)((accum[2 * x] + accum[2 * x + 1] + 2) >> 2);
+    }
+}
+
+void MIP_Downsample(const unsigned char* src, int width, unsigned char* dest, MipFilter filter)
+{
+    const int half = width / 2;
+    uint16_t* accum = new uint16_t[width];
+
+    for (int y = 0; y < half; ++y)
+    {
+        const unsigned char* r1 = src + (size_t)(2 * y) * width;
+        const unsigned char* r2 = r1 + width;
+        const unsigned char* r0 = (y == 0) ? r1 : r1 - width;
+        const unsigned char* r3 = (y == half - 1) ? r2 : r2 + width;
+        DownsampleRow(r0, r1, r2, r3, width, filter, accum, dest + (size_t)y * half);
+    }
+
+    delete [] accum;
+}
+
+struct MipStreamLevel
+{
+    int width;
+    std::vector<unsigned char> band;        // finished rows not handed to emit yet
+    int bandFirst;
+    int bandCount;
+    std::vector<unsigned char> window;      // rows still needed to build the next level
+    int windowFirst;
+    int windowCount;
+    int nextRow;                            // next row of the next level to build
+};
+
+struct MipStream
+{
+    int bandRows;
+    MipFilter filter;
+    MipBandFn emit;
+    std::vector<MipStreamLevel> levels;
+    std::vector<uint16_t> accum;
+    std::vector<unsigned char> row;
+};
+
+MipStream* MIP_CreateStream(int width, int bandRows, MipFilter filter, const MipBandFn& emit)
+{
+    MipStream* stream = new MipStream;
+    stream->bandRows = bandRows;
+    stream->filter = filter;
+    stream->emit = emit;
+    stream->accum.resize(width);
+    stream->row.resize(width);
+    for (int w = width; w >= 1; w /= 2)
+    {
+        MipStreamLevel level;
+        level.width = w;
+        level.band.resize((size_t)(bandRows < w ? bandRows : w) * w);
+        level.bandFirst = 0;
+        level.bandCount = 0;
+        level.windowFirst = 0;
+        level.windowCount = 0;
+        level.nextRow = 0;
+        stream->levels.push_back(level);
+    }
+    return stream;
+}
+
+static void AddRows(MipStream* stream, int index, const unsigned char* rows, int numRows);
+
+// builds every row of the next level that the window now covers, then drops the
+// rows no later output row reads.
+static void BuildNextLevel(MipStream* stream, int index)
+{
+    MipStreamLevel& level = stream->levels[index];
+    const int w = level.width;
+    const int half = w / 2;
+    const bool tent = UseTent(stream->filter, w);
+    while (level.nextRow < half)
+    {
+        const int y = level.nextRow;
+        const int last = tent ? (2 * y + 2 < w ? 2 * y + 2 : w - 1) : 2 * y + 1;
+        if (last >= level.windowFirst + level.windowCount)
+            break;
+
+        const unsigned char* r1 = &level.window[(size_t)(2 * y - level.windowFirst) * w];
+        const unsigned char* r2 = r1 + w;
+        const unsigned char* r0 = (y == 0 || !tent) ? r1 : r1 - w;
+        const unsigned char* r3 = (y == half - 1 || !tent) ? r2 : r2 + w;
+        DownsampleRow(r0, r1, r2, r3, w, stream->filter, &stream->accum[0], &stream->row[0]);
+        level.nextRow++;
+        AddRows(stream, index + 1, &stream->row[0], 1);
+    }
+
+    const int keepFrom = 2 * level.nextRow - 1 > level.windowFirst ? 2 * level.nextRow - 1 : level.windowFirst;
+    const int drop = keepFrom - level.windowFirst;
+    if (drop > 0)
+    {
+        level.window.erase(level.window.begin(), level.window.begin() + (size_t)drop * w);
+        level.windowFirst += drop;
+        level.windowCount -= drop;
+    }
+}
+
+static void FlushBand(MipStream* stream, int index)
+{
+    MipStreamLevel& level = stream->levels[index];
+    const int w = level.width;
+    stream->emit(index, w, level.bandFirst, level.bandCount, &level.band[0]);
+
+    if (index + 1 < (int)stream->levels.size())
+    {
+        level.window.insert(level.window.end(), level.band.begin(), level.band.begin() + (size_t)level.bandCount * w);
+        level.windowCount += level.bandCount;
+        level.bandFirst += level.bandCount;
+        level.bandCount = 0;
+        BuildNextLevel(stream, index);
+    }
+    else
+    {
+        level.bandFirst += level.bandCount;
+        level.bandCount = 0;
+    }
+}
+
+static void AddRows(MipStream* stream, int index, const unsigned char* rows, int numRows)
+{
+    for (int i = 0; i < numRows; ++i)
+    {
+        MipStreamLevel& level = stream->levels[index];
+        const int w = level.width;
+        memcpy(&level.band[(size_t)level.bandCount * w], rows + (size_t)i * w, w);
+        level.bandCount++;
+        if (level.bandCount == stream->bandRows || level.bandFirst + level.bandCount == w)
+            FlushBand(stream, index);
+    }
+}
+
+void MIP_PushRows(MipStream* stream, const unsigned char* rows, int numRows)
+{
+    AddRows(stream, 0, rows, numRows);
+}
+
+void MIP_PushSource(MipStream* stream, const RowSource& source, int width, int bandRows, bool flip)
+{
+    bandRows = bandRows < width ? bandRows : width;
+    std::vector<unsigned char> band((size_t)bandRows * width);
+    for (int done = 0; done < width; done += bandRows)
+    {
+        const int numRows = width - done < bandRows ? width - done : bandRows;
+        const int first = flip ? width - done - numRows : done;
+        source(first, numRows, &band[0]);
+        if (flip)
+        {
+            for (int y = numRows - 1; y >= 0; --y)
+                MIP_PushRows(stream, &band[(size_t)y * width], 1);
+        }
+        else
+            MIP_PushRows(stream, &band[0], numRows);
+    }
+}
+
+void MIP_FreeStream(MipStream* stream)
+{
+    delete stream;
+}
+
+int MIP_SaveRaw(const char* filename, int width, const RowSource& alpha, int bandRows, MipFilter filter,
+                PixelFormat format, bool premultiplied)
+{
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL)
+        return MIP_ERROR_FILE_OPEN;
+
+    // each band of each level is converted as soon as it's done and written into
+    // its place in the file, the file is bottom row first so the coverage is fed
+    // to the stream bottom up.
+    const int texelBytes = PIXEL_BytesPerTexel(format);
+    bandRows = bandRows < width ? bandRows : width;
+    std::vector<unsigned char> texels((size_t)bandRows * width * texelBytes);
+    bool ok = true;
+    MipStream* stream = MIP_CreateStream(width, bandRows, filter,
+        [&](int level, int w, int firstRow, int numRows, const unsigned char* rows)
+        {
+            PIXEL_ConvertImage(rows, w, numRows, format, premultiplied, false, &texels[0]);
+            const uint64_t offset = MIP_LevelOffset(width, level, format) + (uint64_t)firstRow * w * texelBytes;
+            if (ok)
+                ok = STREAM_WriteAt(fp, offset, &texels[0], (size_t)numRows * w * texelBytes);
+        });
+
+    MIP_PushSource(stream, alpha, width, bandRows, true);
+    MIP_FreeStream(stream);
+
+    if (fclose(fp) != 0)
+        ok = false;
+    return ok ? MIP_OK : MIP_ERROR_WRITING_FILE;
+}
@@ -0,0 +1,61 @@
+// Mip chain generation for the cooked .raw texture.
+
+#ifndef MIPH
+#define MIPH
+
+#include <stdint.h>
+#include <functional>
+#include "pixels.h"
+#include "stream.h"
+
+enum
+{
+    MIP_ERROR_FILE_OPEN,
+    MIP_ERROR_WRITING_FILE,
+    MIP_ERROR_MEMORY,
+    MIP_OK
+};
+
+enum MipFilter
+{
+    MIP_FILTER_BOX,   // 2x2 average, matches the old "magick convert -scale" output
+    MIP_FILTER_TENT   // 4x4 [1 3 3 1] separable kernel, softer but less aliasing
+};
+
+// number of bytes used by a full chain from width x width down to 1x1.
+uint64_t MIP_RawSize(int width, PixelFormat format);
+
+// byte offset of level in a chain laid out like MIP_RawSize, level 0 first.
+uint64_t MIP_LevelOffset(int width, int level, PixelFormat format);
+
+// halves a width x width 8-bit image into dest, which must hold (width/2) x (width/2) bytes.
+void MIP_Downsample(const unsigned char* src, int width, unsigned char* dest, MipFilter filter);
+
+// receives numRows finished rows of a mip level, starting at firstRow.
+typedef std::function<void (int level, int width, int firstRow, int numRows, const unsigned char* rows)> MipBandFn;
+
+struct MipStream;
+
+// builds the whole mip chain of a width x width 8-bit image that arrives a few rows
+// at a time, top to bottom, through MIP_PushRows.  Every level, level 0 included,
+// is handed to emit in bands of bandRows rows, the last band of a level may be
+// shorter.  Only about two bands of each level are held at once, and the result is
+// identical to calling MIP_Downsample on whole levels.  Both filters are symmetric,
+// so feeding the rows bottom up gives the chain of the flipped image.
+MipStream* MIP_CreateStream(int width, int bandRows, MipFilter filter, const MipBandFn& emit);
+void MIP_PushRows(MipStream* stream, const unsigned char* rows, int numRows);
+void MIP_FreeStream(MipStream* stream);
+
+// reads the width x width image from source in bands of bandRows rows and pushes all
+// of it, bottom row first when flip is set.
+void MIP_PushSource(MipStream* stream, const RowSource& source, int width, int bandRows, bool flip);
+
+// writes every mip level of the width x width alpha coverage into filename, bottom
+// row first, level 0 first.  Each level is converted straight from coverage, see
+// PIXEL_ConvertRow.  With PIXEL_LA8 this is the layout expected by
+// glTexImage2D(GL_LUMINANCE_ALPHA) without any fixup.  The coverage is read in
+// bands of bandRows rows and each level is written as soon as a band of it is done.
+int MIP_SaveRaw(const char* filename, int width, const RowSource& alpha, int bandRows, MipFilter filter,
+                PixelFormat format, bool premultiplied);
+
+#endif
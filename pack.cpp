@@ -0,0 +1,329 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include "pack.h"
+
+struct Rect
+{
+    Rect() {}
+    Rect(int xIn, int yIn, int wIn, int hIn) : x(xIn), y(yIn), w(wIn), h(hIn) {}
+    int x, y, w, h;
+};
+
+//
+// skyline bottom-left
+//
+
+struct SkylineNode
+{
+    int x, y, width;
+};
+
+class Skyline
+{
+public:
+    Skyline(int binWidth, int binHeight) : m_binWidth(binWidth), m_binHeight(binHeight)
+    {
+        SkylineNode node = { 0, 0, binWidth };
+        m_nodes.push_back(node);
+    }
+
+    // finds the lowest spot for a w x h rect, ties go to the narrowest segment.
+    bool FindPosition(int w, int h, int* bestIndex, int* bestX, int* bestY, int* bestTop, int* bestWidth) const
+    {
+        bool found = false;
+        for (size_t i = 0; i < m_nodes.size(); ++i)
+        {
+            int y;
+            if (Fits(i, w, h, &y))
+            {
+                int top = y + h;
+                if (top < *bestTop || (top == *bestTop && m_nodes[i].width < *bestWidth))
+                {
+                    *bestIndex = (int)i;
+                    *bestX = m_nodes[i].x;
+                    *bestY = y;
+                    *bestTop = top;
+                    *bestWidth = m_nodes[i].width;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    void Add(int index, int x, int y, int w, int h)
+    {
+        SkylineNode node = { x, y + h, w };
+        m_nodes.insert(m_nodes.begin() + index, node);
+
+        // trim or remove the segments now hidden under the new one.
+        for (size_t i = index + 1; i < m_nodes.size(); ++i)
+        {
+            int prevRight = m_nodes[i - 1].x + m_nodes[i - 1].width;
+            if (m_nodes[i].x >= prevRight)
+                break;
+            int shrink = prevRight - m_nodes[i].x;
+            m_nodes[i].x += shrink;
+            m_nodes[i].width -= shrink;
+            if (m_nodes[i].width > 0)
+                break;
+            m_nodes.erase(m_nodes.begin() + i);
+            --i;
+        }
+
+        // merge neighbours at the same height.
+        for (size_t i = 0; i + 1 < m_nodes.size(); ++i)
+        {
+            if (m_nodes[i].y == m_nodes[i + 1].y)
+            {
+                m_nodes[i].width += m_nodes[i + 1].width;
+                m_nodes.erase(m_nodes.begin() + i + 1);
+                --i;
+            }
+        }
+    }
+
+private:
+    bool Fits(size_t index, int w, int h, int* y) const
+    {
+        int x = m_nodes[index].x;
+        if (x + w > m_binWidth)
+            return false;
+        int widthLeft = w;
+        *y = m_nodes[index].y;
+        while (widthLeft > 0)
+        {
+            if (index >= m_nodes.size())
+                return false;
+            if (m_nodes[index].y > *y)
+                *y = m_nodes[index].y;
+            if (*y + h > m_binHeight)
+                return false;
+            widthLeft -= m_nodes[index].width;
+            ++index;
+        }
+        return true;
+    }
+
+    int m_binWidth;
+    int m_binHeight;
+    std::vector<SkylineNode> m_nodes;
+};
+
+static bool PackSkyline(PackRect* rects, const std::vector<int>& order, int binWidth, int binHeight,
+                        bool allowRotation)
+{
+    Skyline skyline(binWidth, binHeight);
+    bool allPacked = true;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        PackRect& r = rects[order[i]];
+        int index = -1, x = 0, y = 0, top = INT_MAX, width = INT_MAX;
+        r.rotated = false;
+        skyline.FindPosition(r.width, r.height, &index, &x, &y, &top, &width);
+        if (allowRotation && r.width != r.height &&
+            skyline.FindPosition(r.height, r.width, &index, &x, &y, &top, &width))
+        {
+            r.rotated = true;
+        }
+
+        if (index < 0)
+        {
+            allPacked = false;
+            continue;
+        }
+
+        r.x = x;
+        r.y = y;
+        r.packed = true;
+        skyline.Add(index, x, y, r.rotated ? r.height : r.width, r.rotated ? r.width : r.height);
+    }
+    return allPacked;
+}
+
+//
+// maxrects best short side fit
+//
+
+static bool Contains(const Rect& a, const Rect& b)
+{
+    return b.x >= a.x && b.y >= a.y && b.x + b.w <= a.x + a.w && b.y + b.h <= a.y + a.h;
+}
+
+class MaxRects
+{
+public:
+    MaxRects(int binWidth, int binHeight)
+    {
+        m_free.push_back(Rect(0, 0, binWidth, binHeight));
+    }
+
+    bool FindPosition(int w, int h, Rect* best, int* bestShort, int* bestLong) const
+    {
+        bool found = false;
+        for (size_t i = 0; i < m_free.size(); ++i)
+        {
+            const Rect& f = m_free[i];
+            if (w <= f.w && h <= f.h)
+            {
+                int leftoverX = f.w - w;
+                int leftoverY = f.h - h;
+                int shortSide = std::min(leftoverX, leftoverY);
+                int longSide = std::max(leftoverX, leftoverY);
+                if (shortSide < *bestShort || (shortSide == *bestShort && longSide < *bestLong))
+                {
+                    *best = Rect(f.x, f.y, w, h);
+                    *bestShort = shortSide;
+                    *bestLong = longSide;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    void Place(const Rect& used)
+    {
+        std::vector<Rect> remaining;
+        std::vector<Rect> split;
+        for (size_t i = 0; i < m_free.size(); ++i)
+        {
+            if (!Split(m_free[i], used, &split))
+                remaining.push_back(m_free[i]);
+        }
+        const size_t numOld = remaining.size();
+        remaining.insert(remaining.end(), split.begin(), split.end());
+        m_free.swap(remaining);
+        Prune(numOld);
+    }
+
+private:
+    // adds the maximal free rects left over when used overlaps f.
+    // returns false if they don't intersect.
+    static bool Split(const Rect& f, const Rect& used, std::vector<Rect>* split)
+    {
+        if (used.x >= f.x + f.w || used.x + used.w <= f.x ||
+            used.y >= f.y + f.h || used.y + used.h <= f.y)
+            return false;
+
+        if (used.y > f.y)
+            split->push_back(Rect(f.x, f.y, f.w, used.y - f.y));
+        if (used.y + used.h < f.y + f.h)
+            split->push_back(Rect(f.x, used.y + used.h, f.w, f.y + f.h - (used.y + used.h)));
+        if (used.x > f.x)
+            split->push_back(Rect(f.x, f.y, used.x - f.x, f.h));
+        if (used.x + used.w < f.x + f.w)
+            split->push_back(Rect(used.x + used.w, f.y, f.x + f.w - (used.x + used.w), f.h));
+        return true;
+    }
+
+    // true if the free rect at index a is contained in the one at b.  Of two equal
+    // rects the later one is kept.
+    bool Dominated(size_t a, size_t b) const
+    {
+        return Contains(m_free[b], m_free[a]) && (a < b || !Contains(m_free[a], m_free[b]));
+    }
+
+    // removes free rects that are fully contained in another one.  The rects before
+    // first new were already pruned against each other, so only the rects from the
+    // latest split need to be compared against the list.
+    void Prune(size_t firstNew)
+    {
+        std::vector<char> dead(m_free.size(), 0);
+        for (size_t i = firstNew; i < m_free.size(); ++i)
+        {
+            for (size_t j = 0; j < m_free.size(); ++j)
+            {
+                if (j == i)
+                    continue;
+                if (!dead[i] && Dominated(i, j))
+                    dead[i] = 1;
+                if (j < firstNew && Dominated(j, i))
+                    dead[j] = 1;
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < m_free.size(); ++i)
+        {
+            if (!dead[i])
+                m_free[kept++] = m_free[i];
+        }
+        m_free.resize(kept);
+    }
+
+    std::vector<Rect> m_free;
+};
+
+static bool PackMaxRects(PackRect* rects, const std::vector<int>& order, int binWidth, int binHeight,
+                         bool allowRotation)
+{
+    MaxRects maxRects(binWidth, binHeight);
+    bool allPacked = true;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        PackRect& r = rects[order[i]];
+        Rect best;
+        int bestShort = INT_MAX, bestLong = INT_MAX;
+        bool found = maxRects.FindPosition(r.width, r.height, &best, &bestShort, &bestLong);
+        r.rotated = false;
+        if (allowRotation && r.width != r.height &&
+            maxRects.FindPosition(r.height, r.width, &best, &bestShort, &bestLong))
+        {
+            found = true;
+            r.rotated = true;
+        }
+
+        if (!found)
+        {
+            allPacked = false;
+            continue;
+        }
+
+        r.x = best.x;
+        r.y = best.y;
+        r.packed = true;
+        maxRects.Place(best);
+    }
+    return allPacked;
+}
+
+bool PACK_Rects(PackRect* rects, int numRects, int binWidth, int binHeight,
+                PackHeuristic heuristic, bool allowRotation)
+{
+    // empty rects don't take up any space, everything else is packed largest first.
+    std::vector<int> order;
+    for (int i = 0; i < numRects; ++i)
+    {
+        rects[i].x = 0;
+        rects[i].y = 0;
+        rects[i].rotated = false;
+        rects[i].packed = (rects[i].width <= 0 || rects[i].height <= 0);
+        if (!rects[i].packed)
+            order.push_back(i);
+    }
+
+    if (heuristic == PACK_SKYLINE)
+    {
+        std::stable_sort(order.begin(), order.end(), [rects](int a, int b) {
+            if (rects[a].height != rects[b].height)
+                return rects[a].height > rects[b].height;
+            return rects[a].width > rects[b].width;
+        });
+        return PackSkyline(rects, order, binWidth, binHeight, allowRotation);
+    }
+    else
+    {
+        std::stable_sort(order.begin(), order.end(), [rects](int a, int b) {
+            int maxA = std::max(rects[a].width, rects[a].height);
+            int maxB = std::max(rects[b].width, rects[b].height);
+            if (maxA != maxB)
+                return maxA > maxB;
+            return std::min(rects[a].width, rects[a].height) > std::min(rects[b].width, rects[b].height);
+        });
+        return PackMaxRects(rects, order, binWidth, binHeight, allowRotation);
+    }
+}
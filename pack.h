@@ -0,0 +1,31 @@
+// Rectangle bin packing for the glyph atlas.
+
+#ifndef PACKH
+#define PACKH
+
+enum PackHeuristic
+{
+    PACK_SKYLINE,   // skyline bottom-left, fast and good for similarly sized glyphs
+    PACK_MAXRECTS   // maxrects best short side fit, slower but denser
+};
+
+struct PackRect
+{
+    // input, the size of the rectangle including any padding.
+    int width;
+    int height;
+
+    // output, the top left corner in the bin.  When rotated is set the rectangle was
+    // turned 90 degrees clockwise and occupies height x width texels.
+    int x;
+    int y;
+    bool rotated;
+    bool packed;
+};
+
+// places every rect inside a binWidth x binHeight bin without overlap.
+// Returns false if some of them did not fit, those have packed set to false.
+bool PACK_Rects(PackRect* rects, int numRects, int binWidth, int binHeight,
+                PackHeuristic heuristic, bool allowRotation);
+
+#endif
@@ -0,0 +1,93 @@
+#include <string.h>
+#include <stddef.h>
+
+#include "pixels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXELS_SSE2 1
+#endif
+
+int PIXEL_BytesPerTexel(PixelFormat format)
+{
+    switch (format)
+    {
+    case PIXEL_LA8: return 2;
+    case PIXEL_R8: return 1;
+    default: return 4;
+    }
+}
+
+// each kernel handles 16 texels at a time with SSE2 by interleaving the coverage
+// with itself or with white, then finishes the row one texel at a time.
+static void ConvertLA8(const unsigned char* coverage, int width, bool premultiplied, unsigned char* dest)
+{
+    int x = 0;
+#ifdef PIXELS_SSE2
+    const __m128i white = _mm_set1_epi8((char)0xff);
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m128i c = _mm_loadu_si128((const __m128i*)(coverage + x));
+        const __m128i l = premultiplied ? c : white;
+        _mm_storeu_si128((__m128i*)(dest + x * 2), _mm_unpacklo_epi8(l, c));
+        _mm_storeu_si128((__m128i*)(dest + x * 2 + 16), _mm_unpackhi_epi8(l, c));
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        dest[x * 2 + 0] = premultiplied ? coverage[x] : 255;
+        dest[x * 2 + 1] = coverage[x];
+    }
+}
+
+static void ConvertRGBA8(const unsigned char* coverage, int width, bool premultiplied, unsigned char* dest)
+{
+    int x = 0;
+#ifdef PIXELS_SSE2
+    const __m128i white = _mm_set1_epi8((char)0xff);
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m128i c = _mm_loadu_si128((const __m128i*)(coverage + x));
+        const __m128i l = premultiplied ? c : white;
+        const __m128i lo = _mm_unpacklo_epi8(l, c);
+        const __m128i hi = _mm_unpackhi_epi8(l, c);
+        const __m128i rg0 = premultiplied ? _mm_unpacklo_epi8(c, c) : white;
+        const __m128i rg1 = premultiplied ? _mm_unpackhi_epi8(c, c) : white;
+        unsigned char* out = dest + x * 4;
+        _mm_storeu_si128((__m128i*)(out + 0), _mm_unpacklo_epi16(rg0, lo));
+        _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi16(rg0, lo));
+        _mm_storeu_si128((__m128i*)(out + 32), _mm_unpacklo_epi16(rg1, hi));
+        _mm_storeu_si128((__m128i*)(out + 48), _mm_unpackhi_epi16(rg1, hi));
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        const unsigned char l = premultiplied ? coverage[x] : 255;
+        dest[x * 4 + 0] = l;
+        dest[x * 4 + 1] = l;
+        dest[x * 4 + 2] = l;
+        dest[x * 4 + 3] = coverage[x];
+    }
+}
+
+void PIXEL_ConvertRow(const unsigned char* coverage, int width, PixelFormat format, bool premultiplied,
+                      unsigned char* dest)
+{
+    if (format == PIXEL_LA8)
+        ConvertLA8(coverage, width, premultiplied, dest);
+    else if (format == PIXEL_R8)
+        memcpy(dest, coverage, width);
+    else
+        ConvertRGBA8(coverage, width, premultiplied, dest);
+}
+
+void PIXEL_ConvertImage(const unsigned char* coverage, int width, int height, PixelFormat format,
+                        bool premultiplied, bool flip, unsigned char* dest)
+{
+    const size_t rowBytes = (size_t)width * PIXEL_BytesPerTexel(format);
+    for (int y = 0; y < height; ++y)
+    {
+        const int srcRow = flip ? height - 1 - y : y;
+        PIXEL_ConvertRow(coverage + (size_t)srcRow * width, width, format, premultiplied, dest + y * rowBytes);
+    }
+}
@@ -0,0 +1,25 @@
+// Conversion of 8-bit glyph coverage into uncompressed texel formats.
+
+#ifndef PIXELSH
+#define PIXELSH
+
+enum PixelFormat
+{
+    PIXEL_LA8,      // white luminance plus coverage as alpha, the .raw default
+    PIXEL_R8,       // coverage only, also used as A8 or L8
+    PIXEL_RGBA8     // white rgb plus coverage as alpha
+};
+
+int PIXEL_BytesPerTexel(PixelFormat format);
+
+// converts one row of width coverage values into dest, which must hold
+// width * PIXEL_BytesPerTexel(format) bytes.  premultiplied scales the white color
+// by the coverage, so la8 becomes (c, c) and rgba8 (c, c, c, c), r8 is unaffected.
+void PIXEL_ConvertRow(const unsigned char* coverage, int width, PixelFormat format, bool premultiplied,
+                      unsigned char* dest);
+
+// converts a width x height image, flip writes the bottom row first.
+void PIXEL_ConvertImage(const unsigned char* coverage, int width, int height, PixelFormat format,
+                        bool premultiplied, bool flip, unsigned char* dest);
+
+#endif
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <zlib.h>
+
+#include "png.h"
+#include "jobs.h"
+#include "pixels.h"
+
+// stripes have a fixed height, so the file is the same no matter how many threads
+// compress it.  Smaller stripes would cost compression ratio for little gain.
+static const int kRowsPerStripe = 256;
+
+// the largest chunk the png spec allows, longer zlib streams go in several IDATs.
+static const unsigned long kMaxChunkLength = 0x7fffffff;
+
+struct PngStripe
+{
+    int firstRow;
+    int numRows;
+    uLong adler;
+    uLong length;
+    int status;
+    std::vector<unsigned char> deflated;
+};
+
+static PixelFormat ColorTypeFormat(PngColorType colorType)
+{
+    switch (colorType)
+    {
+    case PNG_COLOR_GRAY: return PIXEL_R8;
+    case PNG_COLOR_GRAY_ALPHA: return PIXEL_LA8;
+    default: return PIXEL_RGBA8;
+    }
+}
+
+static unsigned char ColorTypeCode(PngColorType colorType)
+{
+    switch (colorType)
+    {
+    case PNG_COLOR_GRAY: return 0;
+    case PNG_COLOR_GRAY_ALPHA: return 4;
+    default: return 6;
+    }
+}
+
+static unsigned char Paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return (unsigned char)a;
+    else if (pb <= pc)
+        return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+// applies all five png filters to row and keeps the one with the smallest sum of
+// absolute signed residuals, the heuristic recommended by the png spec.
+// prev is all zeros for the first row of the image.
+static void FilterRow(const unsigned char* row, const unsigned char* prev, int rowBytes, int bpp,
+                      unsigned char* candidates, unsigned char* dest)
+{
+    unsigned char* out[5];
+    for (int f = 0; f < 5; ++f)
+        out[f] = candidates + f * rowBytes;
+
+    for (int x = 0; x < rowBytes; ++x)
+    {
+        int a = (x >= bpp) ? row[x - bpp] : 0;
+        int b = prev[x];
+        int c = (x >= bpp) ? prev[x - bpp] : 0;
+        out[0][x] = row[x];
+        out[1][x] = (unsigned char)(row[x] - a);
+        out[2][x] = (unsigned char)(row[x] - b);
+        out[3][x] = (unsigned char)(row[x] - ((a + b) >> 1));
+        out[4][x] = (unsigned char)(row[x] - Paeth(a, b, c));
+    }
+
+    int best = 0;
+    unsigned long bestSum = ~0ul;
+    for (int f = 0; f < 5; ++f)
+    {
+        unsigned long sum = 0;
+        for (int x = 0; x < rowBytes; ++x)
+            sum += (out[f][x] < 128) ? out[f][x] : 256 - out[f][x];
+        if (sum < bestSum)
+        {
+            bestSum = sum;
+            best = f;
+        }
+    }
+
+    dest[0] = (unsigned char)best;
+    memcpy(dest + 1, out[best], rowBytes);
+}
+
+// filter and deflate a run of rows as an independent raw deflate stream.
+// All but the last stripe end on a sync flush so the streams can be concatenated.
+// coverage points at the first row of the stripe, the row above it is read too
+// unless the stripe starts the image.
+static void CompressStripe(PngStripe* stripe, const unsigned char* coverage, int width,
+                           PngColorType colorType, bool last)
+{
+    const int bpp = PIXEL_BytesPerTexel(ColorTypeFormat(colorType));
+    const int rowBytes = width * bpp;
+    std::vector<unsigned char> rows(rowBytes * 2, 0);
+    std::vector<unsigned char> candidates(rowBytes * 5);
+    std::vector<unsigned char> filtered((size_t)stripe->numRows * (rowBytes + 1));
+    unsigned char* row = &rows[0];
+    unsigned char* prev = &rows[rowBytes];
+
+    for (int i = -1; i < stripe->numRows; ++i)
+    {
+        if (stripe->firstRow + i < 0)
+            continue;
+        PIXEL_ConvertRow(coverage + (ptrdiff_t)i * width, width, ColorTypeFormat(colorType), false, row);
+        if (i >= 0)
+            FilterRow(row, prev, rowBytes, bpp, &candidates[0], &filtered[(size_t)i * (rowBytes + 1)]);
+        unsigned char* temp = prev;
+        prev = row;
+        row = temp;
+    }
+
+    stripe->length = (uLong)filtered.size();
+    stripe->adler = adler32(adler32(0, Z_NULL, 0), &filtered[0], (uInt)filtered.size());
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        stripe->status = PNG_ERROR_COMPRESSION;
+        return;
+    }
+    stripe->deflated.resize(deflateBound(&zs, (uLong)filtered.size()) + 16);
+    zs.next_in = &filtered[0];
+    zs.avail_in = (uInt)filtered.size();
+    zs.next_out = &stripe->deflated[0];
+    zs.avail_out = (uInt)stripe->deflated.size();
+    int err = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+    bool ok = last ? (err == Z_STREAM_END) : (err == Z_OK && zs.avail_in == 0);
+    stripe->deflated.resize(zs.total_out);
+    deflateEnd(&zs);
+    stripe->status = ok ? PNG_OK : PNG_ERROR_COMPRESSION;
+}
+
+static void WriteU32(unsigned char* dest, unsigned long value)
+{
+    dest[0] = (unsigned char)(value >> 24);
+    dest[1] = (unsigned char)(value >> 16);
+    dest[2] = (unsigned char)(value >> 8);
+    dest[3] = (unsigned char)(value);
+}
+
+// writes length, type, data and crc of a single chunk
+static bool WriteChunk(FILE* fp, const char* type, const unsigned char* data, unsigned long length)
+{
+    unsigned char header[8];
+    WriteU32(header, length);
+    memcpy(header + 4, type, 4);
+    uLong crc = crc32(0, (const Bytef*)type, 4);
+    if (length)
+        crc = crc32(crc, data, (uInt)length);
+    unsigned char footer[4];
+    WriteU32(footer, crc);
+
+    return fwrite(header, 1, 8, fp) == 8 &&
+        (length == 0 || fwrite(data, 1, length, fp) == length) &&
+        fwrite(footer, 1, 4, fp) == 4;
+}
+
+// writes the zlib stream as IDAT chunks while it's produced.  The length of a chunk
+// is only known once it's closed, so it's patched in afterwards.
+struct IdatWriter
+{
+    FILE* fp;
+    uint64_t position;      // end of the file so far
+    uint64_t chunkStart;    // offset of the open chunk
+    unsigned long length;
+    uLong crc;
+    bool open;
+};
+
+static bool CloseIdat(IdatWriter* writer)
+{
+    if (!writer->open)
+        return true;
+    writer->open = false;
+    unsigned char bytes[4];
+    WriteU32(bytes, writer->crc);
+    bool ok = STREAM_WriteAt(writer->fp, writer->position, bytes, 4);
+    writer->position += 4;
+    WriteU32(bytes, writer->length);
+    return ok && STREAM_WriteAt(writer->fp, writer->chunkStart, bytes, 4) &&
+        fseek(writer->fp, 0, SEEK_END) == 0;
+}
+
+static bool WriteIdat(IdatWriter* writer, const unsigned char* data, size_t size)
+{
+    while (size > 0)
+    {
+        if (writer->open && writer->length == kMaxChunkLength && !CloseIdat(writer))
+            return false;
+        if (!writer->open)
+        {
+            unsigned char header[8] = { 0, 0, 0, 0, 'I', 'D', 'A', 'T' };
+            if (!STREAM_WriteAt(writer->fp, writer->position, header, 8))
+                return false;
+            writer->chunkStart = writer->position;
+            writer->position += 8;
+            writer->length = 0;
+            writer->crc = crc32(0, header + 4, 4);
+            writer->open = true;
+        }
+        size_t piece = kMaxChunkLength - writer->length;
+        if (piece > size)
+            piece = size;
+        if (!STREAM_WriteAt(writer->fp, writer->position, data, piece))
+            return false;
+        writer->crc = crc32(writer->crc, data, (uInt)piece);
+        writer->position += piece;
+        writer->length += (unsigned long)piece;
+        data += piece;
+        size -= piece;
+    }
+    return true;
+}
+
+int PNG_Save(const char* filename, int width, int height, PngColorType colorType,
+             const RowSource& coverage, int bandRows, int numThreads)
+{
+    int numStripes = (height + kRowsPerStripe - 1) / kRowsPerStripe;
+    if (numStripes < 1)
+        numStripes = 1;
+
+    // stripes are read and compressed a batch at a time, each batch is as many whole
+    // stripes as fit in bandRows.
+    int stripesPerBatch = bandRows / kRowsPerStripe;
+    if (stripesPerBatch < 1)
+        stripesPerBatch = 1;
+    const int batchRows = stripesPerBatch * kRowsPerStripe;
+
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL)
+        return PNG_ERROR_FILE_OPEN;
+
+    static const unsigned char kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    unsigned char ihdr[13];
+    WriteU32(ihdr, width);
+    WriteU32(ihdr + 4, height);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = ColorTypeCode(colorType);
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // no interlace
+
+    bool ok = fwrite(kSignature, 1, 8, fp) == 8 &&
+        WriteChunk(fp, "IHDR", ihdr, 13);
+
+    // stitch the stripes into one zlib stream: header, deflate data, combined adler32.
+    IdatWriter writer = { fp, 8 + 12 + 13, 0, 0, 0, false };
+    static const unsigned char kZlibHeader[2] = { 0x78, 0xda };
+    ok = ok && WriteIdat(&writer, kZlibHeader, 2);
+
+    // the first row of the batch buffer is the last row of the previous batch, the
+    // filters of a stripe look at the row above it.
+    const int maxRows = batchRows < height ? batchRows : height;
+    std::vector<unsigned char> rows((size_t)(maxRows + 1) * width);
+    std::vector<PngStripe> stripes(stripesPerBatch);
+    uLong adler = adler32(0, Z_NULL, 0);
+    int status = PNG_OK;
+    for (int batchFirst = 0; ok && status == PNG_OK && batchFirst < height; batchFirst += batchRows)
+    {
+        const int numRows = height - batchFirst < batchRows ? height - batchFirst : batchRows;
+        // only the last batch can be short, so the row above is always the last one
+        if (batchFirst > 0)
+            memcpy(&rows[0], &rows[(size_t)maxRows * width], width);
+        coverage(batchFirst, numRows, &rows[width]);
+
+        const int batchStripes = (numRows + kRowsPerStripe - 1) / kRowsPerStripe;
+        for (int i = 0; i < batchStripes; ++i)
+        {
+            stripes[i].firstRow = batchFirst + i * kRowsPerStripe;
+            stripes[i].numRows = (i == batchStripes - 1) ? numRows - i * kRowsPerStripe : kRowsPerStripe;
+        }
+        const bool lastBatch = batchFirst + numRows == height;
+        JOB_ParallelFor(batchStripes, numThreads, [&](int, int i) {
+            CompressStripe(&stripes[i], &rows[(size_t)(1 + i * kRowsPerStripe) * width], width, colorType,
+                           lastBatch && i == batchStripes - 1);
+        });
+
+        for (int i = 0; i < batchStripes && ok && status == PNG_OK; ++i)
+        {
+            status = stripes[i].status;
+            if (status != PNG_OK)
+                break;
+            ok = WriteIdat(&writer, &stripes[i].deflated[0], stripes[i].deflated.size());
+            adler = adler32_combine(adler, stripes[i].adler, (z_off_t)stripes[i].length);
+        }
+    }
+
+    unsigned char trailer[4];
+    WriteU32(trailer, adler);
+    ok = ok && status == PNG_OK && WriteIdat(&writer, trailer, 4) && CloseIdat(&writer) &&
+        WriteChunk(fp, "IEND", NULL, 0);
+
+    if (fclose(fp) != 0)
+        ok = false;
+    if (status != PNG_OK)
+        return status;
+    return ok ? PNG_OK : PNG_ERROR_WRITING_FILE;
+}
@@ -0,0 +1,34 @@
+// Minimal PNG writer for glyph atlases.
+
+#ifndef PNGH
+#define PNGH
+
+#include "stream.h"
+
+enum
+{
+    PNG_ERROR_FILE_OPEN,
+    PNG_ERROR_WRITING_FILE,
+    PNG_ERROR_MEMORY,
+    PNG_ERROR_COMPRESSION,
+    PNG_OK
+};
+
+enum PngColorType
+{
+    PNG_COLOR_GRAY,         // alpha-only, the coverage is stored as a single gray channel
+    PNG_COLOR_GRAY_ALPHA,   // white luminance plus coverage as alpha
+    PNG_COLOR_RGBA          // white rgb plus coverage as alpha
+};
+
+// encodes the width x height 8-bit coverage as a png, top row first.
+// Every scanline is adaptively filtered, then the image is deflated in fixed height
+// horizontal stripes, spread over the threads, which are stitched into a single zlib
+// stream.  The coverage is read and compressed in batches of whole stripes of up to
+// bandRows rows, each batch is written before the next is read.  The output does not
+// depend on the number of threads or on bandRows.
+// numThreads of 0 uses one thread per hardware core.
+int PNG_Save(const char* filename, int width, int height, PngColorType colorType,
+             const RowSource& coverage, int bandRows, int numThreads);
+
+#endif
@@ -0,0 +1,86 @@
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#include "raster.h"
+#include "jobs.h"
+
+struct RasterWorker
+{
+    RasterWorker() : library(0), face(0), error(0) {}
+    FT_Library library;
+    FT_Face face;
+    FT_Error error;
+};
+
+// copy the bitmap out of the glyph slot, scanline by scanline.
+static void CopyBitmap(FT_GlyphSlot slot, GlyphBitmap* bitmap)
+{
+    const FT_Bitmap& ftBitmap = slot->bitmap;
+    bitmap->width = ftBitmap.width;
+    bitmap->rows = ftBitmap.rows;
+    bitmap->metrics = slot->metrics;
+    bitmap->pixels.resize(bitmap->width * bitmap->rows);
+    for (int j = 0; j < bitmap->rows; ++j)
+    {
+        memcpy(&bitmap->pixels[j * bitmap->width], ftBitmap.buffer + (ftBitmap.pitch * j), bitmap->width);
+    }
+}
+
+FT_Error RASTER_OpenFace(const unsigned char* fontData, size_t fontSize, int pixels,
+                         FT_Library* library, FT_Face* face)
+{
+    *library = 0;
+    *face = 0;
+    FT_Error error = FT_Init_FreeType(library);
+    if (!error)
+        error = FT_New_Memory_Face(*library, fontData, (FT_Long)fontSize, 0, face);
+    if (!error)
+        error = FT_Set_Char_Size(*face, pixels << 6, 0, 72, 0);
+    return error;
+}
+
+void RASTER_CloseFace(FT_Library library, FT_Face face)
+{
+    if (face)
+        FT_Done_Face(face);
+    if (library)
+        FT_Done_FreeType(library);
+}
+
+bool RASTER_RenderGlyph(FT_Face face, FT_UInt glyphIndex, GlyphBitmap* bitmap)
+{
+    // load glyph into face->glyph, then render it into face->glyph->bitmap
+    if (FT_Load_Glyph(face, glyphIndex, FT_LOAD_DEFAULT) ||
+        FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL))
+        return false;
+
+    CopyBitmap(face->glyph, bitmap);
+    return true;
+}
+
+int RASTER_RenderGlyphs(const unsigned char* fontData, size_t fontSize, int pixels,
+                        const FT_UInt* glyphIndices, int numGlyphs, GlyphBitmap* bitmaps,
+                        int numThreads)
+{
+    std::vector<RasterWorker> workers(JOB_ThreadCount(numThreads));
+    std::atomic<int> result(RASTER_OK);
+
+    JOB_ParallelFor(numGlyphs, (int)workers.size(), [&](int worker, int i) {
+        RasterWorker& w = workers[worker];
+        if (w.face == 0 && w.error == 0)
+            w.error = RASTER_OpenFace(fontData, fontSize, pixels, &w.library, &w.face);
+        if (w.error)
+        {
+            result = RASTER_ERROR_FACE;
+            return;
+        }
+
+        if (!RASTER_RenderGlyph(w.face, glyphIndices[i], &bitmaps[i]))
+            result = RASTER_ERROR_RENDER;
+    });
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        RASTER_CloseFace(workers[i].library, workers[i].face);
+    return result;
+}
@@ -0,0 +1,45 @@
+// Glyph rasterization.
+
+#ifndef RASTERH
+#define RASTERH
+
+#include <stddef.h>
+#include <vector>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+enum
+{
+    RASTER_ERROR_FACE,
+    RASTER_ERROR_RENDER,
+    RASTER_OK
+};
+
+// a rendered glyph, kept around until the atlas has been packed.
+struct GlyphBitmap
+{
+    int width;
+    int rows;
+    FT_Glyph_Metrics metrics;
+    std::vector<unsigned char> pixels;
+};
+
+// opens a private FT_Library and FT_Face over fontData, sized the way the atlas is.
+// Used to give each thread a face of its own.
+FT_Error RASTER_OpenFace(const unsigned char* fontData, size_t fontSize, int pixels,
+                         FT_Library* library, FT_Face* face);
+
+void RASTER_CloseFace(FT_Library library, FT_Face face);
+
+// renders a single glyph with a face from RASTER_OpenFace, false if FreeType fails.
+bool RASTER_RenderGlyph(FT_Face face, FT_UInt glyphIndex, GlyphBitmap* bitmap);
+
+// renders glyphIndices[i] of the font in fontData into bitmaps[i] at the given pixel size.
+// Each thread opens its own FT_Library and FT_Face over the shared, read-only font
+// data, so nothing FreeType owns is ever touched by two threads.  The bitmaps only
+// depend on the glyph, so the result is the same for any numThreads.
+int RASTER_RenderGlyphs(const unsigned char* fontData, size_t fontSize, int pixels,
+                        const FT_UInt* glyphIndices, int numGlyphs, GlyphBitmap* bitmaps,
+                        int numThreads);
+
+#endif
@@ -0,0 +1,106 @@
+#include <math.h>
+#include <vector>
+
+#include "sdf.h"
+
+static const float kInfinity = 1e20f;
+
+// squared distance transform of a 1D sampled function, Felzenszwalb & Huttenlocher,
+// "Distance Transforms of Sampled Functions".  f is read from and written to with
+// the given stride, v, z and d are scratch space of n, n + 1 and n entries.
+static void Transform1D(float* f, int n, int stride, int* v, float* z, float* d)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -kInfinity;
+    z[1] = kInfinity;
+    for (int q = 1; q < n; ++q)
+    {
+        // intersection of the parabola from q with the rightmost one in the envelope,
+        // dropping parabolas that are hidden.  z[0] is -infinity so k never goes negative.
+        float fq = f[q * stride] + (float)q * q;
+        float s = (fq - (f[v[k] * stride] + (float)v[k] * v[k])) / (2.0f * (q - v[k]));
+        while (s <= z[k])
+        {
+            k--;
+            s = (fq - (f[v[k] * stride] + (float)v[k] * v[k])) / (2.0f * (q - v[k]));
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = kInfinity;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q)
+    {
+        while (z[k + 1] < q)
+            k++;
+        float dq = (float)(q - v[k]);
+        d[q] = dq * dq + f[v[k] * stride];
+    }
+    for (int q = 0; q < n; ++q)
+        f[q * stride] = d[q];
+}
+
+// in place 2D squared distance transform, columns then rows.
+static void Transform2D(float* grid, int width, int height)
+{
+    int n = (width > height) ? width : height;
+    std::vector<int> v(n);
+    std::vector<float> z(n + 1);
+    std::vector<float> d(n);
+
+    for (int x = 0; x < width; ++x)
+        Transform1D(grid + x, height, width, &v[0], &z[0], &d[0]);
+    for (int y = 0; y < height; ++y)
+        Transform1D(grid + y * width, width, 1, &v[0], &z[0], &d[0]);
+}
+
+void SDF_Generate(GlyphBitmap* bitmap, int spread)
+{
+    const int width = bitmap->width + 2 * spread;
+    const int height = bitmap->rows + 2 * spread;
+    const int size = width * height;
+
+    // outside holds the squared distance to the nearest inside texel and inside the
+    // squared distance to the nearest outside texel.
+    std::vector<float> outside(size, kInfinity);
+    std::vector<float> inside(size, 0.0f);
+    for (int y = 0; y < bitmap->rows; ++y)
+    {
+        for (int x = 0; x < bitmap->width; ++x)
+        {
+            if (bitmap->pixels[y * bitmap->width + x] >= 128)
+            {
+                int i = (y + spread) * width + (x + spread);
+                outside[i] = 0.0f;
+                inside[i] = kInfinity;
+            }
+        }
+    }
+
+    if (size > 0)
+    {
+        Transform2D(&outside[0], width, height);
+        Transform2D(&inside[0], width, height);
+    }
+
+    // texel centers next to the edge are half a texel away from it.
+    std::vector<unsigned char> pixels(size);
+    const float scale = 127.5f / (float)(spread > 0 ? spread : 1);
+    for (int i = 0; i < size; ++i)
+    {
+        float distance = (outside[i] > 0.0f) ? sqrtf(outside[i]) - 0.5f : 0.5f - sqrtf(inside[i]);
+        float value = 127.5f - distance * scale;
+        if (value < 0.0f)
+            value = 0.0f;
+        if (value > 255.0f)
+            value = 255.0f;
+        pixels[i] = (unsigned char)(value + 0.5f);
+    }
+
+    bitmap->width = width;
+    bitmap->rows = height;
+    bitmap->pixels.swap(pixels);
+}
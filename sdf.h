@@ -0,0 +1,15 @@
+// Signed distance field glyphs.
+
+#ifndef SDFH
+#define SDFH
+
+#include "raster.h"
+
+// replaces the coverage in bitmap with a signed distance field that is spread pixels
+// larger on every side.  Coverage is thresholded at 50% and the distance to the
+// nearest texel on the other side of the edge is found with an exact euclidean
+// distance transform.  The edge maps to 128, distances of spread pixels or more
+// outside or inside saturate at 0 and 255.
+void SDF_Generate(GlyphBitmap* bitmap, int spread);
+
+#endif
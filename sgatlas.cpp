@@ -0,0 +1,426 @@
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "sgatlas.h"
+#include "mapfile.h"
+#include "raster.h"
+
+// sgatlas_glyph finds glyphs through an open addressing table of atomic entries,
+// (codepoint + 1) << 32 | slot, and reads the slot under a sequence lock, so a
+// hit never blocks.  Everything that changes the atlas happens under one mutex.
+
+static const int kGlyphWords = sizeof(SGAtlasGlyph) / sizeof(uint32_t);
+
+static const uint64_t kEmptyEntry = 0;
+static const uint64_t kDeletedEntry = 1;
+static const uint32_t kMissingSlot = 0xffffffffu;  // codepoint not in the font
+static const uint32_t kNoSlot = 0xfffffffeu;       // codepoint not in the table
+static const uint32_t kTooLargeSlot = 0xfffffffdu; // glyph doesn't fit a cell
+static const uint32_t kMaxCodepoint = 0x10ffff;
+
+struct AtlasSlot
+{
+    std::atomic<uint32_t> sequence;     // odd while the slot is being rewritten
+    std::atomic<uint32_t> lastUsed;     // frame number
+    std::atomic<uint32_t> codepoint;
+    std::atomic<uint32_t> glyph[kGlyphWords];
+};
+
+struct SGAtlas
+{
+    MappedFile file;
+    FT_Library library;
+    FT_Face face;                       // only used under the lock
+    float lineHeight;
+
+    int textureWidth;
+    int padding;
+    int cellWidth;
+    int cellHeight;
+    int cellsPerRow;
+    uint32_t numCells;
+    std::vector<unsigned char> pixels;
+
+    AtlasSlot* slots;
+    std::atomic<uint64_t>* table;
+    uint32_t tableShift;
+    uint32_t tableMask;
+    std::atomic<uint32_t> frame;
+
+    // the rest is only touched under the lock
+    std::mutex lock;
+    uint32_t numUsedCells;
+    uint32_t numEntries;                // live and deleted table entries
+    std::vector<uint64_t> missing;      // table entries of codepoints that can't be drawn
+    std::vector<SGAtlasRect> dirty;
+};
+
+static uint32_t HashSlot(uint32_t codepoint, uint32_t shift)
+{
+    // fibonacci hashing, the high bits of the product are the best mixed.
+    return (uint32_t)(((uint64_t)codepoint * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+static uint32_t FindSlot(const SGAtlas* atlas, uint32_t codepoint)
+{
+    uint32_t i = HashSlot(codepoint, atlas->tableShift);
+    for (uint32_t probe = 0; probe <= atlas->tableMask; ++probe, i = (i + 1) & atlas->tableMask)
+    {
+        uint64_t entry = atlas->table[i].load(std::memory_order_acquire);
+        if (entry == kEmptyEntry)
+            return kNoSlot;
+        if ((entry >> 32) == (uint64_t)codepoint + 1)
+            return (uint32_t)entry;
+    }
+    return kNoSlot;
+}
+
+// only called under the lock, codepoint must not be in the table already.
+static void InsertEntry(SGAtlas* atlas, uint32_t codepoint, uint32_t slot)
+{
+    uint32_t i = HashSlot(codepoint, atlas->tableShift);
+    for (;;)
+    {
+        uint64_t entry = atlas->table[i].load(std::memory_order_relaxed);
+        if (entry == kEmptyEntry || entry == kDeletedEntry)
+        {
+            if (entry == kEmptyEntry)
+                atlas->numEntries++;
+            atlas->table[i].store(((uint64_t)codepoint + 1) << 32 | slot, std::memory_order_release);
+            return;
+        }
+        i = (i + 1) & atlas->tableMask;
+    }
+}
+
+static void RemoveEntry(SGAtlas* atlas, uint32_t codepoint)
+{
+    uint32_t i = HashSlot(codepoint, atlas->tableShift);
+    for (uint32_t probe = 0; probe <= atlas->tableMask; ++probe, i = (i + 1) & atlas->tableMask)
+    {
+        uint64_t entry = atlas->table[i].load(std::memory_order_relaxed);
+        if (entry == kEmptyEntry)
+            return;
+        if ((entry >> 32) == (uint64_t)codepoint + 1)
+        {
+            atlas->table[i].store(kDeletedEntry, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+// deleted entries only go away when the table is rebuilt.  Readers racing with
+// the rebuild may miss, they then take the slow path and wait for the lock.
+static void RebuildTable(SGAtlas* atlas)
+{
+    for (uint32_t i = 0; i <= atlas->tableMask; ++i)
+        atlas->table[i].store(kEmptyEntry, std::memory_order_relaxed);
+    atlas->numEntries = 0;
+    for (uint32_t slot = 0; slot < atlas->numUsedCells; ++slot)
+        InsertEntry(atlas, atlas->slots[slot].codepoint.load(std::memory_order_relaxed), slot);
+    for (size_t i = 0; i < atlas->missing.size(); ++i)
+        InsertEntry(atlas, (uint32_t)(atlas->missing[i] >> 32) - 1, (uint32_t)atlas->missing[i]);
+}
+
+static bool ReadSlot(SGAtlas* atlas, uint32_t slot, uint32_t codepoint, SGAtlasGlyph* glyph)
+{
+    AtlasSlot& s = atlas->slots[slot];
+    uint32_t before = s.sequence.load(std::memory_order_acquire);
+    if ((before & 1) || s.codepoint.load(std::memory_order_relaxed) != codepoint)
+        return false;
+
+    uint32_t words[kGlyphWords];
+    for (int i = 0; i < kGlyphWords; ++i)
+        words[i] = s.glyph[i].load(std::memory_order_relaxed);
+
+    // mark the glyph used before checking the sequence.  An eviction that has already
+    // started changed the sequence, one that starts later sees the mark and backs off.
+    uint32_t frame = atlas->frame.load(std::memory_order_relaxed);
+    if (s.lastUsed.load(std::memory_order_relaxed) != frame)
+        s.lastUsed.store(frame, std::memory_order_seq_cst);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.sequence.load(std::memory_order_seq_cst) != before)
+        return false;
+
+    memcpy(glyph, words, sizeof(words));
+    return true;
+}
+
+// picks an unused cell, or the least recently used one that wasn't used this
+// frame, and leaves its sequence odd.  Only called under the lock.
+static bool ClaimSlot(SGAtlas* atlas, uint32_t* result)
+{
+    if (atlas->numUsedCells < atlas->numCells)
+    {
+        uint32_t slot = atlas->numUsedCells++;
+        atlas->slots[slot].sequence.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        *result = slot;
+        return true;
+    }
+
+    const uint32_t frame = atlas->frame.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        uint32_t victim = kNoSlot;
+        uint32_t oldest = 0;
+        for (uint32_t slot = 0; slot < atlas->numCells; ++slot)
+        {
+            uint32_t age = frame - atlas->slots[slot].lastUsed.load(std::memory_order_relaxed);
+            if (age > oldest)
+            {
+                oldest = age;
+                victim = slot;
+            }
+        }
+        if (victim == kNoSlot)
+            return false;
+
+        AtlasSlot& s = atlas->slots[victim];
+        uint32_t sequence = s.sequence.load(std::memory_order_relaxed);
+        s.sequence.store(sequence + 1, std::memory_order_seq_cst);
+        if (s.lastUsed.load(std::memory_order_seq_cst) == frame)
+        {
+            // a reader got to it first, it stays
+            s.sequence.store(sequence + 2, std::memory_order_release);
+            continue;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        RemoveEntry(atlas, s.codepoint.load(std::memory_order_relaxed));
+        *result = victim;
+        return true;
+    }
+}
+
+static int AddGlyph(SGAtlas* atlas, uint32_t codepoint, SGAtlasGlyph* glyph)
+{
+    std::lock_guard<std::mutex> guard(atlas->lock);
+
+    // another thread may have added it while we waited
+    uint32_t slot = FindSlot(atlas, codepoint);
+    if (slot == kMissingSlot)
+        return SGATLAS_MISSING;
+    if (slot == kTooLargeSlot)
+        return SGATLAS_TOO_LARGE;
+    if (slot < atlas->numCells && ReadSlot(atlas, slot, codepoint, glyph))
+        return SGATLAS_OK;
+
+    if (atlas->numEntries >= (atlas->tableMask + 1) / 2)
+        RebuildTable(atlas);
+
+    const int pad = atlas->padding;
+    GlyphBitmap bitmap;
+    FT_UInt glyphIndex = FT_Get_Char_Index(atlas->face, codepoint);
+    int result = SGATLAS_OK;
+    if (glyphIndex == 0 || !RASTER_RenderGlyph(atlas->face, glyphIndex, &bitmap))
+        result = SGATLAS_MISSING;
+    else if (bitmap.width > atlas->cellWidth - 2 * pad || bitmap.rows > atlas->cellHeight - 2 * pad)
+        result = SGATLAS_TOO_LARGE;
+    if (result != SGATLAS_OK)
+    {
+        // remember a bounded number of these, so asking again stays lock free.
+        if (atlas->missing.size() < atlas->numCells)
+        {
+            uint32_t marker = result == SGATLAS_MISSING ? kMissingSlot : kTooLargeSlot;
+            atlas->missing.push_back(((uint64_t)codepoint + 1) << 32 | marker);
+            InsertEntry(atlas, codepoint, marker);
+        }
+        return result;
+    }
+
+    if (!ClaimSlot(atlas, &slot))
+        return SGATLAS_FULL;
+
+    // clear the cell and copy the glyph in
+    const int W = atlas->textureWidth;
+    const int cellX = (int)(slot % atlas->cellsPerRow) * atlas->cellWidth;
+    const int cellY = (int)(slot / atlas->cellsPerRow) * atlas->cellHeight;
+    for (int j = 0; j < atlas->cellHeight; ++j)
+        memset(&atlas->pixels[(size_t)(cellY + j) * W + cellX], 0, atlas->cellWidth);
+    for (int j = 0; j < bitmap.rows; ++j)
+        memcpy(&atlas->pixels[(size_t)(cellY + pad + j) * W + cellX + pad], &bitmap.pixels[j * bitmap.width],
+               bitmap.width);
+
+    // same metrics as the offline tool with -vflip
+    const float lineHeight = atlas->lineHeight;
+    const FT_Glyph_Metrics& metrics = bitmap.metrics;
+    SGAtlasGlyph metricsOut;
+    metricsOut.xy_lower_left[0] = (metrics.horiBearingX / 64.0f - pad) / lineHeight;
+    metricsOut.xy_lower_left[1] = ((metrics.horiBearingY - metrics.height) / 64.0f - pad) / lineHeight;
+    metricsOut.xy_upper_right[0] = metricsOut.xy_lower_left[0] + (metrics.width / 64.0f + 2 * pad) / lineHeight;
+    metricsOut.xy_upper_right[1] = metricsOut.xy_lower_left[1] + (metrics.height / 64.0f + 2 * pad) / lineHeight;
+    metricsOut.uv_lower_left[0] = (float)cellX / W;
+    metricsOut.uv_lower_left[1] = (float)(cellY + bitmap.rows + 2 * pad) / W;
+    metricsOut.uv_upper_right[0] = (float)(cellX + bitmap.width + 2 * pad) / W;
+    metricsOut.uv_upper_right[1] = (float)cellY / W;
+    metricsOut.advance[0] = metrics.horiAdvance / 64.0f / lineHeight;
+    metricsOut.advance[1] = 0.0f;
+
+    // publish
+    uint32_t words[kGlyphWords];
+    memcpy(words, &metricsOut, sizeof(words));
+    AtlasSlot& s = atlas->slots[slot];
+    s.codepoint.store(codepoint, std::memory_order_relaxed);
+    for (int i = 0; i < kGlyphWords; ++i)
+        s.glyph[i].store(words[i], std::memory_order_relaxed);
+    s.lastUsed.store(atlas->frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.sequence.store(s.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    InsertEntry(atlas, codepoint, slot);
+
+    // nobody is collecting the rects, so just remember that everything changed.
+    if (atlas->dirty.size() >= atlas->numCells)
+    {
+        SGAtlasRect all = { 0, 0, W, W };
+        atlas->dirty.assign(1, all);
+    }
+    SGAtlasRect rect = { cellX, cellY, atlas->cellWidth, atlas->cellHeight };
+    atlas->dirty.push_back(rect);
+
+    *glyph = metricsOut;
+    return SGATLAS_OK;
+}
+
+extern "C" struct SGAtlas* sgatlas_create(const char* font_filename, int pixels, int texture_width, int padding)
+{
+    if (pixels <= 0 || texture_width <= 0 || padding < 0)
+        return NULL;
+
+    SGAtlas* atlas = new SGAtlas;
+    atlas->library = 0;
+    atlas->face = 0;
+    atlas->slots = NULL;
+    atlas->table = NULL;
+    if (!MAP_Open(font_filename, &atlas->file))
+    {
+        delete atlas;
+        return NULL;
+    }
+    if (RASTER_OpenFace(atlas->file.data, atlas->file.size, pixels, &atlas->library, &atlas->face))
+    {
+        sgatlas_free(atlas);
+        return NULL;
+    }
+
+    // square cells spanning ascender to descender, plus a pixel on each side for
+    // antialiasing.  That fits every glyph of most fonts, fixed size cells make
+    // eviction trivial.  The font bounding box would be safer but is often
+    // several ems wide.
+    FT_Face face = atlas->face;
+    int glyphSize = (int)(((face->size->metrics.ascender + 63) >> 6) - (face->size->metrics.descender >> 6)) + 2;
+
+    atlas->lineHeight = face->size->metrics.height / 64.0f;
+    atlas->textureWidth = texture_width;
+    atlas->padding = padding;
+    atlas->cellWidth = glyphSize + 2 * padding;
+    atlas->cellHeight = glyphSize + 2 * padding;
+    if (atlas->cellWidth > texture_width || atlas->cellHeight > texture_width)
+    {
+        sgatlas_free(atlas);
+        return NULL;
+    }
+    atlas->cellsPerRow = texture_width / atlas->cellWidth;
+    atlas->numCells = (uint32_t)(atlas->cellsPerRow * (texture_width / atlas->cellHeight));
+    atlas->pixels.assign((size_t)texture_width * texture_width, 0);
+
+    atlas->slots = new AtlasSlot[atlas->numCells];
+    for (uint32_t i = 0; i < atlas->numCells; ++i)
+    {
+        atlas->slots[i].sequence.store(0);
+        atlas->slots[i].lastUsed.store(0);
+        atlas->slots[i].codepoint.store(0);
+        for (int k = 0; k < kGlyphWords; ++k)
+            atlas->slots[i].glyph[k].store(0);
+    }
+
+    // room for every cell and as many missing codepoints, at most a quarter full
+    // after a rebuild.
+    uint32_t bits = 4;
+    while ((1u << bits) < atlas->numCells * 8)
+        bits++;
+    atlas->tableShift = 64 - bits;
+    atlas->tableMask = (1u << bits) - 1;
+    atlas->table = new std::atomic<uint64_t>[atlas->tableMask + 1];
+    for (uint32_t i = 0; i <= atlas->tableMask; ++i)
+        atlas->table[i].store(kEmptyEntry);
+
+    // frame 0 is what unused slots hold, so counting starts at 1
+    atlas->frame.store(1);
+    atlas->numUsedCells = 0;
+    atlas->numEntries = 0;
+    return atlas;
+}
+
+extern "C" void sgatlas_free(struct SGAtlas* atlas)
+{
+    if (atlas == NULL)
+        return;
+    RASTER_CloseFace(atlas->library, atlas->face);
+    MAP_Close(&atlas->file);
+    delete [] atlas->slots;
+    delete [] atlas->table;
+    delete atlas;
+}
+
+extern "C" void sgatlas_begin_frame(struct SGAtlas* atlas)
+{
+    uint32_t frame = atlas->frame.load() + 1;
+    atlas->frame.store(frame != 0 ? frame : 1);
+}
+
+extern "C" int sgatlas_glyph(struct SGAtlas* atlas, uint32_t codepoint, struct SGAtlasGlyph* glyph)
+{
+    // keeps (codepoint + 1) << 32 from wrapping
+    if (codepoint > kMaxCodepoint)
+        return SGATLAS_INVALID;
+    uint32_t slot = FindSlot(atlas, codepoint);
+    if (slot == kMissingSlot)
+        return SGATLAS_MISSING;
+    if (slot == kTooLargeSlot)
+        return SGATLAS_TOO_LARGE;
+    if (slot < atlas->numCells && ReadSlot(atlas, slot, codepoint, glyph))
+        return SGATLAS_OK;
+    return AddGlyph(atlas, codepoint, glyph);
+}
+
+extern "C" size_t sgatlas_dirty_rects(struct SGAtlas* atlas, struct SGAtlasRect* rects, size_t max_rects)
+{
+    std::lock_guard<std::mutex> guard(atlas->lock);
+    size_t count = atlas->dirty.size();
+    if (count == 0 || max_rects == 0)
+        return 0;
+
+    if (count <= max_rects)
+    {
+        memcpy(rects, &atlas->dirty[0], count * sizeof(SGAtlasRect));
+    }
+    else
+    {
+        int x0 = atlas->textureWidth, y0 = atlas->textureWidth, x1 = 0, y1 = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const SGAtlasRect& r = atlas->dirty[i];
+            x0 = r.x < x0 ? r.x : x0;
+            y0 = r.y < y0 ? r.y : y0;
+            x1 = r.x + r.width > x1 ? r.x + r.width : x1;
+            y1 = r.y + r.height > y1 ? r.y + r.height : y1;
+        }
+        SGAtlasRect bounds = { x0, y0, x1 - x0, y1 - y0 };
+        rects[0] = bounds;
+        count = 1;
+    }
+    atlas->dirty.clear();
+    return count;
+}
+
+extern "C" const unsigned char* sgatlas_pixels(const struct SGAtlas* atlas)
+{
+    return &atlas->pixels[0];
+}
+
+extern "C" int sgatlas_texture_width(const struct SGAtlas* atlas)
+{
+    return atlas->textureWidth;
+}
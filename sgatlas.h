@@ -0,0 +1,71 @@
+// Dynamic glyph atlas, glyphs are rendered the first time they are asked for.
+
+#ifndef SGATLAS_H
+#define SGATLAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// sgatlas_glyph results
+#define SGATLAS_OK 0
+#define SGATLAS_MISSING 1   // the font has no glyph for the codepoint
+#define SGATLAS_FULL 2      // every cell holds a glyph used since sgatlas_begin_frame
+#define SGATLAS_TOO_LARGE 3 // the glyph is bigger than a cell
+#define SGATLAS_INVALID 4   // the codepoint is above 0x10FFFF
+
+struct SGAtlas;
+
+// same units and uv layout as FontBinGlyph, in units of line height.
+// uvs address the pixel buffer uploaded as is, with row 0 at v = 0.
+struct SGAtlasGlyph
+{
+    float xy_lower_left[2];
+    float xy_upper_right[2];
+    float uv_lower_left[2];
+    float uv_upper_right[2];
+    float advance[2];
+};
+
+// a region of the pixel buffer that changed, in texels from the first row.
+struct SGAtlasRect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// maps the font and creates an empty texture_width x texture_width atlas of 8 bit
+// coverage.  The atlas is split into equal square cells as tall as the font's
+// ascender to descender at the given pixel size, plus padding.  Returns NULL on failure.
+struct SGAtlas* sgatlas_create(const char* font_filename, int pixels, int texture_width, int padding);
+
+void sgatlas_free(struct SGAtlas* atlas);
+
+// starts a new frame.  Glyphs used during the current frame are never evicted,
+// so their uvs stay valid until the next sgatlas_begin_frame.
+void sgatlas_begin_frame(struct SGAtlas* atlas);
+
+// fills in the metrics of codepoint, rendering it into the least recently used
+// cell if it isn't in the atlas yet.  Safe to call from any number of threads;
+// glyphs already in the atlas are found without taking a lock.
+int sgatlas_glyph(struct SGAtlas* atlas, uint32_t codepoint, struct SGAtlasGlyph* glyph);
+
+// copies out and clears the regions changed since the last call.  If there are more
+// than max_rects, a single rect covering all of them is returned instead.
+// Call it, and upload sgatlas_pixels, while no other thread is in sgatlas_glyph.
+size_t sgatlas_dirty_rects(struct SGAtlas* atlas, struct SGAtlasRect* rects, size_t max_rects);
+
+const unsigned char* sgatlas_pixels(const struct SGAtlas* atlas);
+
+int sgatlas_texture_width(const struct SGAtlas* atlas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
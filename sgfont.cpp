@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "sgfont.h"
+#include "mapfile.h"
+
+// codepoints are looked up through a two level table: the top 13 bits pick a page
+// of 256 glyph positions.  Pages with no glyphs all share page 0, which is empty.
+static const uint32_t kNumCodepoints = 0x110000;
+static const uint32_t kPageBits = 8;
+static const uint32_t kPageSize = 1 << kPageBits;
+static const uint32_t kNumPages = kNumCodepoints >> kPageBits;
+
+static const uint64_t kEmptyKey = ~0ull;
+
+struct KerningEntry
+{
+    uint64_t key;       // first << 32 | second
+    float x;
+    float y;
+};
+
+struct SGFont
+{
+    MappedFile file;
+    const void* data;
+    const FontBinHeader* header;
+    const FontBinGlyph* glyphs;
+
+    std::vector<uint16_t> pageIndex;
+    std::vector<uint32_t> pages;
+
+    // open addressing with linear probing, at most half full.
+    std::vector<KerningEntry> kerning;
+    uint32_t kerningShift;
+};
+
+static uint32_t HashSlot(uint64_t key, uint32_t shift)
+{
+    // fibonacci hashing, the high bits of the product are the best mixed.
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+static bool BuildCodepointTable(SGFont* font)
+{
+    font->pageIndex.assign(kNumPages, 0);
+    font->pages.assign(kPageSize, SGFONT_NO_GLYPH);
+
+    for (uint32_t i = 0; i < font->header->num_glyphs; ++i)
+    {
+        uint32_t codepoint = font->glyphs[i].codepoint;
+        if (codepoint >= kNumCodepoints)
+            return false;
+        uint32_t page = codepoint >> kPageBits;
+        if (font->pageIndex[page] == 0)
+        {
+            if (font->pages.size() / kPageSize > 0xffff)
+                return false;
+            font->pageIndex[page] = (uint16_t)(font->pages.size() / kPageSize);
+            font->pages.resize(font->pages.size() + kPageSize, SGFONT_NO_GLYPH);
+        }
+        font->pages[font->pageIndex[page] * kPageSize + (codepoint & (kPageSize - 1))] = i;
+    }
+    return true;
+}
+
+static void BuildKerningTable(SGFont* font)
+{
+    uint32_t numPairs = font->header->num_kerning;
+    uint32_t bits = 1;
+    while ((1u << bits) < numPairs * 2)
+        bits++;
+    font->kerningShift = 64 - bits;
+
+    KerningEntry empty = { kEmptyKey, 0.0f, 0.0f };
+    font->kerning.assign((size_t)1 << bits, empty);
+
+    const FontBinKerning* pairs = fontbin_kerning(font->data);
+    const uint32_t mask = (1u << bits) - 1;
+    for (uint32_t i = 0; i < numPairs; ++i)
+    {
+        uint64_t key = ((uint64_t)pairs[i].first << 32) | pairs[i].second;
+        uint32_t slot = HashSlot(key, font->kerningShift);
+        while (font->kerning[slot].key != kEmptyKey && font->kerning[slot].key != key)
+            slot = (slot + 1) & mask;
+        font->kerning[slot].key = key;
+        font->kerning[slot].x = pairs[i].kerning[0];
+        font->kerning[slot].y = pairs[i].kerning[1];
+    }
+}
+
+static SGFont* CreateFont(const void* data, size_t size)
+{
+    if (!fontbin_validate(data, size))
+        return NULL;
+
+    SGFont* font = new SGFont;
+    memset(&font->file, 0, sizeof(font->file));
+    font->data = data;
+    font->header = fontbin_header(data);
+    font->glyphs = fontbin_glyphs(data);
+    if (!BuildCodepointTable(font))
+    {
+        delete font;
+        return NULL;
+    }
+    BuildKerningTable(font);
+    return font;
+}
+
+extern "C" struct SGFont* sgfont_load(const char* filename)
+{
+    MappedFile file;
+    if (!MAP_Open(filename, &file))
+        return NULL;
+
+    SGFont* font = CreateFont(file.data, file.size);
+    if (font == NULL)
+    {
+        MAP_Close(&file);
+        return NULL;
+    }
+    font->file = file;
+    return font;
+}
+
+extern "C" struct SGFont* sgfont_load_memory(const void* data, size_t size)
+{
+    return CreateFont(data, size);
+}
+
+extern "C" void sgfont_free(struct SGFont* font)
+{
+    if (font == NULL)
+        return;
+    if (font->file.data)
+        MAP_Close(&font->file);
+    delete font;
+}
+
+extern "C" const struct FontBinHeader* sgfont_header(const struct SGFont* font)
+{
+    return font->header;
+}
+
+extern "C" uint32_t sgfont_glyph_index(const struct SGFont* font, uint32_t codepoint)
+{
+    if (codepoint >= kNumCodepoints)
+        return SGFONT_NO_GLYPH;
+    return font->pages[font->pageIndex[codepoint >> kPageBits] * kPageSize + (codepoint & (kPageSize - 1))];
+}
+
+extern "C" const struct FontBinGlyph* sgfont_glyph(const struct SGFont* font, uint32_t glyph_index)
+{
+    return (glyph_index < font->header->num_glyphs) ? font->glyphs + glyph_index : NULL;
+}
+
+extern "C" void sgfont_kerning(const struct SGFont* font, uint32_t first, uint32_t second,
+                               float* kerning_x, float* kerning_y)
+{
+    const uint64_t key = ((uint64_t)first << 32) | second;
+    const uint32_t mask = (uint32_t)font->kerning.size() - 1;
+    uint32_t slot = HashSlot(key, font->kerningShift);
+    for (;;)
+    {
+        const KerningEntry& entry = font->kerning[slot];
+        if (entry.key == key)
+        {
+            *kerning_x = entry.x;
+            *kerning_y = entry.y;
+            return;
+        }
+        if (entry.key == kEmptyKey)
+        {
+            *kerning_x = 0.0f;
+            *kerning_y = 0.0f;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
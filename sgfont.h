@@ -0,0 +1,77 @@
+// Runtime font library for swiftglyph -bin output.
+
+#ifndef SGFONT_H
+#define SGFONT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fontbin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SGFONT_NO_GLYPH 0xffffffffu
+
+struct SGFont;
+
+// maps a .bin metrics file and builds the lookup tables, returns NULL on failure.
+struct SGFont* sgfont_load(const char* filename);
+
+// same as sgfont_load but uses data in place, which must outlive the font.
+struct SGFont* sgfont_load_memory(const void* data, size_t size);
+
+void sgfont_free(struct SGFont* font);
+
+const struct FontBinHeader* sgfont_header(const struct SGFont* font);
+
+// returns the position of codepoint in the glyph array, or SGFONT_NO_GLYPH.
+// Two table lookups, independent of the number of glyphs.
+uint32_t sgfont_glyph_index(const struct SGFont* font, uint32_t codepoint);
+
+const struct FontBinGlyph* sgfont_glyph(const struct SGFont* font, uint32_t glyph_index);
+
+// kerning to add to the pen between two glyph array positions, zero if the pair
+// isn't kerned.  One hash probe in the common case.
+void sgfont_kerning(const struct SGFont* font, uint32_t first, uint32_t second,
+                    float* kerning_x, float* kerning_y);
+
+//
+// batched layout
+//
+
+// one label to lay out.  Metrics are in units of line height, scale converts them
+// to the caller's units and the pen starts at (pen_x, pen_y) on the baseline.
+struct SGTextString
+{
+    const char* text;       // utf-8
+    size_t length;          // in bytes
+    float pen_x;
+    float pen_y;
+    float scale;
+};
+
+// interleaved vertex, 4 per quad in lower left, lower right, upper right, upper left order.
+struct SGTextVertex
+{
+    float x, y;
+    float u, v;
+};
+
+// number of quads the strings need.  Spaces, tabs and newlines only move the pen.
+size_t sgfont_count_quads(const struct SGFont* font, const struct SGTextString* strings, size_t num_strings);
+
+// lays out every string into the caller's buffers: 4 vertices and, if indices isn't
+// NULL, 6 triangle indices per quad starting at base_vertex.  Strings are split
+// across num_threads threads (0 is one per core), the output is the same for any
+// count.  Returns the number of quads written, or 0 if more than max_quads are needed.
+// Codepoints missing from the font are drawn as '?'.
+size_t sgfont_build_quads(const struct SGFont* font, const struct SGTextString* strings, size_t num_strings,
+                          struct SGTextVertex* vertices, uint32_t* indices, uint32_t base_vertex,
+                          size_t max_quads, int num_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,306 @@
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "sglayout.h"
+
+// layouts live back to back in one arena of vertices, each one its quads laid out
+// with the pen at the origin followed by a copy of its text rounded up to whole
+// vertices.  The pen is added while copying out, so a label that moves still hits.  New layouts go on the end, and
+// when the end is reached the least recently used are evicted and the rest moved
+// down, so the arena never fragments.  Entries are found through an open addressing
+// table of entry numbers that is rebuilt whenever entries move.
+static const uint32_t kNoEntry = 0xffffffffu;
+static const uint32_t kMinTableBits = 8;
+
+struct LayoutEntry
+{
+    uint64_t hash;
+    const SGFont* font;
+    float scale;
+    uint32_t length;        // of the text, in bytes
+    uint32_t numQuads;
+    size_t offset;          // into the arena, in vertices
+    size_t size;            // quads and text, in vertices
+    uint64_t lastFrame;
+};
+
+struct SGLayoutCache
+{
+    std::vector<SGTextVertex> arena;
+    size_t top;             // end of the last layout, the arena is always packed
+
+    std::vector<LayoutEntry> entries;   // in arena order
+    size_t entriesThisFrame;            // of entries, the ones used this frame
+
+    // linear probing, at most half full.
+    std::vector<uint32_t> table;
+    uint32_t tableShift;
+
+    uint64_t frame;
+    SGLayoutStats stats;
+};
+
+static uint64_t HashBits(uint64_t hash, uint64_t bits)
+{
+    return (hash ^ bits) * 0x100000001b3ull;
+}
+
+static uint32_t FloatBits(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+// 64 bit FNV-1a of the text, then the font and scale
+static uint64_t HashString(const SGFont* font, const SGTextString& str)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const unsigned char* text = (const unsigned char*)str.text;
+    for (size_t i = 0; i < str.length; ++i)
+        hash = HashBits(hash, text[i]);
+    hash = HashBits(hash, (uint64_t)(uintptr_t)font);
+    hash = HashBits(hash, FloatBits(str.scale));
+    return hash;
+}
+
+static uint32_t HashSlot(uint64_t hash, uint32_t shift)
+{
+    // fibonacci hashing, the high bits of the product are the best mixed.
+    return (uint32_t)((hash * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+static size_t TextVertices(size_t length)
+{
+    return (length + sizeof(SGTextVertex) - 1) / sizeof(SGTextVertex);
+}
+
+static bool SameString(const SGLayoutCache* cache, const LayoutEntry& entry, uint64_t hash,
+                       const SGFont* font, const SGTextString& str)
+{
+    return entry.hash == hash && entry.font == font && entry.length == str.length && entry.scale == str.scale &&
+           memcmp(cache->arena.data() + entry.offset + entry.numQuads * 4, str.text, str.length) == 0;
+}
+
+static uint32_t FindEntry(const SGLayoutCache* cache, uint64_t hash, const SGFont* font, const SGTextString& str)
+{
+    const uint32_t mask = (uint32_t)cache->table.size() - 1;
+    for (uint32_t slot = HashSlot(hash, cache->tableShift); ; slot = (slot + 1) & mask)
+    {
+        uint32_t e = cache->table[slot];
+        if (e == kNoEntry || SameString(cache, cache->entries[e], hash, font, str))
+            return e;
+    }
+}
+
+static void RebuildTable(SGLayoutCache* cache)
+{
+    uint32_t bits = kMinTableBits;
+    while (((size_t)1 << bits) < cache->entries.size() * 2 + 2)
+        bits++;
+    cache->tableShift = 64 - bits;
+    cache->table.assign((size_t)1 << bits, kNoEntry);
+
+    const uint32_t mask = (1u << bits) - 1;
+    for (size_t e = 0; e < cache->entries.size(); ++e)
+    {
+        uint32_t slot = HashSlot(cache->entries[e].hash, cache->tableShift);
+        while (cache->table[slot] != kNoEntry)
+            slot = (slot + 1) & mask;
+        cache->table[slot] = (uint32_t)e;
+    }
+}
+
+// evicts layouts not used this frame, oldest first, until size more vertices fit
+// with a quarter of the arena to spare, then moves the survivors down.  Nothing
+// moves unless something was evicted, since the arena is always packed.
+static bool MakeRoom(SGLayoutCache* cache, size_t size)
+{
+    const size_t capacity = cache->arena.size();
+    if (size > capacity)
+        return false;
+    if (cache->top + size <= capacity)
+        return true;
+    if (cache->entriesThisFrame == cache->entries.size())
+        return false;
+
+    std::vector<uint32_t> byAge;
+    for (size_t e = 0; e < cache->entries.size(); ++e)
+    {
+        if (cache->entries[e].lastFrame != cache->frame)
+            byAge.push_back((uint32_t)e);
+    }
+    std::stable_sort(byAge.begin(), byAge.end(), [&](uint32_t a, uint32_t b) {
+        return cache->entries[a].lastFrame < cache->entries[b].lastFrame;
+    });
+    const size_t target = capacity - capacity / 4;
+    size_t used = cache->top;
+    std::vector<char> evict(cache->entries.size(), 0);
+    for (size_t i = 0; i < byAge.size() && used + size > target; ++i)
+    {
+        evict[byAge[i]] = 1;
+        used -= cache->entries[byAge[i]].size;
+        cache->stats.evictions++;
+    }
+
+    size_t top = 0;
+    size_t kept = 0;
+    for (size_t e = 0; e < cache->entries.size(); ++e)
+    {
+        if (evict[e])
+            continue;
+        LayoutEntry entry = cache->entries[e];
+        if (entry.offset != top)
+            memmove(cache->arena.data() + top, cache->arena.data() + entry.offset, entry.size * sizeof(SGTextVertex));
+        entry.offset = top;
+        top += entry.size;
+        cache->entries[kept++] = entry;
+    }
+    cache->entries.resize(kept);
+    cache->top = top;
+    RebuildTable(cache);
+    return top + size <= capacity;
+}
+
+// copies layouts stored at the origin out to the pen, out may be in.
+static void MoveQuads(SGTextVertex* out, const SGTextVertex* in, size_t numQuads, float pen_x, float pen_y)
+{
+    for (size_t i = 0; i < numQuads * 4; ++i)
+    {
+        out[i].x = in[i].x + pen_x;
+        out[i].y = in[i].y + pen_y;
+        out[i].u = in[i].u;
+        out[i].v = in[i].v;
+    }
+}
+
+static void WriteIndices(uint32_t* indices, uint32_t firstVertex, size_t numQuads)
+{
+    for (size_t q = 0; q < numQuads; ++q)
+    {
+        uint32_t base = firstVertex + (uint32_t)(q * 4);
+        uint32_t* tri = indices + q * 6;
+        tri[0] = base; tri[1] = base + 1; tri[2] = base + 2;
+        tri[3] = base; tri[4] = base + 2; tri[5] = base + 3;
+    }
+}
+
+extern "C" struct SGLayoutCache* sglayout_create(size_t arena_bytes)
+{
+    SGLayoutCache* cache = new SGLayoutCache;
+    cache->arena.resize(arena_bytes / sizeof(SGTextVertex));
+    cache->frame = 1;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    sglayout_clear(cache);
+    return cache;
+}
+
+extern "C" void sglayout_free(struct SGLayoutCache* cache)
+{
+    delete cache;
+}
+
+extern "C" void sglayout_begin_frame(struct SGLayoutCache* cache)
+{
+    cache->frame++;
+    cache->entriesThisFrame = 0;
+}
+
+extern "C" void sglayout_clear(struct SGLayoutCache* cache)
+{
+    cache->entries.clear();
+    cache->entriesThisFrame = 0;
+    cache->top = 0;
+    RebuildTable(cache);
+}
+
+extern "C" size_t sglayout_build_quads(struct SGLayoutCache* cache, const struct SGFont* font,
+                                       const struct SGTextString* strings, size_t num_strings,
+                                       struct SGTextVertex* vertices, uint32_t* indices, uint32_t base_vertex,
+                                       size_t max_quads)
+{
+    size_t quad = 0;
+    for (size_t i = 0; i < num_strings; ++i)
+    {
+        const SGTextString& str = strings[i];
+        if (str.length == 0)
+            continue;
+        const uint64_t hash = HashString(font, str);
+        uint32_t e = FindEntry(cache, hash, font, str);
+        if (e != kNoEntry)
+        {
+            LayoutEntry& entry = cache->entries[e];
+            if (entry.numQuads > max_quads - quad)
+                return 0;
+            MoveQuads(vertices + quad * 4, cache->arena.data() + entry.offset, entry.numQuads, str.pen_x, str.pen_y);
+            if (indices)
+                WriteIndices(indices + quad * 6, base_vertex + (uint32_t)(quad * 4), entry.numQuads);
+            if (entry.lastFrame != cache->frame)
+            {
+                entry.lastFrame = cache->frame;
+                cache->entriesThisFrame++;
+            }
+            quad += entry.numQuads;
+            cache->stats.hits++;
+            continue;
+        }
+
+        SGTextString origin = str;
+        origin.pen_x = 0.0f;
+        origin.pen_y = 0.0f;
+        const size_t numQuads = sgfont_count_quads(font, &origin, 1);
+        if (numQuads > max_quads - quad)
+            return 0;
+        sgfont_build_quads(font, &origin, 1, vertices + quad * 4, indices ? indices + quad * 6 : NULL,
+                           base_vertex + (uint32_t)(quad * 4), numQuads, 1);
+        cache->stats.misses++;
+
+        const size_t size = numQuads * 4 + TextVertices(str.length);
+        if (MakeRoom(cache, size))
+        {
+            LayoutEntry entry;
+            entry.hash = hash;
+            entry.font = font;
+            entry.scale = str.scale;
+            entry.length = (uint32_t)str.length;
+            entry.numQuads = (uint32_t)numQuads;
+            entry.offset = cache->top;
+            entry.size = size;
+            entry.lastFrame = cache->frame;
+            SGTextVertex* stored = cache->arena.data() + entry.offset;
+            memcpy(stored, vertices + quad * 4, numQuads * 4 * sizeof(SGTextVertex));
+            memcpy(stored + numQuads * 4, str.text, str.length);
+            cache->top += size;
+            cache->entries.push_back(entry);
+            cache->entriesThisFrame++;
+            if (cache->entries.size() * 2 + 2 > cache->table.size())
+            {
+                RebuildTable(cache);
+            }
+            else
+            {
+                const uint32_t mask = (uint32_t)cache->table.size() - 1;
+                uint32_t slot = HashSlot(hash, cache->tableShift);
+                while (cache->table[slot] != kNoEntry)
+                    slot = (slot + 1) & mask;
+                cache->table[slot] = (uint32_t)(cache->entries.size() - 1);
+            }
+        }
+        else
+        {
+            cache->stats.uncached++;
+        }
+        MoveQuads(vertices + quad * 4, vertices + quad * 4, numQuads, str.pen_x, str.pen_y);
+        quad += numQuads;
+    }
+    return quad;
+}
+
+extern "C" void sglayout_stats(const struct SGLayoutCache* cache, struct SGLayoutStats* stats)
+{
+    *stats = cache->stats;
+    stats->entries = cache->entries.size();
+    stats->bytes_used = cache->top * sizeof(SGTextVertex);
+    stats->arena_bytes = cache->arena.size() * sizeof(SGTextVertex);
+}
@@ -0,0 +1,57 @@
+// Layout cache for labels drawn with the runtime library every frame.
+
+#ifndef SGLAYOUT_H
+#define SGLAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sgfont.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct SGLayoutCache;
+
+// running totals since sglayout_create.  The hit rate is hits / (hits + misses).
+struct SGLayoutStats
+{
+    uint64_t hits;          // strings copied from the cache
+    uint64_t misses;        // strings laid out by sgfont_build_quads
+    uint64_t uncached;      // misses that didn't fit the arena, even after evicting
+    uint64_t evictions;     // layouts dropped to make room
+    size_t entries;         // layouts held now
+    size_t bytes_used;      // of the arena, by the layouts held now
+    size_t arena_bytes;
+};
+
+// creates an empty cache whose vertices and texts live in one arena of arena_bytes.
+struct SGLayoutCache* sglayout_create(size_t arena_bytes);
+
+void sglayout_free(struct SGLayoutCache* cache);
+
+// starts a new frame.  Layouts used during the current frame are never evicted,
+// once the arena is full the ones unused for the most frames go first.
+void sglayout_begin_frame(struct SGLayoutCache* cache);
+
+// drops every layout, call it before freeing a font the cache has seen.
+void sglayout_clear(struct SGLayoutCache* cache);
+
+// same output as sgfont_build_quads with one thread, to float rounding.  Each string
+// is looked up by font, text and scale: a hit is a hash probe and a copy of its
+// vertices moved to the pen, a miss is laid out at the origin and kept for later
+// frames, so labels that scroll or move still hit.  Returns the number of quads written,
+// or 0 if more than max_quads are needed, in which case the buffers may be partly
+// written.  Not thread safe, use one cache per thread.
+size_t sglayout_build_quads(struct SGLayoutCache* cache, const struct SGFont* font,
+                            const struct SGTextString* strings, size_t num_strings,
+                            struct SGTextVertex* vertices, uint32_t* indices, uint32_t base_vertex,
+                            size_t max_quads);
+
+void sglayout_stats(const struct SGLayoutCache* cache, struct SGLayoutStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,230 @@
+#include <vector>
+
+#include "sgfont.h"
+#include "jobs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SGTEXT_SSE2 1
+#endif
+
+static const int kTabSize = 4;
+
+// decode the utf-8 sequence at *p and advance past it, malformed bytes become '?'
+static uint32_t NextCodepoint(const unsigned char** p, const unsigned char* end)
+{
+    const unsigned char* s = *p;
+    uint32_t c = s[0];
+    int length = 1;
+    if (c >= 0xf0 && end - s >= 4 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80 && (s[3] & 0xc0) == 0x80)
+    {
+        c = ((c & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) | (s[3] & 0x3f);
+        length = 4;
+    }
+    else if (c >= 0xe0 && end - s >= 3 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80)
+    {
+        c = ((c & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+        length = 3;
+    }
+    else if (c >= 0xc0 && end - s >= 2 && (s[1] & 0xc0) == 0x80)
+    {
+        c = ((c & 0x1f) << 6) | (s[1] & 0x3f);
+        length = 2;
+    }
+    else if (c >= 0x80)
+    {
+        c = '?';
+    }
+    *p = s + length;
+    return c;
+}
+
+static bool IsBlank(uint32_t c)
+{
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+static size_t CountQuads(const SGTextString& str)
+{
+    const unsigned char* p = (const unsigned char*)str.text;
+    const unsigned char* end = p + str.length;
+    size_t count = 0;
+    while (p < end)
+    {
+        if (!IsBlank(NextCodepoint(&p, end)))
+            count++;
+    }
+    return count;
+}
+
+static uint32_t FindGlyph(const SGFont* font, uint32_t codepoint)
+{
+    uint32_t index = sgfont_glyph_index(font, codepoint);
+    if (index == SGFONT_NO_GLYPH)
+        index = sgfont_glyph_index(font, '?');
+    return index;
+}
+
+// writes the 4 vertices of one glyph, the corners of the glyph are offset by the pen.
+static void EmitQuad(const FontBinGlyph* glyph, float pen_x, float pen_y, float scale, SGTextVertex* out)
+{
+#ifdef SGTEXT_SSE2
+    // xy_lower_left, xy_upper_right and uv_lower_left, uv_upper_right are adjacent,
+    // so each is one unaligned load: xy = [x0 y0 x1 y1], uv = [u0 v0 u1 v1].
+    __m128 xy = _mm_loadu_ps(glyph->xy_lower_left);
+    __m128 uv = _mm_loadu_ps(glyph->uv_lower_left);
+    xy = _mm_add_ps(_mm_mul_ps(xy, _mm_set1_ps(scale)), _mm_setr_ps(pen_x, pen_y, pen_x, pen_y));
+
+    float* v = &out[0].x;
+    if (glyph->flags & FONTBIN_GLYPH_ROTATED)
+    {
+        _mm_storeu_ps(v + 0, _mm_shuffle_ps(xy, uv, _MM_SHUFFLE(3, 0, 1, 0)));
+        _mm_storeu_ps(v + 4, _mm_shuffle_ps(xy, uv, _MM_SHUFFLE(1, 0, 1, 2)));
+        _mm_storeu_ps(v + 8, _mm_shuffle_ps(xy, uv, _MM_SHUFFLE(1, 2, 3, 2)));
+        _mm_storeu_ps(v + 12, _mm_shuffle_ps(xy, uv, _MM_SHUFFLE(3, 2, 3, 0)));
+    }
+    else
+    {
+        _mm_storeu_ps(v + 0, _mm_movelh_ps(xy, uv));
+        _mm_storeu_ps(v + 4, _mm_shuffle_ps(xy, uv, _MM_SHUFFLE(1, 2, 1, 2)));
+        _mm_storeu_ps(v + 8, _mm_movehl_ps(uv, xy));
+        _mm_storeu_ps(v + 12, _mm_shuffle_ps(xy, uv, _MM_SHUFFLE(3, 0, 3, 0)));
+    }
+#else
+    float x0 = pen_x + glyph->xy_lower_left[0] * scale;
+    float y0 = pen_y + glyph->xy_lower_left[1] * scale;
+    float x1 = pen_x + glyph->xy_upper_right[0] * scale;
+    float y1 = pen_y + glyph->xy_upper_right[1] * scale;
+    float u0 = glyph->uv_lower_left[0], v0 = glyph->uv_lower_left[1];
+    float u1 = glyph->uv_upper_right[0], v1 = glyph->uv_upper_right[1];
+    SGTextVertex quad[4] = { { x0, y0, u0, v0 }, { x1, y0, u1, v0 }, { x1, y1, u1, v1 }, { x0, y1, u0, v1 } };
+    if (glyph->flags & FONTBIN_GLYPH_ROTATED)
+    {
+        quad[0].u = u0; quad[0].v = v1;
+        quad[1].u = u0; quad[1].v = v0;
+        quad[2].u = u1; quad[2].v = v0;
+        quad[3].u = u1; quad[3].v = v1;
+    }
+    for (int i = 0; i < 4; ++i)
+        out[i] = quad[i];
+#endif
+}
+
+// lays out one string, the same walk as DrawString in test/test.c.
+static void LayoutString(const SGFont* font, const SGTextString& str, SGTextVertex* vertices,
+                         uint32_t* indices, uint32_t firstVertex)
+{
+    const unsigned char* p = (const unsigned char*)str.text;
+    const unsigned char* end = p + str.length;
+    float pen_x = str.pen_x;
+    float pen_y = str.pen_y;
+    int cursor = 0;
+    uint32_t quad = 0;
+
+    // walked by length like CountQuads, an embedded nul is drawn like any other
+    // codepoint the font doesn't have.
+    bool hasCurr = p < end;
+    uint32_t c = hasCurr ? NextCodepoint(&p, end) : 0;
+    uint32_t curr = hasCurr ? FindGlyph(font, c) : SGFONT_NO_GLYPH;
+    while (hasCurr)
+    {
+        bool hasNext = p < end;
+        uint32_t nextCodepoint = hasNext ? NextCodepoint(&p, end) : 0;
+        uint32_t next = hasNext ? FindGlyph(font, nextCodepoint) : SGFONT_NO_GLYPH;
+
+        if (c == '\n')
+        {
+            // move the pen down by height, and reset x to the start
+            pen_x = str.pen_x;
+            pen_y -= str.scale;
+            cursor = 0;
+        }
+        else if (c == '\t')
+        {
+            const FontBinGlyph* space = sgfont_glyph(font, FindGlyph(font, ' '));
+            int numSpaces = kTabSize - (cursor % kTabSize);
+            if (space)
+                pen_x += numSpaces * space->advance[0] * str.scale;
+            cursor += numSpaces;
+        }
+        else
+        {
+            const FontBinGlyph* glyph = sgfont_glyph(font, curr);
+            if (c != ' ')
+            {
+                // the quad count was fixed up front, so a font without even a '?'
+                // still gets a degenerate quad.
+                SGTextVertex* out = vertices + quad * 4;
+                if (glyph)
+                {
+                    EmitQuad(glyph, pen_x, pen_y, str.scale, out);
+                }
+                else
+                {
+                    SGTextVertex empty = { pen_x, pen_y, 0.0f, 0.0f };
+                    out[0] = out[1] = out[2] = out[3] = empty;
+                }
+
+                if (indices)
+                {
+                    uint32_t base = firstVertex + quad * 4;
+                    uint32_t* tri = indices + quad * 6;
+                    tri[0] = base; tri[1] = base + 1; tri[2] = base + 2;
+                    tri[3] = base; tri[4] = base + 2; tri[5] = base + 3;
+                }
+                quad++;
+            }
+
+            if (glyph)
+            {
+                float kerning_x = 0.0f;
+                float kerning_y = 0.0f;
+                if (next != SGFONT_NO_GLYPH && !IsBlank(nextCodepoint))
+                    sgfont_kerning(font, curr, next, &kerning_x, &kerning_y);
+
+                // advance the pen
+                pen_x += (glyph->advance[0] + kerning_x) * str.scale;
+                pen_y += (glyph->advance[1] + kerning_y) * str.scale;
+            }
+            cursor++;
+        }
+
+        c = nextCodepoint;
+        curr = next;
+        hasCurr = hasNext;
+    }
+}
+
+extern "C" size_t sgfont_count_quads(const struct SGFont* font, const struct SGTextString* strings, size_t num_strings)
+{
+    (void)font;
+    size_t count = 0;
+    for (size_t i = 0; i < num_strings; ++i)
+        count += CountQuads(strings[i]);
+    return count;
+}
+
+extern "C" size_t sgfont_build_quads(const struct SGFont* font, const struct SGTextString* strings, size_t num_strings,
+                                     struct SGTextVertex* vertices, uint32_t* indices, uint32_t base_vertex,
+                                     size_t max_quads, int num_threads)
+{
+    // every string's first quad has to be known before they can be laid out in
+    // parallel, so count first then prefix sum.
+    std::vector<size_t> firstQuad(num_strings + 1, 0);
+    JOB_ParallelFor((int)num_strings, num_threads, [&](int, int i) {
+        firstQuad[i + 1] = CountQuads(strings[i]);
+    });
+    for (size_t i = 0; i < num_strings; ++i)
+        firstQuad[i + 1] += firstQuad[i];
+
+    size_t numQuads = firstQuad[num_strings];
+    if (numQuads > max_quads)
+        return 0;
+
+    JOB_ParallelFor((int)num_strings, num_threads, [&](int, int i) {
+        size_t quad = firstQuad[i];
+        LayoutString(font, strings[i], vertices + quad * 4, indices ? indices + quad * 6 : NULL,
+                     base_vertex + (uint32_t)(quad * 4));
+    });
+    return numQuads;
+}
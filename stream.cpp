@@ -0,0 +1,40 @@
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "stream.h"
+
+int STREAM_BandRows(int height, uint64_t bytesPerRow, uint64_t budgetBytes)
+{
+    uint64_t rows = bytesPerRow ? budgetBytes / bytesPerRow : (uint64_t)height;
+    if (rows >= (uint64_t)height)
+        return height < 4 ? 4 : (height + 3) & ~3;
+    return rows < 4 ? 4 : (int)(rows & ~(uint64_t)3);
+}
+
+static int64_t Tell(FILE* fp)
+{
+#ifdef _WIN32
+    return _ftelli64(fp);
+#else
+    return (int64_t)ftello(fp);
+#endif
+}
+
+static bool Seek(FILE* fp, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(fp, (int64_t)offset, SEEK_SET) == 0;
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+bool STREAM_WriteAt(FILE* fp, uint64_t offset, const void* data, size_t size)
+{
+    if (Tell(fp) != (int64_t)offset && !Seek(fp, offset))
+        return false;
+    return fwrite(data, 1, size, fp) == size;
+}
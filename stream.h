@@ -0,0 +1,24 @@
+// Helpers for writing textures a band of rows at a time, so an atlas never has to
+// be held in memory as a whole.
+
+#ifndef STREAMH
+#define STREAMH
+
+#include <stdio.h>
+#include <stdint.h>
+#include <functional>
+
+// fills dest with numRows tightly packed rows of an image, starting at firstRow
+// counted from the top.  Bands may be asked for in any order.
+typedef std::function<void (int firstRow, int numRows, unsigned char* dest)> RowSource;
+
+// number of rows per band for an image height rows tall, when each band row costs
+// bytesPerRow and all of them together should stay within budgetBytes.  The result
+// is a multiple of 4, so bands line up with compressed blocks, and at least 4.
+int STREAM_BandRows(int height, uint64_t bytesPerRow, uint64_t budgetBytes);
+
+// writes size bytes at offset from the start of the file, seeking only when the
+// file isn't there already.  Offsets may be past 2GB.
+bool STREAM_WriteAt(FILE* fp, uint64_t offset, const void* data, size_t size);
+
+#endif
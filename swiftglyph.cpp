@@ -4,259 +4,848 @@
 #include <math.h>
 #include <ft2build.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
 #include FT_FREETYPE_H
 #include "tga.h"
+#include "mip.h"
+#include "png.h"
+#include "pixels.h"
+#include "pack.h"
+#include "charset.h"
+#include "mapfile.h"
+#include "raster.h"
+#include "jobs.h"
+#include "kerning.h"
+#include "fontbin.h"
+#include "sdf.h"
+#include "manifest.h"
+#include "glyphcache.h"
+#include "blockenc.h"
+#include "container.h"
+#include "metrics.h"
+#include "trace.h"
+
+// printable ASCII, used when no -range or -charset-file is given
+static const char* kDefaultRange = "32-126";
 
-static FT_Library s_freeTypeLibrary = 0;
-static FT_Face s_face;
+const int TAB_SIZE = 4;
 
-// 26.6 Fixed to Float
-#define FIXED_TO_FLOAT(x) ((float)(x) / 64.0f)
+void ErrorOut()
+{
+    printf("Generates a texture and font metrics for the specified font.\n");
+    printf("    Usage: swiftglyph [options] fontname\n");
+    printf("        -width integer   : specify width of the generated texture.\n");
+    printf("        -padding integer : specify padding around each glyph. Can help prevent\n");
+    printf("                           glyph clipping when rendering at small sizes.\n");
+    printf("        -size integer    : glyph size in pixels, defaults to the largest size that fits a grid.\n");
+    printf("        -sizes list      : pack several glyph sizes into one atlas, e.g. 12,16,24,48.\n");
+    printf("        -pack name       : atlas packing heuristic, maxrects (default) or skyline.\n");
+    printf("        -rotate          : allow glyphs to be rotated 90 degrees in the atlas.\n");
+    printf("        -range list      : codepoints to include, e.g. 32-126,0xA0-0x17F,U+0391-U+03C9.\n");
+    printf("                           may be given more than once, defaults to 32-126.\n");
+    printf("        -charset-file f  : include every character that appears in the utf-8 text file f.\n");
+    printf("        -sdf             : generate a signed distance field atlas instead of coverage.\n");
+    printf("        -spread integer  : distance in pixels covered by the -sdf field, defaults to 4.\n");
+    printf("        -manifest file   : build every job listed in a json manifest instead of a single font.\n");
+    printf("        -cache dir       : keep rendered glyphs in dir and reuse them in later runs.\n");
+    printf("        -cache-size int  : size limit of the -cache directory in megabytes, defaults to 256.\n");
+    printf("        -threads integer : number of threads to use, defaults to one per core.\n");
+    printf("        -memory-budget n : megabytes of atlas rows held while writing textures, defaults to 256.\n");
+    printf("        -stats           : print the time spent in each phase, glyph and file counts and peak memory.\n");
+    printf("        -trace file      : write a chrome trace event timeline of every phase to file.\n");
+    printf("        -lua             : will output metrics file as a lua table instead of a yaml file.\n");
+    printf("        -json            : will output metrics file as a json object file instead of yaml file.\n");
+    printf("        -bin             : will output metrics as a memory mappable binary file, see fontbin.h.\n");
+    printf("        -bin16           : same as -bin with 16 bit quantized metrics, see fontbin16.h.\n");
+    printf("        -png             : will output texture as a png instead of a raw file.\n");
+    printf("        -pngformat name  : png color type, ga (gray+alpha, default), gray (alpha only) or rgba.\n");
+    printf("        -tga             : will output texture as a tga instead of a raw file.\n");
+    printf("        -rle             : run length encode the -tga texture.\n");
+    printf("        -bc4             : will output texture as a BC4 compressed mip chain instead of a raw file.\n");
+    printf("        -eac             : will output texture as an EAC R11 compressed mip chain instead of a raw file.\n");
+    printf("        -ktx2            : will output texture as a ktx2 file with every mip level instead of a raw file.\n");
+    printf("        -dds             : will output texture as a dds file with every mip level instead of a raw file.\n");
+    printf("        -format name     : texels of the raw, tga, -ktx2 and -dds textures, la8 (default), r8, rgba8,\n");
+    printf("                           or for -ktx2 and -dds only, bc4 or eac.\n");
+    printf("        -premultiply     : scale the white of la8 and rgba8 textures by the coverage.\n");
+    printf("        -zlib            : deflate each mip level of the -ktx2 file.\n");
+    printf("        -quality name    : -bc4 and -eac encoder effort, fast, normal (default) or best.\n");
+    printf("        -mipfilter name  : filter used to build the .raw mip chain, box (default) or tent.\n");
+    printf("        -vflip           : texture coords will be flipped on v-axis LEGACY setting\n");
+    exit(1);
+}
 
-// TODO: utf8 support
-// Assumes ASCII encoding
-static const int kStartGlyph = 32;
-static const int kEndGlyph = 127;
-static const int kNumGlyphs = (kEndGlyph - kStartGlyph);
+// a font file, mapped once and shared by every job that uses it.
+struct FontSource
+{
+    std::string fontname;
+    MappedFile file;
+    FT_Face face;       // only touched by the main thread while the jobs are planned
+    uint64_t hash;      // of the file contents, used to key the glyph cache
+};
 
-const int TAB_SIZE = 4;
+// the glyphs of one font rendered at one size, shared by every atlas built from them.
+struct RasterGroup
+{
+    int font;
+    int pixels;
+    int sdfSpread;                      // 0 for a coverage atlas
+    std::vector<uint32_t> requested;    // sorted codepoints asked for, used to find duplicates
+    std::vector<GlyphInfo> glyphs;      // only codepoint and ftGlyphIndex are filled in
+    std::vector<FT_UInt> glyphIndices;
+    float line_height;
+    std::vector<GlyphBitmap> bitmaps;
+    std::vector<KerningPair> kerning;
+    bool ok;
+};
 
-struct Vec2
+// a packed atlas, shared by every job that only differs in the files it writes.
+struct Layout
 {
-    Vec2() {}
-    Vec2(float xIn, float yIn) : x(xIn), y(yIn) {}
-    float x;
-    float y;
+    std::vector<int> rasters;   // one raster group per pixel size, all packed together
+    int textureWidth;
+    int padding;
+    PackHeuristic packHeuristic;
+    bool rotate;
+    bool vflip;
+    std::vector<GlyphInfo> glyphs;          // every size in the order of rasters
+    std::vector<int> firstGlyph;            // where each size starts in glyphs, then the end
+    std::vector<int> slots;                 // atlas slot of each glyph, identical bitmaps share one
+    std::vector<const GlyphBitmap*> bitmaps;    // one per slot
+    std::vector<PackRect> rects;                // one per slot
+    std::vector<int> byTop;     // slots sorted by the top of their rect
+    int tallest;                // height of the tallest rect as placed
+    bool ok;
 };
 
-Vec2 operator+(const Vec2& a, const Vec2& b)
+// a single texture or metrics file to write for a job
+struct Output
 {
-    return Vec2(a.x + b.x, a.y + b.y);
-}
+    int job;
+    unsigned int texture;
+    unsigned int metrics;
+};
 
-Vec2 operator+(const Vec2& a, float scalar)
+// reads a comma separated list of pixel sizes, e.g. "12,16,24,48"
+static bool ParseSizes(const char* text, std::vector<int>* sizes)
 {
-    return Vec2(a.x + scalar, a.y + scalar);
+    sizes->clear();
+    const char* p = text;
+    while (true)
+    {
+        char* end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < 1 || value > (1 << 15))
+            return false;
+        sizes->push_back((int)value);
+        if (*end == '\0')
+            return true;
+        if (*end != ',')
+            return false;
+        p = end + 1;
+    }
 }
 
-Vec2 operator-(const Vec2& a, const Vec2& b)
+// when count items run side by side, each one gets an equal share of the threads
+// for its own inner loops.
+static int InnerThreads(int numThreads, int count)
 {
-    return Vec2(a.x - b.x, a.y - b.y);
+    int inner = JOB_ThreadCount(numThreads) / (count > 0 ? count : 1);
+    return inner > 1 ? inner : 1;
 }
 
-Vec2 operator-(const Vec2& a, float scalar)
+static void RenderGroup(const FontSource& font, RasterGroup* group, GlyphCache* cache, int numThreads)
 {
-    return Vec2(a.x - scalar, a.y - scalar);
+    TRACE_SCOPE_DETAIL("render group", font.fontname.c_str());
+    const int numGlyphs = (int)group->glyphs.size();
+    group->bitmaps.resize(numGlyphs);
+
+    // codepoints the font maps to the same glyph, e.g. the space and no-break space,
+    // are only rendered once and copied afterwards.
+    std::vector<int> sameAs(numGlyphs);
+    std::map<FT_UInt, int> firstOf;
+    for (int i = 0; i < numGlyphs; ++i)
+        sameAs[i] = firstOf.insert(std::make_pair(group->glyphIndices[i], i)).first->second;
+
+    // take whatever an earlier run already rendered from the cache, only the rest
+    // goes through FreeType.
+    std::vector<char> cached(numGlyphs, 0);
+    if (cache)
+    {
+        TRACE_SCOPE("cache load");
+        JOB_ParallelFor(numGlyphs, numThreads, [&](int, int i) {
+            if (sameAs[i] != i)
+                return;
+            GlyphCacheKey key = { font.hash, group->pixels, group->sdfSpread, group->glyphIndices[i] };
+            cached[i] = CACHE_Load(cache, key, &group->bitmaps[i]);
+        });
+    }
+
+    std::vector<int> misses;
+    std::vector<FT_UInt> missIndices;
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        if (sameAs[i] == i && !cached[i])
+        {
+            misses.push_back(i);
+            missIndices.push_back(group->glyphIndices[i]);
+        }
+    }
+    const int numMisses = (int)misses.size();
+    TRACE_Count(TRACE_GLYPHS_RENDERED, numMisses);
+    TRACE_Count(TRACE_GLYPHS_CACHED, firstOf.size() - numMisses);
+
+    // render each glyph into its own bitmap, they are placed into the atlas once
+    // all of their sizes are known.
+    std::vector<GlyphBitmap> rendered(numMisses);
+    int status = RASTER_OK;
+    if (numMisses > 0)
+    {
+        TRACE_SCOPE("rasterize");
+        status = RASTER_RenderGlyphs(font.file.data, font.file.size, group->pixels, &missIndices[0], numMisses,
+                                     &rendered[0], numThreads);
+    }
+    if (status != RASTER_OK)
+    {
+        fprintf(stderr, "Error Rendering Glyphs of \"%s\"\n", font.fontname.c_str());
+        group->ok = false;
+        return;
+    }
+
+    // turn the coverage into distance fields, each glyph grows by the spread on every side.
+    if (group->sdfSpread > 0)
+    {
+        TRACE_SCOPE("distance fields");
+        JOB_ParallelFor(numMisses, numThreads, [&](int, int i) {
+            SDF_Generate(&rendered[i], group->sdfSpread);
+        });
+    }
+
+    JOB_ParallelFor(numMisses, numThreads, [&](int, int i) {
+        if (cache)
+        {
+            GlyphCacheKey key = { font.hash, group->pixels, group->sdfSpread, missIndices[i] };
+            CACHE_Store(cache, key, rendered[i]);
+        }
+        group->bitmaps[misses[i]].pixels.swap(rendered[i].pixels);
+        group->bitmaps[misses[i]].width = rendered[i].width;
+        group->bitmaps[misses[i]].rows = rendered[i].rows;
+        group->bitmaps[misses[i]].metrics = rendered[i].metrics;
+    });
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        if (sameAs[i] != i)
+            group->bitmaps[i] = group->bitmaps[sameAs[i]];
+    }
+
+    // the kerning table is built once and shared by every exporter.  The face of the
+    // font belongs to the main thread, so use one of our own.
+    TRACE_SCOPE("kerning");
+    FT_Library library;
+    FT_Face face;
+    if (RASTER_OpenFace(font.file.data, font.file.size, group->pixels, &library, &face))
+    {
+        fprintf(stderr, "Error Loading Font \"%s\"\n", font.fontname.c_str());
+        group->ok = false;
+        return;
+    }
+    KERNING_Build(face, font.file.data, font.file.size, group->pixels, &group->glyphIndices[0], numGlyphs,
+                  numThreads, &group->kerning);
+    RASTER_CloseFace(library, face);
+    TRACE_Count(TRACE_KERNING_PAIRS, group->kerning.size());
+    group->ok = true;
 }
 
-Vec2 operator*(const Vec2& a, const Vec2& b)
+// 64 bit FNV-1a of the size and pixels of a bitmap
+static uint64_t HashBitmap(const GlyphBitmap& bitmap)
 {
-    return Vec2(a.x * b.x, a.y * b.y);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const int size[2] = { bitmap.width, bitmap.rows };
+    const unsigned char* bytes = (const unsigned char*)size;
+    for (size_t i = 0; i < sizeof(size); ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    for (size_t i = 0; i < bitmap.pixels.size(); ++i)
+        hash = (hash ^ bitmap.pixels[i]) * 0x100000001b3ull;
+    return hash;
 }
 
-Vec2 operator*(const Vec2& a, float scalar)
+static bool SameBitmap(const GlyphBitmap& a, const GlyphBitmap& b)
 {
-    return Vec2(a.x * scalar, a.y * scalar);
+    return a.width == b.width && a.rows == b.rows && a.pixels == b.pixels;
 }
 
-Vec2 operator/(const Vec2& a, const Vec2& b)
+static void PackLayout(const std::vector<RasterGroup>& groups, Layout* layout, int numThreads)
 {
-    return Vec2(a.x / b.x, a.y / b.y);
+    TRACE_SCOPE("pack layout");
+    const int kGlyphTextureWidth = layout->textureWidth;
+    const int kGlyphPixelBorder = layout->padding;
+
+    // the glyphs of every size go into the same atlas, one after the other.
+    layout->glyphs.clear();
+    layout->firstGlyph.clear();
+    std::vector<const GlyphBitmap*> bitmaps;
+    std::vector<const RasterGroup*> glyphGroups;
+    for (size_t r = 0; r < layout->rasters.size(); ++r)
+    {
+        const RasterGroup& group = groups[layout->rasters[r]];
+        layout->firstGlyph.push_back((int)layout->glyphs.size());
+        layout->glyphs.insert(layout->glyphs.end(), group.glyphs.begin(), group.glyphs.end());
+        for (size_t i = 0; i < group.bitmaps.size(); ++i)
+        {
+            bitmaps.push_back(&group.bitmaps[i]);
+            glyphGroups.push_back(&group);
+        }
+    }
+    layout->firstGlyph.push_back((int)layout->glyphs.size());
+    const int numGlyphs = (int)layout->glyphs.size();
+
+    // pixel identical bitmaps, such as the blank ones or the same glyph at the same
+    // size, are packed once and every glyph using them points at that one copy.
+    layout->slots.resize(numGlyphs);
+    layout->bitmaps.clear();
+    std::unordered_map<uint64_t, std::vector<int> > slotsByHash;
+    for (int i = 0; i < numGlyphs; ++i)
+    {
+        std::vector<int>& candidates = slotsByHash[HashBitmap(*bitmaps[i])];
+        size_t c = 0;
+        while (c < candidates.size() && !SameBitmap(*layout->bitmaps[candidates[c]], *bitmaps[i]))
+            c++;
+        if (c == candidates.size())
+        {
+            candidates.push_back((int)layout->bitmaps.size());
+            layout->bitmaps.push_back(bitmaps[i]);
+        }
+        layout->slots[i] = candidates[c];
+    }
+    const int numSlots = (int)layout->bitmaps.size();
+    TRACE_Count(TRACE_GLYPHS_SHARED, numGlyphs - numSlots);
+
+    std::vector<PackRect> rects(numSlots);
+    for (int i = 0; i < numSlots; ++i)
+    {
+        rects[i].width = layout->bitmaps[i]->width + 2 * kGlyphPixelBorder;
+        rects[i].height = layout->bitmaps[i]->rows + 2 * kGlyphPixelBorder;
+    }
+
+    if (!PACK_Rects(&rects[0], numSlots, kGlyphTextureWidth, kGlyphTextureWidth, layout->packHeuristic,
+                    layout->rotate))
+    {
+        fprintf(stderr, "Error : glyphs do not fit in a %dx%d texture, increase -width or lower -size\n",
+                kGlyphTextureWidth, kGlyphTextureWidth);
+        layout->ok = false;
+        return;
+    }
+
+    // the atlas itself is only built a band of rows at a time while the textures are
+    // written, see BlitRows.
+    std::vector<GlyphInfo>& glyphs = layout->glyphs;
+    layout->byTop.resize(numSlots);
+    layout->tallest = 0;
+    for (int i = 0; i < numSlots; ++i)
+    {
+        layout->byTop[i] = i;
+        const int placedHeight = rects[i].rotated ? rects[i].width : rects[i].height;
+        layout->tallest = placedHeight > layout->tallest ? placedHeight : layout->tallest;
+    }
+    std::sort(layout->byTop.begin(), layout->byTop.end(), [&](int a, int b) { return rects[a].y < rects[b].y; });
+
+    JOB_ParallelFor(numGlyphs, numThreads, [&](int, int i)
+    {
+        const GlyphBitmap& bitmap = *bitmaps[i];
+        const PackRect& rect = rects[layout->slots[i]];
+        const float line_height = glyphGroups[i]->line_height;
+
+        // store metrics, in units of the line height of the glyph's own size.
+        Vec2 xy_ll = Vec2(FIXED_TO_FLOAT(bitmap.metrics.horiBearingX),
+                          FIXED_TO_FLOAT(bitmap.metrics.horiBearingY - bitmap.metrics.height)) / line_height;
+        Vec2 xy_size = Vec2(FIXED_TO_FLOAT(bitmap.metrics.width), FIXED_TO_FLOAT(bitmap.metrics.height)) / line_height;
+        const float kXYGlyphPadding = (float)(kGlyphPixelBorder + glyphGroups[i]->sdfSpread) / line_height;
+        glyphs[i].xy_lower_left = xy_ll - kXYGlyphPadding;
+        glyphs[i].xy_upper_right = glyphs[i].xy_lower_left + xy_size + 2.0f * kXYGlyphPadding;
+
+        Vec2 uv_size = rect.rotated ? Vec2(rect.height, rect.width) : Vec2(rect.width, rect.height);
+        uv_size = uv_size / kGlyphTextureWidth;
+        Vec2 upper_left = Vec2(rect.x, rect.y) / kGlyphTextureWidth;
+        Vec2 lower_right = upper_left + uv_size;
+
+        if (layout->vflip)
+        {
+            glyphs[i].uv_lower_left = Vec2(upper_left.x, lower_right.y);
+            glyphs[i].uv_upper_right = Vec2(lower_right.x, upper_left.y);
+        }
+        else
+        {
+            glyphs[i].uv_lower_left = Vec2(upper_left.x, 1.0f - lower_right.y);
+            glyphs[i].uv_upper_right = Vec2(lower_right.x, 1.0f - upper_left.y);
+        }
+        glyphs[i].rotated = rect.rotated;
+
+        glyphs[i].advance.x = FIXED_TO_FLOAT(bitmap.metrics.horiAdvance) / line_height;
+        glyphs[i].advance.y = 0.0f;
+    });
+    layout->rects.swap(rects);
+    layout->ok = true;
 }
 
-Vec2 operator/(const Vec2& a, float scalar)
+// fills numRows rows of the atlas starting at firstRow, top row first, with every
+// glyph that overlaps them.  Rotated glyphs are turned 90 degrees clockwise.
+static void BlitRows(const Layout& layout, int firstRow, int numRows, unsigned char* dest)
 {
-    return Vec2(a.x / scalar, a.y / scalar);
+    const int width = layout.textureWidth;
+    const int border = layout.padding;
+    const int endRow = firstRow + numRows;
+    memset(dest, 0, (size_t)numRows * width);
+
+    // no rect that starts more than tallest rows above the band can reach into it
+    std::vector<int>::const_iterator it = std::lower_bound(layout.byTop.begin(), layout.byTop.end(),
+        firstRow - layout.tallest, [&](int i, int y) { return layout.rects[i].y < y; });
+    for (; it != layout.byTop.end() && layout.rects[*it].y < endRow; ++it)
+    {
+        const GlyphBitmap& bitmap = *layout.bitmaps[*it];
+        const PackRect& rect = layout.rects[*it];
+        const int top = rect.y + border;
+        const int left = rect.x + border;
+        const int rows = rect.rotated ? bitmap.width : bitmap.rows;
+        const int from = top > firstRow ? top : firstRow;
+        const int to = top + rows < endRow ? top + rows : endRow;
+        for (int y = from; y < to; ++y)
+        {
+            unsigned char* out = dest + (size_t)(y - firstRow) * width + left;
+            const int k = y - top;
+            if (rect.rotated)
+            {
+                for (int j = 0; j < bitmap.rows; ++j)
+                    out[bitmap.rows - 1 - j] = bitmap.pixels[(size_t)j * bitmap.width + k];
+            }
+            else
+                memcpy(out, &bitmap.pixels[(size_t)k * bitmap.width], bitmap.width);
+        }
+    }
 }
 
-struct GlyphInfo
-{
-    FT_UInt ftGlyphIndex;
-    unsigned char ascii_char;
-    Vec2 xy_lower_left;
-    Vec2 xy_upper_right;
-    Vec2 uv_lower_left;
-    Vec2 uv_upper_right;
-    Vec2 advance;
-};
+static const char* kTextureExtensions[] = { ".raw", ".tga", ".png", ".bc4", ".eac", ".ktx2", ".dds" };
+static const char* kMetricsExtensions[] = { ".yaml", ".lua", ".json", ".bin", ".bin16" };
 
-static GlyphInfo* s_glyphInfo;
+// position of the single bit set in a MANIFEST_TEXTURE_ or MANIFEST_METRICS_ value
+static int BitIndex(unsigned int bit)
+{
+    int index = 0;
+    while ((1u << index) != bit)
+        index++;
+    return index;
+}
 
-void ErrorOut()
+// writes one texture, reading the atlas in bands of bandRows rows.
+static bool WriteTexture(const Layout& layout, const FontJob& job, unsigned int texture, int bandRows, int numThreads)
 {
-    printf("Generates a texture and font metrics for the specified font.\n");
-    printf("    Usage: swiftglyph [options] fontname\n");
-    printf("        -width integer   : specify width of the generated texture.\n");
-    printf("        -padding integer : specify padding around each glyph. Can help prevent\n");
-    printf("                           glyph clipping when rendering at small sizes.\n");
-    printf("        -lua             : will output metrics file as a lua table instead of a yaml file.\n");
-    printf("        -json            : will output metrics file as a json object file instead of yaml file.\n");
-    printf("        -png             : will output texture as a png instead of a raw file.\n");
-    printf("        -tga             : will output texture as a tga instead of a raw file.\n");
-    printf("        -vflip           : texture coords will be flipped on v-axis LEGACY setting\n");
-    exit(1);
+    const int kGlyphTextureWidth = layout.textureWidth;
+    const RowSource buffer = [&](int firstRow, int numRows, unsigned char* dest) {
+        BlitRows(layout, firstRow, numRows, dest);
+    };
+
+    const std::string fn = job.prefix + kTextureExtensions[BitIndex(texture)];
+    TRACE_SCOPE_DETAIL("write texture", fn.c_str());
+    bool ok = true;
+    if (texture == MANIFEST_TEXTURE_RAW)
+    {
+        // build the mip chain a band at a time and stream it straight into the .raw file.
+        ok = MIP_SaveRaw(fn.c_str(), kGlyphTextureWidth, buffer, bandRows, job.mipFilter,
+                         (PixelFormat)job.textureFormat, job.premultiplied) == MIP_OK;
+    }
+    else if (texture == MANIFEST_TEXTURE_PNG)
+    {
+        // the atlas rows are already top to bottom, which is the png scanline order.
+        ok = PNG_Save(fn.c_str(), kGlyphTextureWidth, kGlyphTextureWidth, job.pngColorType,
+                      buffer, bandRows, numThreads) == PNG_OK;
+    }
+    else if (texture == MANIFEST_TEXTURE_TGA)
+    {
+        // r8 is saved as a greyscale targa straight from the atlas.  la8 and rgba8
+        // both need 32 bit pixels, converted a band at a time.
+        int status;
+        if (job.textureFormat == CONTAINER_R8)
+            status = TGA_SaveRows(fn.c_str(), kGlyphTextureWidth, kGlyphTextureWidth, 8, buffer, bandRows, job.rle);
+        else
+        {
+            std::vector<unsigned char> coverage;
+            status = TGA_SaveRows(fn.c_str(), kGlyphTextureWidth, kGlyphTextureWidth, 32,
+                [&](int firstRow, int numRows, unsigned char* dest) {
+                    coverage.resize((size_t)numRows * kGlyphTextureWidth);
+                    buffer(firstRow, numRows, &coverage[0]);
+                    PIXEL_ConvertImage(&coverage[0], kGlyphTextureWidth, numRows, PIXEL_RGBA8, job.premultiplied,
+                                       false, dest);
+                }, bandRows, job.rle);
+        }
+        if (status == TGA_ERROR_TOO_LARGE)
+            fprintf(stderr, "Error : tga textures can't be wider than 65535 texels\n");
+        ok = status == TGA_OK;
+    }
+    else if (texture == MANIFEST_TEXTURE_BC4 || texture == MANIFEST_TEXTURE_EAC)
+    {
+        // same mip chain and row order as the .raw file, each level block compressed.
+        const bool bc4 = texture == MANIFEST_TEXTURE_BC4;
+        double psnr[2];
+        ok = BLOCK_SaveChain(fn.c_str(), kGlyphTextureWidth, buffer, bandRows, bc4 ? BLOCK_BC4 : BLOCK_EAC_R11,
+                             job.blockQuality, job.mipFilter, numThreads, psnr) == BLOCK_OK;
+        if (ok)
+            printf("%s : PSNR %.2f dB level 0, %.2f dB whole chain\n", fn.c_str(), psnr[0], psnr[1]);
+    }
+    else if (texture == MANIFEST_TEXTURE_KTX2 || texture == MANIFEST_TEXTURE_DDS)
+    {
+        ContainerSettings settings;
+        settings.format = job.textureFormat;
+        settings.quality = job.blockQuality;
+        settings.premultiplied = job.premultiplied;
+        settings.filter = job.mipFilter;
+        settings.zlib = job.zlib;
+        settings.numThreads = numThreads;
+        if (texture == MANIFEST_TEXTURE_KTX2)
+        {
+            ok = CONTAINER_SaveKTX2(fn.c_str(), kGlyphTextureWidth, buffer, bandRows, settings) == CONTAINER_OK;
+        }
+        else
+        {
+            ok = CONTAINER_SaveDDS(fn.c_str(), kGlyphTextureWidth, buffer, bandRows, settings) == CONTAINER_OK;
+        }
+    }
+
+    if (ok)
+        TRACE_CountFile(fn.c_str());
+    else
+        fprintf(stderr, "Error Writing \"%s\"\n", fn.c_str());
+    return ok;
 }
 
-static void ExportYAMLMetrics(const std::string& fontprefix, const std::string& fontname,
-                              int textureWidth, float line_height)
+static bool WriteMetrics(const Layout& layout, const std::vector<RasterGroup>& groups, const FontJob& job,
+                         unsigned int metrics)
 {
+    const RasterGroup& group = groups[layout.rasters[0]];
+    std::string fn = job.prefix + kMetricsExtensions[BitIndex(metrics)];
+    TRACE_SCOPE_DETAIL("write metrics", fn.c_str());
+
+    // an atlas of several -sizes keys its metrics by pixel size
+    std::vector<MetricsSize> sizes;
+    if (layout.rasters.size() > 1)
+    {
+        sizes.resize(layout.rasters.size());
+        for (size_t r = 0; r < layout.rasters.size(); ++r)
+        {
+            const RasterGroup& sizeGroup = groups[layout.rasters[r]];
+            sizes[r].pixels = sizeGroup.pixels;
+            sizes[r].line_height = sizeGroup.line_height;
+            sizes[r].glyphs.assign(layout.glyphs.begin() + layout.firstGlyph[r],
+                                   layout.glyphs.begin() + layout.firstGlyph[r + 1]);
+            sizes[r].kerning = sizeGroup.kerning;
+        }
+    }
 
-    // dump out metrics for each glyph into a yaml file
-    char yamlFilename[512];
-    sprintf(yamlFilename, "%s.yaml", fontprefix.c_str());
-    FILE* fp = fopen(yamlFilename, "w");
-    fprintf(fp, "# Font Metrics for %s\n", fontname.c_str());
-    fprintf(fp, "texture_width: %d\n", textureWidth);
-    fprintf(fp, "glyph_metrics:\n");
-    for (int i = 0; i < kNumGlyphs; ++i)
-    {
-        fprintf(fp, "-\n");
-        fprintf(fp, "  char_index: %u\n", s_glyphInfo[i].ftGlyphIndex);
-        fprintf(fp, "  xy_lower_left: [%f, %f]\n", s_glyphInfo[i].xy_lower_left.x, s_glyphInfo[i].xy_lower_left.y);
-        fprintf(fp, "  xy_upper_right: [%f, %f]\n", s_glyphInfo[i].xy_upper_right.x, s_glyphInfo[i].xy_upper_right.y);
-        fprintf(fp, "  uv_lower_left: [%f, %f]\n", s_glyphInfo[i].uv_lower_left.x, s_glyphInfo[i].uv_lower_left.y);
-        fprintf(fp, "  uv_upper_right: [%f, %f]\n", s_glyphInfo[i].uv_upper_right.x, s_glyphInfo[i].uv_upper_right.y);
-        fprintf(fp, "  advance: [%f, %f]\n", s_glyphInfo[i].advance.x, s_glyphInfo[i].advance.y);
-    }
-
-    // dump kerning table
-    fprintf(fp, "kerning:\n");
-    bool empty = true;
-    for (int i = 0; i < kNumGlyphs; ++i)
-    {
-        for (int j = 0; j < kNumGlyphs; ++j)
-        {
-            FT_Vector ftKerning;
-            FT_Get_Kerning(s_face, s_glyphInfo[i].ftGlyphIndex, s_glyphInfo[j].ftGlyphIndex,
-                           FT_KERNING_UNFITTED, &ftKerning);
-            if (ftKerning.x != 0 || ftKerning.y != 0)
+    bool ok = true;
+    if (metrics == MANIFEST_METRICS_LUA)
+    {
+        if (!sizes.empty())
+            ok = ExportLuaSizes(sizes, job.prefix, job.fontname, layout.textureWidth, group.sdfSpread);
+        else
+            ok = ExportLuaMetrics(layout.glyphs, job.prefix, job.fontname, layout.textureWidth, group.sdfSpread,
+                                  group.line_height, group.kerning);
+    }
+    else if (metrics == MANIFEST_METRICS_YAML)
+    {
+        if (!sizes.empty())
+            ok = ExportYAMLSizes(sizes, job.prefix, job.fontname, layout.textureWidth, group.sdfSpread);
+        else
+            ok = ExportYAMLMetrics(layout.glyphs, job.prefix, job.fontname, layout.textureWidth, group.sdfSpread,
+                                   group.line_height, group.kerning);
+    }
+    else if (metrics == MANIFEST_METRICS_JSON)
+    {
+        if (!sizes.empty())
+            ok = ExportJSONSizes(sizes, job.prefix, layout.textureWidth, group.sdfSpread);
+        else
+            ok = ExportJSONMetrics(layout.glyphs, job.prefix, layout.textureWidth, group.sdfSpread,
+                                   group.line_height, group.kerning);
+    }
+    else if (metrics == MANIFEST_METRICS_BIN || metrics == MANIFEST_METRICS_BIN16)
+    {
+        const bool compact = metrics == MANIFEST_METRICS_BIN16;
+        // the texture is referenced relative to the metrics file, when several are
+        // written the first of raw, tga, png, bc4, eac, ktx2 and dds is used.
+        int textureType = 0;
+        while (textureType < 6 && !(job.textures & (1u << textureType)))
+            textureType++;
+        std::string textureFilename = job.prefix.substr(job.prefix.find_last_of("/\\") + 1) +
+            kTextureExtensions[textureType];
+        if (sizes.empty())
+        {
+            ok = (compact ? ExportCompactMetrics : ExportBinaryMetrics)(layout.glyphs, job.prefix, textureFilename,
+                layout.textureWidth, group.sdfSpread, group.line_height, layout.vflip, group.kerning);
+        }
+        else
+        {
+            // fontbin.h holds a single size, so each one gets its own prefix_pixels.bin
+            // or .bin16 sharing the one texture.
+            for (size_t r = 0; r < sizes.size() && ok; ++r)
             {
-                empty = false;
-                fprintf(fp, "-\n");
-                fprintf(fp, "  first_index: %u\n", s_glyphInfo[i].ftGlyphIndex);
-                fprintf(fp, "  second_index: %u\n", s_glyphInfo[j].ftGlyphIndex);
-                fprintf(fp, "  kerning: [%f, %f]\n", FIXED_TO_FLOAT(ftKerning.x) / line_height,
-                        FIXED_TO_FLOAT(ftKerning.y) / line_height);
+                char suffix[16];
+                snprintf(suffix, sizeof(suffix), "_%d", sizes[r].pixels);
+                fn = job.prefix + suffix + kMetricsExtensions[BitIndex(metrics)];
+                ok = (compact ? ExportCompactMetrics : ExportBinaryMetrics)(sizes[r].glyphs, job.prefix + suffix,
+                    textureFilename, layout.textureWidth, group.sdfSpread, sizes[r].line_height, layout.vflip,
+                    sizes[r].kerning);
+                if (ok && r + 1 < sizes.size())
+                    TRACE_CountFile(fn.c_str());
             }
         }
     }
-    fclose(fp);
+
+    if (ok)
+        TRACE_CountFile(fn.c_str());
+    else
+        fprintf(stderr, "Error Writing \"%s\"\n", fn.c_str());
+    return ok;
 }
 
-static void ExportLuaMetrics(const std::string& fontprefix, const std::string& fontname,
-                             int textureWidth, float line_height)
+// builds every job.  Each font file is loaded once, each (font, size, codepoints)
+// is rendered once and each distinct atlas is packed once, then all of the
+// requested textures and metrics files are written from the shared results.
+// Every stage runs its items side by side on the job system.
+static int RunJobs(const std::vector<FontJob>& jobs, GlyphCache* cache, int numThreads, int memoryMegabytes)
 {
+    // Init FreeType
+    FT_Library freeTypeLibrary;
+    FT_Error error = FT_Init_FreeType(&freeTypeLibrary);
+    assert(!error);
+
+    std::vector<FontSource> fonts;
+    std::vector<RasterGroup> groups;
+    std::vector<Layout> layouts;
+    std::vector<int> jobLayouts(jobs.size());
+
+    for (size_t j = 0; j < jobs.size(); ++j)
+    {
+        const FontJob& job = jobs[j];
+
+        // Attempt to laod the font.  The file is mapped once and shared by every face
+        // created from it, including the per thread faces used for rendering.
+        int fontIndex = 0;
+        while (fontIndex < (int)fonts.size() && fonts[fontIndex].fontname != job.fontname)
+            fontIndex++;
+        if (fontIndex == (int)fonts.size())
+        {
+            TRACE_SCOPE_DETAIL("load font", job.fontname.c_str());
+            FontSource font;
+            font.fontname = job.fontname;
+            error = 0;
+            if (MAP_Open(job.fontname.c_str(), &font.file))
+                error = FT_New_Memory_Face(freeTypeLibrary, font.file.data, (FT_Long)font.file.size, 0, &font.face);
+            if (!font.file.data || error)
+            {
+                fprintf(stderr, "Error Loading Font \"%s\"\n", job.fontname.c_str());
+                return 1;
+            }
+            font.hash = cache ? CACHE_HashFont(font.file.data, font.file.size) : 0;
+            fonts.push_back(font);
+        }
+        FontSource& font = fonts[fontIndex];
+
+        std::vector<uint32_t> codepoints = job.codepoints;
+        if (codepoints.empty())
+            CHARSET_ParseRanges(kDefaultRange, &codepoints);
+        CHARSET_Sort(&codepoints);
+
+        // allocate gylph metrics, skipping codepoints the font doesn't cover.
+        std::vector<GlyphInfo> glyphs;
+        int numMissing = 0;
+        for (size_t i = 0; i < codepoints.size(); ++i)
+        {
+            FT_UInt glyph_index = FT_Get_Char_Index(font.face, codepoints[i]);
+            if (glyph_index == 0)
+            {
+                numMissing++;
+                continue;
+            }
+
+            GlyphInfo info;
+            info.ftGlyphIndex = glyph_index;
+            info.codepoint = codepoints[i];
+            glyphs.push_back(info);
+        }
+
+        const int numGlyphs = (int)glyphs.size();
+        if (numGlyphs == 0)
+        {
+            fprintf(stderr, "Error : none of the requested codepoints are in \"%s\"\n", job.fontname.c_str());
+            return 1;
+        }
+
+        // by default pick the size that would fit every glyph into a square grid cell,
+        // the packer will only ever do better than that.  -sizes renders every size
+        // listed and packs them all into the one atlas.
+        std::vector<int> sizes = job.sizes;
+        std::sort(sizes.begin(), sizes.end());
+        sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+        if (sizes.empty())
+        {
+            int pixels = job.pixels;
+            if (pixels <= 0)
+            {
+                const int kGlyphsPerRow = ceil(sqrt(numGlyphs));
+                pixels = (job.textureWidth / kGlyphsPerRow) - (2 * job.padding);
+            }
+            sizes.push_back(pixels);
+        }
+        const int sdfSpread = job.sdf ? job.sdfSpread : 0;
 
-    // dump out metrics for each glyph into a yaml file
-    char luaFilename[512];
-    sprintf(luaFilename, "%s.lua", fontprefix.c_str());
-    FILE* fp = fopen(luaFilename, "w");
-    fprintf(fp, "-- Font Metrics for %s\n", fontname.c_str());
-    fprintf(fp, "Font {\n");
-    fprintf(fp, "    texture_width = %d,\n", textureWidth);
-    fprintf(fp, "    glyph_metrics = {\n");
-    for (int i = 0; i < kNumGlyphs; ++i)
-    {
-        fprintf(fp, "        [%u] = { ascii_index = %u,\n", s_glyphInfo[i].ascii_char, s_glyphInfo[i].ascii_char);
-        fprintf(fp, "            xy_lower_left = {%f, %f},\n", s_glyphInfo[i].xy_lower_left.x, s_glyphInfo[i].xy_lower_left.y);
-        fprintf(fp, "            xy_upper_right = {%f, %f},\n", s_glyphInfo[i].xy_upper_right.x, s_glyphInfo[i].xy_upper_right.y);
-        fprintf(fp, "            uv_lower_left = {%f, %f},\n", s_glyphInfo[i].uv_lower_left.x, s_glyphInfo[i].uv_lower_left.y);
-        fprintf(fp, "            uv_upper_right = {%f, %f},\n", s_glyphInfo[i].uv_upper_right.x, s_glyphInfo[i].uv_upper_right.y);
-        fprintf(fp, "            advance = {%f, %f} },\n", s_glyphInfo[i].advance.x, s_glyphInfo[i].advance.y);
-    }
-    fprintf(fp, "    },\n");
-
-    // dump kerning table
-    fprintf(fp, "    kerning = {\n");
-    bool empty = true;
-    for (int i = 0; i < kNumGlyphs; ++i)
-    {
-        for (int j = 0; j < kNumGlyphs; ++j)
-        {
-            FT_Vector ftKerning;
-            FT_Get_Kerning(s_face, s_glyphInfo[i].ftGlyphIndex, s_glyphInfo[j].ftGlyphIndex,
-                           FT_KERNING_UNFITTED, &ftKerning);
-            if (ftKerning.x != 0 || ftKerning.y != 0)
+        std::vector<int> rasters;
+        for (size_t s = 0; s < sizes.size(); ++s)
+        {
+            const int pixels = sizes[s];
+            int groupIndex = 0;
+            while (groupIndex < (int)groups.size() &&
+                   !(groups[groupIndex].font == fontIndex && groups[groupIndex].pixels == pixels &&
+                     groups[groupIndex].sdfSpread == sdfSpread && groups[groupIndex].requested == codepoints))
+                groupIndex++;
+            if (groupIndex == (int)groups.size())
             {
-                empty = false;
-                fprintf(fp, "        { first_char = %u,\n", s_glyphInfo[i].ascii_char);
-                fprintf(fp, "          second_char = %u,\n", s_glyphInfo[j].ascii_char);
-                fprintf(fp, "          kerning = {%f, %f} },\n", FIXED_TO_FLOAT(ftKerning.x) / line_height,
-                        FIXED_TO_FLOAT(ftKerning.y) / line_height);
+                if (numMissing > 0 && rasters.empty())
+                    printf("Warning : %d codepoints are not in \"%s\" and were skipped\n", numMissing,
+                           job.fontname.c_str());
+
+                error = FT_Set_Char_Size(font.face, pixels << 6, 0, 72, 0);
+                assert(!error);
+
+                RasterGroup group;
+                group.font = fontIndex;
+                group.pixels = pixels;
+                group.sdfSpread = sdfSpread;
+                group.requested = codepoints;
+                group.glyphs = glyphs;
+                for (int i = 0; i < numGlyphs; ++i)
+                    group.glyphIndices.push_back(glyphs[i].ftGlyphIndex);
+                group.line_height = FIXED_TO_FLOAT(font.face->size->metrics.height);
+                group.ok = false;
+                groups.push_back(group);
             }
+            rasters.push_back(groupIndex);
+        }
+
+        int layoutIndex = 0;
+        while (layoutIndex < (int)layouts.size() &&
+               !(layouts[layoutIndex].rasters == rasters && layouts[layoutIndex].textureWidth == job.textureWidth &&
+                 layouts[layoutIndex].padding == job.padding && layouts[layoutIndex].packHeuristic == job.packHeuristic &&
+                 layouts[layoutIndex].rotate == job.rotate && layouts[layoutIndex].vflip == job.vflip))
+            layoutIndex++;
+        if (layoutIndex == (int)layouts.size())
+        {
+            Layout layout;
+            layout.rasters = rasters;
+            layout.textureWidth = job.textureWidth;
+            layout.padding = job.padding;
+            layout.packHeuristic = job.packHeuristic;
+            layout.rotate = job.rotate;
+            layout.vflip = job.vflip;
+            layout.ok = false;
+            layouts.push_back(layout);
         }
+        jobLayouts[j] = layoutIndex;
     }
-    fprintf(fp, "    }\n");
-    fprintf(fp, "}\n");
-    fclose(fp);
-}
 
-static void ExportJSONMetrics(const std::string& fontprefix, const std::string& fontname,
-                              int textureWidth, float line_height)
-{
+    // render
+    int inner = InnerThreads(numThreads, (int)groups.size());
+    {
+        TRACE_SCOPE("render");
+        JOB_ParallelFor((int)groups.size(), numThreads, [&](int, int i) {
+            RenderGroup(fonts[groups[i].font], &groups[i], cache, inner);
+        });
+    }
+    for (size_t i = 0; i < groups.size(); ++i)
+        if (!groups[i].ok)
+            return 1;
 
-    // dump out metrics for each glyph into a yaml file
-    char luaFilename[512];
-    sprintf(luaFilename, "%s.json", fontprefix.c_str());
-    FILE* fp = fopen(luaFilename, "w");
-    fprintf(fp, "{\n");
-    fprintf(fp, "    \"texture_width\": %d,\n", textureWidth);
-    fprintf(fp, "    \"glyph_metrics\": {\n");
-    for (int i = 0; i < kNumGlyphs; ++i)
-    {
-        fprintf(fp, "        \"%u\": {\n", s_glyphInfo[i].ascii_char);
-        fprintf(fp, "            \"ascii_index\": %u,\n", s_glyphInfo[i].ascii_char);
-        fprintf(fp, "            \"xy_lower_left\": [%f, %f],\n", s_glyphInfo[i].xy_lower_left.x, s_glyphInfo[i].xy_lower_left.y);
-        fprintf(fp, "            \"xy_upper_right\": [%f, %f],\n", s_glyphInfo[i].xy_upper_right.x, s_glyphInfo[i].xy_upper_right.y);
-        fprintf(fp, "            \"uv_lower_left\": [%f, %f],\n", s_glyphInfo[i].uv_lower_left.x, s_glyphInfo[i].uv_lower_left.y);
-        fprintf(fp, "            \"uv_upper_right\": [%f, %f],\n", s_glyphInfo[i].uv_upper_right.x, s_glyphInfo[i].uv_upper_right.y);
-        fprintf(fp, "            \"advance\": [%f, %f]\n", s_glyphInfo[i].advance.x, s_glyphInfo[i].advance.y);
-        fprintf(fp, "        }%s\n", (i == kNumGlyphs - 1) ? "" : ",");
-    }
-    fprintf(fp, "    },\n");
-
-    // dump kerning table
-    fprintf(fp, "    \"kerning\": {\n");
-    bool empty = true;
-    for (int i = 0; i < kNumGlyphs; ++i)
-    {
-        for (int j = 0; j < kNumGlyphs; ++j)
-        {
-            FT_Vector ftKerning;
-            FT_Get_Kerning(s_face, s_glyphInfo[i].ftGlyphIndex, s_glyphInfo[j].ftGlyphIndex,
-                           FT_KERNING_UNFITTED, &ftKerning);
-            if (ftKerning.x != 0 || ftKerning.y != 0)
+    // pack
+    inner = InnerThreads(numThreads, (int)layouts.size());
+    {
+        TRACE_SCOPE("pack");
+        JOB_ParallelFor((int)layouts.size(), numThreads, [&](int, int i) {
+            PackLayout(groups, &layouts[i], inner);
+        });
+    }
+    for (size_t i = 0; i < layouts.size(); ++i)
+        if (!layouts[i].ok)
+            return 1;
+
+    // write every file
+    std::vector<Output> outputs;
+    for (size_t j = 0; j < jobs.size(); ++j)
+    {
+        for (unsigned int bit = 1; bit <= MANIFEST_TEXTURE_DDS; bit <<= 1)
+        {
+            if (jobs[j].textures & bit)
+            {
+                Output output = { (int)j, bit, 0 };
+                outputs.push_back(output);
+            }
+            if (jobs[j].metrics & bit)
             {
-                empty = false;
-                fprintf(fp, "        {\n");
-                fprintf(fp, "            \"first_char\" = %u,\n", s_glyphInfo[i].ascii_char);
-                fprintf(fp, "            \"second_char\" = %u,\n", s_glyphInfo[j].ascii_char);
-                fprintf(fp, "            \"kerning\" = {%f, %f}\n", FIXED_TO_FLOAT(ftKerning.x) / line_height, FIXED_TO_FLOAT(ftKerning.y) / line_height);
-                fprintf(fp, "        }%s\n", (i == kNumGlyphs - 1 && j == kNumGlyphs - 1) ? "" : ",");
+                Output output = { (int)j, 0, bit };
+                outputs.push_back(output);
             }
         }
     }
-    fprintf(fp, "    }\n");
-    fprintf(fp, "}\n");
-    fclose(fp);
+
+    // the memory budget is shared by the textures written side by side.  Each row of
+    // a band costs about kBandBytesPerTexel bytes per texel across the coverage, the
+    // mip levels and the converted or compressed texels.
+    const int kBandBytesPerTexel = 12;
+    int concurrent = JOB_ThreadCount(numThreads);
+    concurrent = concurrent < (int)outputs.size() ? concurrent : (int)outputs.size();
+    const uint64_t budget = ((uint64_t)memoryMegabytes << 20) / (concurrent > 0 ? concurrent : 1);
+
+    std::vector<char> written(outputs.size(), 0);
+    inner = InnerThreads(numThreads, (int)outputs.size());
+    {
+        TRACE_SCOPE("write");
+        JOB_ParallelFor((int)outputs.size(), numThreads, [&](int, int i) {
+            const FontJob& job = jobs[outputs[i].job];
+            const Layout& layout = layouts[jobLayouts[outputs[i].job]];
+            const int bandRows = STREAM_BandRows(layout.textureWidth,
+                                                 (uint64_t)layout.textureWidth * kBandBytesPerTexel, budget);
+            if (outputs[i].texture)
+                written[i] = WriteTexture(layout, job, outputs[i].texture, bandRows, inner);
+            else
+                written[i] = WriteMetrics(layout, groups, job, outputs[i].metrics);
+        });
+    }
+
+    for (size_t i = 0; i < fonts.size(); ++i)
+    {
+        FT_Done_Face(fonts[i].face);
+        MAP_Close(&fonts[i].file);
+    }
+    FT_Done_FreeType(freeTypeLibrary);
+
+    for (size_t i = 0; i < outputs.size(); ++i)
+        if (!written[i])
+            return 1;
+    return 0;
 }
 
 int main(int argc, char** argv)
 {
     // check options
-    int textureWidth = 512;
-    int padding = 1;
-    bool vflip = false;
-    std::string fontname;
+    FontJob job;
+    std::string manifest;
+    int numThreads = 0;
+    std::string cacheDirectory;
+    int cacheMegabytes = 256;
+    int memoryMegabytes = 256;
+    bool stats = false;
+    std::string traceFilename;
 
     bool foundFile = false;
 
-    enum MetricsFileType {YamlType, LuaType, JsonType};
-    MetricsFileType metricsFileType = YamlType;
-
-    enum TextureFileType {RawType, TgaType, PngType};
-    TextureFileType textureFileType = RawType;
-
     for (int i = 1; i < argc; ++i)
     {
         if (strcmp(argv[i], "-h") == 0)
@@ -267,26 +856,27 @@ int main(int argc, char** argv)
         {
             if ((i + 1) < argc)
             {
-                textureWidth = atoi(argv[i+1]);
+                job.textureWidth = atoi(argv[i+1]);
                 // positive and a power of two
-                if (textureWidth > 0 && ((textureWidth & (textureWidth - 1)) == 0))
+                if (job.textureWidth > 0 && job.textureWidth <= (1 << 16) &&
+                    ((job.textureWidth & (job.textureWidth - 1)) == 0))
                 {
                     i++;
                     continue;
                 }
             }
 
-            printf("Error : -width should be followed by a number which is a power of 2\n");
+            printf("Error : -width should be followed by a power of 2 no larger than 65536\n");
             return 1;
         }
         else if (strcmp(argv[i], "-padding") == 0)
         {
             if ((i + 1) < argc)
             {
-                padding = atoi(argv[i+1]);
+                job.padding = atoi(argv[i+1]);
 
                 // positive and not too large.
-                if (padding >= 0 && padding <= 10)
+                if (job.padding >= 0 && job.padding <= 10)
                 {
                     i++;
                     continue;
@@ -296,223 +886,427 @@ int main(int argc, char** argv)
             printf("Error : -padding should be followed by a positive integer less than 11.\n");
             return 1;
         }
-        else if (strcmp(argv[i], "-png") == 0)
+        else if (strcmp(argv[i], "-range") == 0)
         {
-            textureFileType = PngType;
+            if ((i + 1) < argc && CHARSET_ParseRanges(argv[i+1], &job.codepoints) == CHARSET_OK)
+            {
+                i++;
+                continue;
+            }
+
+            printf("Error : -range should be followed by a list of codepoints or ranges, e.g. 32-126,0x400-0x4FF\n");
+            return 1;
         }
-        else if (strcmp(argv[i], "-tga") == 0)
+        else if (strcmp(argv[i], "-charset-file") == 0)
         {
-            textureFileType = TgaType;
+            if ((i + 1) < argc)
+            {
+                int result = CHARSET_LoadFile(argv[i+1], &job.codepoints);
+                if (result == CHARSET_OK)
+                {
+                    i++;
+                    continue;
+                }
+                printf("Error : could not read \"%s\", %s\n", argv[i+1],
+                       result == CHARSET_ERROR_FILE_OPEN ? "file not found" : "invalid utf-8");
+                return 1;
+            }
+
+            printf("Error : -charset-file should be followed by a filename\n");
+            return 1;
         }
-        else if (strcmp(argv[i], "-lua") == 0)
+        else if (strcmp(argv[i], "-size") == 0)
         {
-            metricsFileType = LuaType;
+            if ((i + 1) < argc)
+            {
+                job.pixels = atoi(argv[i+1]);
+                if (job.pixels > 0)
+                {
+                    i++;
+                    continue;
+                }
+            }
+
+            printf("Error : -size should be followed by a positive integer.\n");
+            return 1;
         }
-        else if (strcmp(argv[i], "-json") == 0)
+        else if (strcmp(argv[i], "-sizes") == 0)
         {
-            metricsFileType = JsonType;
+            if ((i + 1) < argc && ParseSizes(argv[i+1], &job.sizes))
+            {
+                i++;
+                continue;
+            }
+
+            printf("Error : -sizes should be followed by a list of pixel sizes, e.g. 12,16,24,48.\n");
+            return 1;
         }
-        else if (strcmp(argv[i], "-vflip") == 0)
+        else if (strcmp(argv[i], "-sdf") == 0)
         {
-            vflip = true;
+            job.sdf = true;
         }
-        else
+        else if (strcmp(argv[i], "-spread") == 0)
         {
-            if (!foundFile)
+            if ((i + 1) < argc)
             {
-                foundFile = true;
-                fontname = argv[i];
+                job.sdfSpread = atoi(argv[i+1]);
+                if (job.sdfSpread > 0 && job.sdfSpread <= 64)
+                {
+                    i++;
+                    continue;
+                }
             }
-            else
-                ErrorOut();
-        }
-    }
-
-    if (!foundFile)
-    {
-        ErrorOut();
-    }
 
-    // strip the extention off of the font filename
-    std::string fontprefix = fontname.substr(0, fontname.find_last_of("."));
-
-    // Init FreeType
-    FT_Error error = FT_Init_FreeType(&s_freeTypeLibrary);
-    assert(!error);
-
-    // Attempt to laod the font.
-    error = FT_New_Face(s_freeTypeLibrary, fontname.c_str(), 0, &s_face);
-    if (error)
-    {
-        fprintf(stderr, "Error Loading Font \"%s\"\n", fontname.c_str());
-        return 1;
-    }
-
-    // allocate gylph metrics
-    s_glyphInfo = new GlyphInfo[kNumGlyphs];
-    assert(s_glyphInfo);
-
-    const int kNumGlyphsPerRow = ceil(sqrt(kNumGlyphs));
-    const int kGlyphTextureWidth = textureWidth;
-    const int kGlyphWidth = kGlyphTextureWidth / kNumGlyphsPerRow;
-    const int kBufferSize = kGlyphTextureWidth * kGlyphTextureWidth;
-    const int kGlyphPixelBorder = padding;
-
-    // allocate & clear the render buffer
-    unsigned char* buffer = new unsigned char[kBufferSize];
-    memset(buffer, 0, kBufferSize);
+            printf("Error : -spread should be followed by a positive integer less than 65.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-manifest") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                manifest = argv[i+1];
+                i++;
+                continue;
+            }
 
-    int pixels = kGlyphWidth - (2 * kGlyphPixelBorder);
-    error = FT_Set_Char_Size(s_face, pixels << 6, 0, 72, 0);
-    assert(!error);
+            printf("Error : -manifest should be followed by a filename\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-cache") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                cacheDirectory = argv[i+1];
+                i++;
+                continue;
+            }
 
-    float line_height = FIXED_TO_FLOAT(s_face->size->metrics.height);
+            printf("Error : -cache should be followed by a directory\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-cache-size") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                cacheMegabytes = atoi(argv[i+1]);
+                if (cacheMegabytes > 0)
+                {
+                    i++;
+                    continue;
+                }
+            }
 
-    //printf("Generating glyphs\n");
+            printf("Error : -cache-size should be followed by a positive number of megabytes.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-memory-budget") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                memoryMegabytes = atoi(argv[i+1]);
+                if (memoryMegabytes > 0)
+                {
+                    i++;
+                    continue;
+                }
+            }
 
-    // render each glyph into the buffer
-    for (int i = 0; i < kNumGlyphs; ++i)
-    {
-        // load glyph into s_face->glyph
-        FT_UInt glyph_index = FT_Get_Char_Index(s_face, kStartGlyph + i);
-        error = FT_Load_Glyph(s_face, glyph_index, FT_LOAD_DEFAULT);
-        assert(!error);
+            printf("Error : -memory-budget should be followed by a positive number of megabytes.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-stats") == 0)
+        {
+            stats = true;
+        }
+        else if (strcmp(argv[i], "-trace") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                traceFilename = argv[i+1];
+                i++;
+                continue;
+            }
 
-        // render glyph into s_face->glyph->bitmap
-        error = FT_Render_Glyph(s_face->glyph, FT_RENDER_MODE_NORMAL);
-        assert(!error);
+            printf("Error : -trace should be followed by an output filename.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-threads") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                numThreads = atoi(argv[i+1]);
+                if (numThreads > 0)
+                {
+                    i++;
+                    continue;
+                }
+            }
 
-        int r = i / kNumGlyphsPerRow;
-        int c = i % kNumGlyphsPerRow;
-        int x = c * kGlyphWidth;
-        int y = r * kGlyphWidth;
-        unsigned char* dest = buffer + (y * kGlyphTextureWidth) + x;
+            printf("Error : -threads should be followed by a positive integer.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-pack") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                if (strcmp(argv[i+1], "maxrects") == 0)
+                {
+                    job.packHeuristic = PACK_MAXRECTS;
+                    i++;
+                    continue;
+                }
+                else if (strcmp(argv[i+1], "skyline") == 0)
+                {
+                    job.packHeuristic = PACK_SKYLINE;
+                    i++;
+                    continue;
+                }
+            }
 
-        // copy glyph bitmap into buffer, scanline by scanline.
-        for (int j = 0; j < s_face->glyph->bitmap.rows; ++j)
+            printf("Error : -pack should be followed by maxrects or skyline.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-rotate") == 0)
+        {
+            job.rotate = true;
+        }
+        else if (strcmp(argv[i], "-png") == 0)
         {
-            memcpy(dest + ((j + kGlyphPixelBorder) * kGlyphTextureWidth) + kGlyphPixelBorder,
-                   s_face->glyph->bitmap.buffer + (s_face->glyph->bitmap.pitch * j),
-                   s_face->glyph->bitmap.width);
+            job.textures = MANIFEST_TEXTURE_PNG;
         }
+        else if (strcmp(argv[i], "-pngformat") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                if (strcmp(argv[i+1], "ga") == 0)
+                {
+                    job.pngColorType = PNG_COLOR_GRAY_ALPHA;
+                    i++;
+                    continue;
+                }
+                else if (strcmp(argv[i+1], "gray") == 0)
+                {
+                    job.pngColorType = PNG_COLOR_GRAY;
+                    i++;
+                    continue;
+                }
+                else if (strcmp(argv[i+1], "rgba") == 0)
+                {
+                    job.pngColorType = PNG_COLOR_RGBA;
+                    i++;
+                    continue;
+                }
+            }
 
-        // store metrics.
-        s_glyphInfo[i].ftGlyphIndex = glyph_index;
-        s_glyphInfo[i].ascii_char = kStartGlyph + i;
+            printf("Error : -pngformat should be followed by ga, gray or rgba.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-tga") == 0)
+        {
+            job.textures = MANIFEST_TEXTURE_TGA;
+        }
+        else if (strcmp(argv[i], "-rle") == 0)
+        {
+            job.rle = true;
+        }
+        else if (strcmp(argv[i], "-bc4") == 0)
+        {
+            job.textures = MANIFEST_TEXTURE_BC4;
+        }
+        else if (strcmp(argv[i], "-eac") == 0)
+        {
+            job.textures = MANIFEST_TEXTURE_EAC;
+        }
+        else if (strcmp(argv[i], "-ktx2") == 0)
+        {
+            job.textures = MANIFEST_TEXTURE_KTX2;
+        }
+        else if (strcmp(argv[i], "-dds") == 0)
+        {
+            job.textures = MANIFEST_TEXTURE_DDS;
+        }
+        else if (strcmp(argv[i], "-format") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                static const char* const kFormatNames[] = { "la8", "r8", "rgba8", "bc4", "eac" };
+                int index = 0;
+                while (index < 5 && strcmp(argv[i+1], kFormatNames[index]) != 0)
+                    index++;
+                if (index < 5)
+                {
+                    job.textureFormat = (ContainerFormat)index;
+                    i++;
+                    continue;
+                }
+            }
 
-        Vec2 xy_ll = Vec2(FIXED_TO_FLOAT(s_face->glyph->metrics.horiBearingX),
-                          FIXED_TO_FLOAT(s_face->glyph->metrics.horiBearingY - s_face->glyph->metrics.height)) / line_height;
-        Vec2 xy_size = Vec2(FIXED_TO_FLOAT(s_face->glyph->metrics.width), FIXED_TO_FLOAT(s_face->glyph->metrics.height)) / line_height;
-        const float kXYGlyphPadding = (float)kGlyphPixelBorder / kGlyphWidth;
-        s_glyphInfo[i].xy_lower_left = xy_ll - kXYGlyphPadding;
-        s_glyphInfo[i].xy_upper_right = s_glyphInfo[i].xy_lower_left + xy_size + 2.0f * kXYGlyphPadding;
+            printf("Error : -format should be followed by la8, r8, rgba8, bc4 or eac.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-premultiply") == 0)
+        {
+            job.premultiplied = true;
+        }
+        else if (strcmp(argv[i], "-zlib") == 0)
+        {
+            job.zlib = true;
+        }
+        else if (strcmp(argv[i], "-quality") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                if (strcmp(argv[i+1], "fast") == 0)
+                {
+                    job.blockQuality = BLOCK_QUALITY_FAST;
+                    i++;
+                    continue;
+                }
+                else if (strcmp(argv[i+1], "normal") == 0)
+                {
+                    job.blockQuality = BLOCK_QUALITY_NORMAL;
+                    i++;
+                    continue;
+                }
+                else if (strcmp(argv[i+1], "best") == 0)
+                {
+                    job.blockQuality = BLOCK_QUALITY_BEST;
+                    i++;
+                    continue;
+                }
+            }
 
-        Vec2 glyph_bitmap_size = Vec2(s_face->glyph->bitmap.width, s_face->glyph->bitmap.rows);
-        Vec2 uv_size = (glyph_bitmap_size + (2.0f * kGlyphPixelBorder)) / kGlyphTextureWidth;
-        Vec2 upper_left = Vec2(x, y) / kGlyphTextureWidth;
-        Vec2 lower_right = upper_left + uv_size;
+            printf("Error : -quality should be followed by fast, normal or best.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-lua") == 0)
+        {
+            job.metrics = MANIFEST_METRICS_LUA;
+        }
+        else if (strcmp(argv[i], "-json") == 0)
+        {
+            job.metrics = MANIFEST_METRICS_JSON;
+        }
+        else if (strcmp(argv[i], "-bin") == 0)
+        {
+            job.metrics = MANIFEST_METRICS_BIN;
+        }
+        else if (strcmp(argv[i], "-bin16") == 0)
+        {
+            job.metrics = MANIFEST_METRICS_BIN16;
+        }
+        else if (strcmp(argv[i], "-mipfilter") == 0)
+        {
+            if ((i + 1) < argc)
+            {
+                if (strcmp(argv[i+1], "box") == 0)
+                {
+                    job.mipFilter = MIP_FILTER_BOX;
+                    i++;
+                    continue;
+                }
+                else if (strcmp(argv[i+1], "tent") == 0)
+                {
+                    job.mipFilter = MIP_FILTER_TENT;
+                    i++;
+                    continue;
+                }
+            }
 
-        if (vflip)
+            printf("Error : -mipfilter should be followed by box or tent.\n");
+            return 1;
+        }
+        else if (strcmp(argv[i], "-vflip") == 0)
         {
-            s_glyphInfo[i].uv_lower_left = Vec2(upper_left.x, lower_right.y);
-            s_glyphInfo[i].uv_upper_right = Vec2(lower_right.x, upper_left.y);
+            job.vflip = true;
         }
         else
         {
-            s_glyphInfo[i].uv_lower_left = Vec2(upper_left.x, 1.0f - lower_right.y);
-            s_glyphInfo[i].uv_upper_right = Vec2(lower_right.x, 1.0f - upper_left.y);
+            if (!foundFile)
+            {
+                foundFile = true;
+                job.fontname = argv[i];
+            }
+            else
+                ErrorOut();
         }
-
-        s_glyphInfo[i].advance.x = FIXED_TO_FLOAT(s_face->glyph->metrics.horiAdvance) / line_height;
-        s_glyphInfo[i].advance.y = 0.0f;
     }
 
-    // NOTE: I could dump out the texture directly, but I don't want to generate
-    // the mip-levels manually. so I save the image as a TGA file then shell out to
-    // imagemagick to do the work for me :)
-    // Also, for debugging purposes, its handy to have the TGA file
+    if (stats || !traceFilename.empty())
+        TRACE_Enable(!traceFilename.empty());
 
-    // create rgba bufffer.
-    unsigned char* rgbaBuffer = new unsigned char[kBufferSize * 4];
-    for (int i = 0; i < kBufferSize; ++i)
+    std::vector<FontJob> jobs;
+    if (!manifest.empty())
     {
-        rgbaBuffer[i*4+0] = 255;
-        rgbaBuffer[i*4+1] = 255;
-        rgbaBuffer[i*4+2] = 255;
-        rgbaBuffer[i*4+3] = buffer[i];
-    }
-
-    delete [] buffer;
-
-    if (textureFileType == TgaType)
-    {
-        // save it out as a targa.
-        std::string fn = fontprefix + std::string(".tga");
-        TGA_Save(fn.c_str(), kGlyphTextureWidth, kGlyphTextureWidth, 32, rgbaBuffer);
-        delete [] rgbaBuffer;
-    }
-    else if (textureFileType == PngType)
-    {
-        // save a temp targa
-        TGA_Save("temp.tga", kGlyphTextureWidth, kGlyphTextureWidth, 32, rgbaBuffer);
-        delete [] rgbaBuffer;
-
-        // convert the tga to a png
-        std::string fn = fontprefix + std::string(".png");
-        char cmd[512];
-        //sprintf(cmd, "sips -s format png temp.tga --out %s", fn.c_str());
-        sprintf(cmd, "magick convert -flip temp.tga %s", fn.c_str());
-        system(cmd);
+        // the other options only apply to the single font given on the command line,
+        // except for -threads which overrides the manifest.
+        if (foundFile)
+            ErrorOut();
 
-        remove("temp.tga");
+        TRACE_SCOPE("load manifest");
+        int manifestThreads = 0;
+        std::string message;
+        if (MANIFEST_Load(manifest.c_str(), &jobs, &manifestThreads, &message) != MANIFEST_OK)
+        {
+            fprintf(stderr, "Error : could not read \"%s\", %s\n", manifest.c_str(), message.c_str());
+            return 1;
+        }
+        if (numThreads <= 0)
+            numThreads = manifestThreads;
     }
-    else if (textureFileType == RawType)
+    else
     {
-        // first save it out as a targa.
-        TGA_Save("temp.tga", kGlyphTextureWidth, kGlyphTextureWidth, 32, rgbaBuffer);
-        delete [] rgbaBuffer;
-
-        char cmd[512];
-
-        int w = kGlyphTextureWidth;
-        int i = 0;
-        while (w >= 1)
+        if (!foundFile)
         {
-            printf("processing lod level %d\n", i);
-
-            // scale the image for each mip-level
-            sprintf(cmd, "magick convert -scale %dx%d temp.tga temp2.tga", w, w);
-            system(cmd);
-
-            // stream into an intensity alpha format
-            sprintf(cmd, "magick stream -map ia -storage-type char temp2.tga temp.raw");
-            system(cmd);
-
-            // concat all the mip levels into a single binary file
-            sprintf(cmd, "cat temp.raw %s %s.raw", i == 0 ? ">" : ">>", fontprefix.c_str());
-            system(cmd);
+            ErrorOut();
+        }
 
-            w /= 2;
-            i += 1;
+        if ((job.textures & MANIFEST_TEXTURE_DDS) && job.textureFormat == CONTAINER_EAC_R11)
+        {
+            printf("Error : -dds can't hold -format eac, use -ktx2.\n");
+            return 1;
+        }
+        if ((job.textures & (MANIFEST_TEXTURE_RAW | MANIFEST_TEXTURE_TGA)) &&
+            (job.textureFormat == CONTAINER_BC4 || job.textureFormat == CONTAINER_EAC_R11))
+        {
+            printf("Error : -format bc4 and eac need -ktx2 or -dds, or use -bc4 or -eac.\n");
+            return 1;
         }
 
-        remove("temp.tga");
-        remove("temp2.tga");
-        remove("temp.raw");
+        // strip the extention off of the font filename
+        job.prefix = job.fontname.substr(0, job.fontname.find_last_of("."));
+        jobs.push_back(job);
     }
 
-    if (metricsFileType == LuaType)
+    GlyphCache* cache = NULL;
+    if (!cacheDirectory.empty() &&
+        CACHE_Open(cacheDirectory.c_str(), (uint64_t)cacheMegabytes << 20, &cache) != CACHE_OK)
     {
-        ExportLuaMetrics(fontprefix, fontname, textureWidth, line_height);
+        fprintf(stderr, "Error : could not create the cache directory \"%s\"\n", cacheDirectory.c_str());
+        return 1;
     }
-    else if (metricsFileType == YamlType)
+
+    int result = RunJobs(jobs, cache, numThreads, memoryMegabytes);
+
+    if (cache)
     {
-        ExportYAMLMetrics(fontprefix, fontname, textureWidth, line_height);
+        GlyphCacheStats cacheStats;
+        {
+            TRACE_SCOPE("close cache");
+            CACHE_Close(cache, &cacheStats);
+        }
+        printf("Cache : %llu hits, %llu misses, %llu bytes read, %llu bytes written, %llu bytes evicted\n",
+               (unsigned long long)cacheStats.hits, (unsigned long long)cacheStats.misses,
+               (unsigned long long)cacheStats.bytesRead, (unsigned long long)cacheStats.bytesWritten,
+               (unsigned long long)cacheStats.bytesEvicted);
     }
-    else if (metricsFileType == JsonType)
+
+    if (stats)
+        TRACE_PrintStats(stdout);
+    if (!traceFilename.empty() && !TRACE_WriteChrome(traceFilename.c_str()))
     {
-        ExportJSONMetrics(fontprefix, fontname, textureWidth, line_height);
+        fprintf(stderr, "Error Writing \"%s\"\n", traceFilename.c_str());
+        return 1;
     }
-
-    return 0;
+    return result;
 }
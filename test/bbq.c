@@ -1,35 +1,19 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE     // MAP_ANON
+#endif
 #include "bbq.h"
 #include <stdio.h>
 #include <stdlib.h>
 
-// helper
-// TODO: use mmap instead?
-enum LoadFileToMemoryResult { CouldNotOpenFile = -1, CouldNotReadFile = -2 };
-static int LoadFileToMemory(const char *filename, unsigned char **result)
-{
-	int size = 0;
-	FILE *f = fopen(filename, "rb");
-	if (f == NULL) 
-	{
-		*result = NULL;
-		return CouldNotOpenFile;
-	}
-	fseek(f, 0, SEEK_END);
-	size = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	*result = (unsigned char*)malloc(sizeof(unsigned char) * (size + 1));
-	
-	int newSize = (int)fread(*result, sizeof(char), size, f);
-	if (size != newSize)
-	{
-		printf("size = %d, newSize = %d\n", size, newSize);
-		free(*result);
-		return CouldNotReadFile;
-	}
-	fclose(f);
-	(*result)[size] = 0;  // make sure it's null terminated.
-	return size;
-}
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // Memory layout
 //
@@ -40,38 +24,186 @@ static int LoadFileToMemory(const char *filename, unsigned char **result)
 // base + 2                       | offset 1
 // ...                         
 // base + num_offsets             | offset n-1
-// base + num_offsets + 1         | num_offsets   // again so we can figure out what memory to free.
+// base + num_offsets + 1         | num_offsets   // again so we can find base from the data.
 // base + num_offsets + 2         | start of cooked data
 //
+// every offset is the position of a pointer in the cooked data, see bbq_resolve.
 
-void* bbq_load(const char* filename)
+// checks that count elements of elem_size bytes starting at ptr fit in the size
+// bytes at base, without overflowing.
+static int CheckArray(const unsigned char* base, size_t size, const void* ptr, size_t count, size_t elem_size)
 {
-	unsigned char* p;
-	int size = LoadFileToMemory(filename, &p);
-	if(size <= 0)
+	const unsigned char* p = (const unsigned char*)ptr;
+	size_t offset;
+	if (p < base || p > base + size)
 		return 0;
+	offset = (size_t)(p - base);
+	return elem_size == 0 || count <= (size - offset) / elem_size;
+}
 
-	unsigned int* base = (unsigned int*)p;
-	unsigned int num_offsets = *base;
-	unsigned int* offset = base + 1;
+// checks the header and that every pointer and what it points at are inside the
+// file, once, so the accessors don't have to.  The sizes of the arrays depend on
+// the schema and are checked by the caller with bbq_check_array.
+static int Validate(const unsigned char* base, size_t size)
+{
+	unsigned int num_offsets, i;
+	size_t header, data_size;
+	const unsigned char* data;
+	if (size < 2 * sizeof(uint32_t))
+		return 0;
 
-	// get the start of the actual data, (the 2 is to skip past both num_offsets values)
-	unsigned char* data = (unsigned char*)(base + num_offsets + 2);
+	memcpy(&num_offsets, base, sizeof(num_offsets));
+	if (num_offsets > size / sizeof(uint32_t) - 2)
+		return 0;
+	header = (num_offsets + 2) * sizeof(uint32_t);
+	if (memcmp(base, base + header - sizeof(uint32_t), sizeof(uint32_t)) != 0)
+		return 0;
 
-	// fix up the pointers
-	while ((unsigned char*)(offset + 1) < data)
+	data = base + header;
+	data_size = size - header;
+	for (i = 0; i < num_offsets; ++i)
 	{
-		unsigned long* ptr = (unsigned long*)(data + *offset);
-		*ptr = (unsigned long)((unsigned char*)ptr + *ptr);
-		offset++;
+		uint32_t offset;
+		memcpy(&offset, base + (i + 1) * sizeof(uint32_t), sizeof(offset));
+		if ((offset & 3) != 0 || (size_t)offset + sizeof(int32_t) > data_size)
+			return 0;
+		if (!CheckArray(data, data_size, bbq_resolve(data + offset), 0, 0))
+			return 0;
 	}
-	
-	return data;
+	return 1;
 }
 
-void bbq_free(void* ptr)
+#ifdef _WIN32
+
+const void* bbq_load(const char* filename)
 {
-	unsigned int* p = (unsigned int*)ptr;
-	unsigned char* base = (unsigned char*)(p - (*(p-1) + 2));
-	free(base);
+	HANDLE file, mapping;
+	LARGE_INTEGER size;
+	const unsigned char* base;
+	uint32_t num_offsets;
+
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return 0;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > (size_t)-1)
+	{
+		CloseHandle(file);
+		return 0;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return 0;
+	base = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (base == NULL)
+		return 0;
+
+	if (!Validate(base, (size_t)size.QuadPart))
+	{
+		UnmapViewOfFile(base);
+		return 0;
+	}
+	memcpy(&num_offsets, base, sizeof(num_offsets));
+	return base + (num_offsets + 2) * sizeof(uint32_t);
+}
+
+static void Unmap(const unsigned char* base)
+{
+	UnmapViewOfFile(base);
+}
+
+// the view only knows its size to the page, the rest of the last page reads as zeros.
+static size_t MappedSize(const unsigned char* base)
+{
+	MEMORY_BASIC_INFORMATION info;
+	if (VirtualQuery(base, &info, sizeof(info)) != sizeof(info))
+		return 0;
+	return info.RegionSize;
+}
+
+#else
+
+// munmap needs the length, so the file is mapped one page into a reserved range and
+// the length is kept at the end of that first page, just before the file.
+const void* bbq_load(const char* filename)
+{
+	struct stat st;
+	size_t page, size;
+	unsigned char* region;
+	uint32_t num_offsets;
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > (size_t)-1 / 2)
+	{
+		close(fd);
+		return 0;
+	}
+	size = (size_t)st.st_size;
+	page = (size_t)sysconf(_SC_PAGESIZE);
+
+	region = (unsigned char*)mmap(NULL, page + size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (region == MAP_FAILED)
+	{
+		close(fd);
+		return 0;
+	}
+	if (mmap(region + page, size, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+	{
+		munmap(region, page + size);
+		close(fd);
+		return 0;
+	}
+	close(fd);
+	memcpy(region + page - sizeof(size), &size, sizeof(size));
+	mprotect(region, page, PROT_READ);
+
+	if (!Validate(region + page, size))
+	{
+		munmap(region, page + size);
+		return 0;
+	}
+	memcpy(&num_offsets, region + page, sizeof(num_offsets));
+	return region + page + (num_offsets + 2) * sizeof(uint32_t);
+}
+
+static void Unmap(const unsigned char* base)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t size;
+	memcpy(&size, base - sizeof(size), sizeof(size));
+	munmap((void*)(base - page), page + size);
+}
+
+static size_t MappedSize(const unsigned char* base)
+{
+	size_t size;
+	memcpy(&size, base - sizeof(size), sizeof(size));
+	return size;
+}
+
+#endif
+
+void bbq_free(const void* ptr)
+{
+	const unsigned char* data = (const unsigned char*)ptr;
+	uint32_t num_offsets;
+	if (!data)
+		return;
+	memcpy(&num_offsets, data - sizeof(uint32_t), sizeof(num_offsets));
+	Unmap(data - (num_offsets + 2) * sizeof(uint32_t));
+}
+
+int bbq_check_array(const void* root, const void* array, size_t count, size_t elem_size)
+{
+	const unsigned char* data = (const unsigned char*)root;
+	uint32_t num_offsets;
+	size_t header, size;
+	memcpy(&num_offsets, data - sizeof(uint32_t), sizeof(num_offsets));
+	header = (num_offsets + 2) * sizeof(uint32_t);
+	size = MappedSize(data - header);
+	if (size < header)
+		return 0;
+	return CheckArray(data, size - header, array, count, elem_size);
 }
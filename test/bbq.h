@@ -1,6 +1,9 @@
 #ifndef BBQ_H
 #define BBQ_H
 
+#include <stdint.h>
+#include <string.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,8 +19,29 @@ struct OpenGLTexture
 	void** pixels;
 };
 
-void* bbq_load(const char* filename);
-void bbq_free(void* ptr);
+// maps a cooked file read-only and returns its root struct, or 0 if the file
+// can't be mapped or any of its pointers lands outside of it.  The pages are
+// shared with every other process that loads the same file.
+const void* bbq_load(const char* filename);
+void bbq_free(const void* ptr);
+
+// returns 1 if count elements of elem_size bytes starting at array lie inside the
+// file root was loaded from, else 0.  bbq_load only knows where pointers land, the
+// sizes of the arrays they point at come from the schema, so check every array
+// once after loading.
+int bbq_check_array(const void* root, const void* array, size_t count, size_t elem_size);
+
+// cooked pointers hold a byte offset from the pointer itself in their first 32 bits,
+// little endian, so the mapped file is used as is.  Read them through BBQ_PTR,
+// e.g. BBQ_PTR(struct GlyphMetrics, font->glyph_metrics_array)[i].
+static inline const void* bbq_resolve(const void* field)
+{
+	int32_t offset;
+	memcpy(&offset, field, sizeof(offset));
+	return (const unsigned char*)field + offset;
+}
+
+#define BBQ_PTR(type, field) ((const type*)bbq_resolve(&(field)))
 
 #ifdef __cplusplus
 }
@@ -48,12 +48,9 @@ static float s_quad_uvs[] = {
 static GLuint s_checker_texture;
 static GLuint s_font_texture;
 
-struct Font* s_font = 0;
+const struct Font* s_font = 0;
 
 #define TAB_SIZE 4
-#define START_GLYPH 32
-#define END_GLYPH 127
-#define NUM_GLYPHS (END_GLYPH - START_GLYPH)
 
 
 enum LoadFileToMemoryResult { CouldNotOpenFile = -1, CouldNotReadFile = -2 };
@@ -83,10 +80,27 @@ static int LoadFileToMemory(const char *filename, unsigned char **result)
 	return size;
 }
 
-struct Font* LoadFont(const char* font_filename, GLuint* glt)
+const struct Font* LoadFont(const char* font_filename, GLuint* glt)
 {
-	// load the font
-	struct Font* font = (struct Font*)bbq_load(font_filename);
+	// map the font
+	const struct Font* font = (const struct Font*)bbq_load(font_filename);
+	if (!font)
+	{
+		printf("error loading %s\n", font_filename);
+		exit(1);
+	}
+
+	// the schema knows the array sizes, bbq_load doesn't
+	if (!bbq_check_array(font, font, 1, sizeof(struct Font)) ||
+		!bbq_check_array(font, BBQ_PTR(struct GlyphMetrics, font->glyph_metrics_array),
+						 font->glyph_metrics_array_size, sizeof(struct GlyphMetrics)) ||
+		!bbq_check_array(font, BBQ_PTR(struct GlyphKerning, font->glyph_kerning_array),
+						 font->glyph_kerning_array_size, sizeof(struct GlyphKerning)))
+	{
+		printf("error loading %s, an array runs past the end of the file\n", font_filename);
+		bbq_free(font);
+		exit(1);
+	}
 
 	glGenTextures(1, glt);
 	glBindTexture(GL_TEXTURE_2D, *glt);
@@ -97,10 +111,11 @@ struct Font* LoadFont(const char* font_filename, GLuint* glt)
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
 	unsigned char* texture_data;
-	int result = LoadFileToMemory(font->texture_filename, &texture_data);
+	const char* texture_filename = BBQ_PTR(char, font->texture_filename);
+	int result = LoadFileToMemory(texture_filename, &texture_data);
 	if (result < 0)
 	{
-		printf("error loading %s\n", font->texture_filename);
+		printf("error loading %s\n", texture_filename);
 		exit(1);
 	}
 
@@ -122,23 +137,71 @@ struct Font* LoadFont(const char* font_filename, GLuint* glt)
 	return font;
 }
 
-void FreeFont(struct Font* font)
+void FreeFont(const struct Font* font)
 {
 	bbq_free(font);
 }
 
-struct GlyphMetrics* FindGlyphMetrics(struct Font* font, char c)
+// glyph_metrics_array is sorted by codepoint, so binary search it.
+static const struct GlyphMetrics* BinarySearchGlyphMetrics(const struct Font* font, unsigned int codepoint)
 {
-	int i = c - START_GLYPH;
+	const struct GlyphMetrics* glyphs = BBQ_PTR(struct GlyphMetrics, font->glyph_metrics_array);
+	unsigned int lo = 0;
+	unsigned int hi = font->glyph_metrics_array_size;
+	while (lo < hi)
+	{
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (glyphs[mid].codepoint < codepoint)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < font->glyph_metrics_array_size && glyphs[lo].codepoint == codepoint)
+		return glyphs + lo;
+	return 0;
+}
 
-	// if c is non-printable use '?'
-	if ((i < 0) || (i >= NUM_GLYPHS))
-		i = '?' - START_GLYPH;
+const struct GlyphMetrics* FindGlyphMetrics(const struct Font* font, unsigned int codepoint)
+{
+	const struct GlyphMetrics* glyph = BinarySearchGlyphMetrics(font, codepoint);
 
-	return font->glyph_metrics_array + i;
+	// if the font doesn't have c use '?'
+	if (!glyph)
+		glyph = BinarySearchGlyphMetrics(font, '?');
+
+	return glyph;
+}
+
+// decode the utf-8 sequence at *p and advance past it, malformed bytes become '?'
+static unsigned int NextCodepoint(const char** p)
+{
+	const unsigned char* s = (const unsigned char*)*p;
+	unsigned int c = s[0];
+	int length = 1;
+	if (c >= 0xf0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80 && (s[3] & 0xc0) == 0x80)
+	{
+		c = ((c & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) | (s[3] & 0x3f);
+		length = 4;
+	}
+	else if (c >= 0xe0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80)
+	{
+		c = ((c & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+		length = 3;
+	}
+	else if (c >= 0xc0 && (s[1] & 0xc0) == 0x80)
+	{
+		c = ((c & 0x1f) << 6) | (s[1] & 0x3f);
+		length = 2;
+	}
+	else if (c >= 0x80)
+	{
+		c = '?';
+	}
+	*p += length;
+	return c;
 }
 
-void DrawGlyph(float pen_x, float pen_y, struct GlyphMetrics* glyph)
+void DrawGlyph(float pen_x, float pen_y, const struct GlyphMetrics* glyph)
 {
 	assert(glyph);
 
@@ -178,44 +241,47 @@ void DrawGlyph(float pen_x, float pen_y, struct GlyphMetrics* glyph)
 	glVertex3fv(v3);
 }
 
-void KerningLookup(struct Font* font, unsigned int curr_index, unsigned int next_index, 
+void KerningLookup(const struct Font* font, unsigned int curr_index, unsigned int next_index, 
 				   float* kerning_x, float* kerning_y)
 {
 	// TODO: faster search
+	const struct GlyphKerning* pairs = BBQ_PTR(struct GlyphKerning, font->glyph_kerning_array);
 	unsigned int i;
 	for (i = 0; i < font->glyph_kerning_array_size; ++i)
 	{
-		if ((font->glyph_kerning_array[i].first_index == curr_index) &&
-			(font->glyph_kerning_array[i].second_index == next_index))
+		if ((pairs[i].first_index == curr_index) &&
+			(pairs[i].second_index == next_index))
 		{
-			*kerning_x = font->glyph_kerning_array[i].kerning[0];
-			*kerning_y = font->glyph_kerning_array[i].kerning[1];
+			*kerning_x = pairs[i].kerning[0];
+			*kerning_y = pairs[i].kerning[1];
 			return;
 		}
 	}
 }
 
-void DrawString(struct Font* font, const char* str)
+void DrawString(const struct Font* font, const char* str)
 {
 	int cursor = 0;
 	float pen_x = 0;
 	float pen_y = 0;
 
 	glBegin(GL_QUADS);
-	const char* p;
-	for (p = str; *p; ++p)
+	const char* p = str;
+	unsigned int c = *p ? NextCodepoint(&p) : 0;
+	while (c)
 	{
-		if (*p == '\n')
+		unsigned int next = *p ? NextCodepoint(&p) : 0;
+		if (c == '\n')
 		{
 			// move the pen down by height, and reset x to zero
 			pen_x = 0;
 			pen_y -= 1;
 			cursor = 0;
 		}
-		else if (*p == 9)  // TAB
+		else if (c == 9)  // TAB
 		{
 			int numSpaces = TAB_SIZE - (cursor % TAB_SIZE);
-			struct GlyphMetrics* curr = FindGlyphMetrics(font, ' ');
+			const struct GlyphMetrics* curr = FindGlyphMetrics(font, ' ');
 			int i;
 			for (i = 0; i < numSpaces; ++i)
 			{				
@@ -227,16 +293,16 @@ void DrawString(struct Font* font, const char* str)
 		}
 		else
 		{
-			struct GlyphMetrics* curr = FindGlyphMetrics(font, *p);
+			const struct GlyphMetrics* curr = FindGlyphMetrics(font, c);
 			DrawGlyph(pen_x, pen_y, curr);
 
 			float kerning_x = 0;
 			float kerning_y = 0;
 			// look up in kerning table
-			if (!isspace(*(p+1)))
+			if (next && !(next < 128 && isspace(next)))
 			{
-				struct GlyphMetrics* next = FindGlyphMetrics(font, *(p+1));
-				KerningLookup(font, curr->char_index, next->char_index, &kerning_x, &kerning_y);
+				const struct GlyphMetrics* next_glyph = FindGlyphMetrics(font, next);
+				KerningLookup(font, curr->char_index, next_glyph->char_index, &kerning_x, &kerning_y);
 			}
 
 			// advance the pen
@@ -244,6 +310,7 @@ void DrawString(struct Font* font, const char* str)
 			pen_y += curr->advance[1] + kerning_y;
 			cursor++;
 		}
+		c = next;
 	}
 	glEnd();
 }
@@ -4,68 +4,341 @@
 
 #include "tga.h"
 
-// load the image header fields. We only keep those that matter!
-static void tgaLoadHeader(FILE *file, TGA_Info *info)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TGA_SSE2 1
+#endif
+
+// the 18 byte header, little endian
+enum
+{
+	HEADER_ID_LENGTH = 0,
+	HEADER_COLOR_MAP_TYPE = 1,
+	HEADER_IMAGE_TYPE = 2,
+	HEADER_COLOR_MAP_LENGTH = 5,
+	HEADER_COLOR_MAP_DEPTH = 7,
+	HEADER_WIDTH = 12,
+	HEADER_HEIGHT = 14,
+	HEADER_PIXEL_DEPTH = 16,
+	HEADER_SIZE = 18
+};
+
+// output is gathered into blocks of this size before it is written
+static const size_t kBufferSize = 1 << 16;
+
+// longest packet, the count is 7 bits plus one
+static const int kMaxPacket = 128;
+
+// copies width pixels from src to dest swapping the R and B of each one, RGB(A)
+// to BGR(A) and back.  src and dest may be the same.
+static void SwizzleRow(const unsigned char* src, int width, int mode, unsigned char* dest)
 {
-	unsigned char cGarbage;
-	short int iGarbage;
+	int x = 0;
+	if (mode == 4) {
+#ifdef TGA_SSE2
+		const __m128i ga = _mm_set1_epi32((int)0xff00ff00);
+		for (; x + 4 <= width; x += 4) {
+			__m128i p = _mm_loadu_si128((const __m128i*)(src + x * 4));
+			__m128i r = _mm_srli_epi32(_mm_slli_epi32(p, 24), 8);
+			__m128i b = _mm_srli_epi32(_mm_slli_epi32(p, 8), 24);
+			p = _mm_or_si128(_mm_and_si128(p, ga), _mm_or_si128(r, b));
+			_mm_storeu_si128((__m128i*)(dest + x * 4), p);
+		}
+#endif
+		for (; x < width; ++x) {
+			unsigned char aux = src[x * 4];
+			dest[x * 4] = src[x * 4 + 2];
+			dest[x * 4 + 1] = src[x * 4 + 1];
+			dest[x * 4 + 2] = aux;
+			dest[x * 4 + 3] = src[x * 4 + 3];
+		}
+	}
+	else {
+		for (; x < width; ++x) {
+			unsigned char aux = src[x * 3];
+			dest[x * 3] = src[x * 3 + 2];
+			dest[x * 3 + 1] = src[x * 3 + 1];
+			dest[x * 3 + 2] = aux;
+		}
+	}
+}
 
-	fread(&cGarbage, sizeof(unsigned char), 1, file);
-	fread(&cGarbage, sizeof(unsigned char), 1, file);
+// number of pixels from x on that equal pixel x, at most limit
+static int RunLength(const unsigned char* row, int x, int width, int mode, int limit)
+{
+	const unsigned char* pixel = row + (size_t)x * mode;
+	int run = 1;
+	while (run < limit && x + run < width && memcmp(pixel, pixel + (size_t)run * mode, mode) == 0)
+		run++;
+	return run;
+}
 
-// type must be 2 or 3
-	fread(&info->type, sizeof(unsigned char), 1, file);
+// run length encodes one row into dest, packets never cross rows.  A run of two
+// single byte pixels costs as much as leaving them in a raw packet, so greyscale
+// runs start at three.  Returns the encoded size, at most
+// width * mode + (width + kMaxPacket - 1) / kMaxPacket.
+static size_t EncodeRow(const unsigned char* row, int width, int mode, unsigned char* dest)
+{
+	const int minRun = mode == 1 ? 3 : 2;
+	size_t size = 0;
+	int x = 0;
+	while (x < width) {
+		int run = RunLength(row, x, width, mode, kMaxPacket);
+		if (run >= minRun) {
+			dest[size++] = (unsigned char)(0x80 | (run - 1));
+			memcpy(dest + size, row + (size_t)x * mode, mode);
+			size += mode;
+			x += run;
+			continue;
+		}
 
-	fread(&iGarbage, sizeof(short int), 1, file);
-	fread(&iGarbage, sizeof(short int), 1, file);
-	fread(&cGarbage, sizeof(unsigned char), 1, file);
-	fread(&iGarbage, sizeof(short int), 1, file);
-	fread(&iGarbage, sizeof(short int), 1, file);
+// raw pixels up to the start of the next run
+		int count = run;
+		while (count < kMaxPacket && x + count < width && RunLength(row, x + count, width, mode, minRun) < minRun)
+			count++;
+		dest[size++] = (unsigned char)(count - 1);
+		memcpy(dest + size, row + (size_t)x * mode, (size_t)count * mode);
+		size += (size_t)count * mode;
+		x += count;
+	}
+	return size;
+}
 
-	fread(&info->width, sizeof(short int), 1, file);
-	fread(&info->height, sizeof(short int), 1, file);
-	fread(&info->pixelDepth, sizeof(unsigned char), 1, file);
+// swizzles or encodes rows into a block buffer and writes it out as it fills up,
+// the caller's rows are only read.
+struct TgaWriter
+{
+	FILE* file;
+	int width, mode;
+	bool rle;
+	unsigned char* buffer;
+	size_t capacity, used;
+	unsigned char* row;     // swizzled row waiting to be encoded
+	bool ok;
+};
+
+static bool OpenWriter(TgaWriter* writer, int width, int mode, bool rle)
+{
+	const size_t rowBytes = (size_t)width * mode;
+	const size_t worstRow = rowBytes + (width + kMaxPacket - 1) / kMaxPacket;
+	writer->file = NULL;
+	writer->width = width;
+	writer->mode = mode;
+	writer->rle = rle;
+	writer->capacity = worstRow > kBufferSize ? worstRow : kBufferSize;
+	writer->used = 0;
+	writer->buffer = (unsigned char *)malloc(writer->capacity);
+	writer->row = (rle && mode >= 3) ? (unsigned char *)malloc(rowBytes) : NULL;
+	writer->ok = true;
+	return writer->buffer != NULL && (writer->row != NULL || !rle || mode < 3);
+}
 
-	fread(&cGarbage, sizeof(unsigned char), 1, file);
+static void Flush(TgaWriter* writer)
+{
+	if (writer->ok && writer->used > 0)
+		writer->ok = fwrite(writer->buffer, 1, writer->used, writer->file) == writer->used;
+	writer->used = 0;
 }
 
-// loads the image pixels. You shouldn't call this function
-// directly
-static void tgaLoadImageData(FILE *file, TGA_Info *info)
+static void WriteRows(TgaWriter* writer, const unsigned char* rows, int numRows)
 {
-	int mode,total,i;
-	unsigned char aux;
+	const size_t rowBytes = (size_t)writer->width * writer->mode;
+	const size_t worstRow = rowBytes + (writer->width + kMaxPacket - 1) / kMaxPacket;
+	for (int y = 0; y < numRows && writer->ok; ++y) {
+		const unsigned char* src = rows + (size_t)y * rowBytes;
+		if (writer->capacity - writer->used < worstRow)
+			Flush(writer);
+		unsigned char* dest = writer->buffer + writer->used;
+		if (!writer->rle) {
+			if (writer->mode >= 3)
+				SwizzleRow(src, writer->width, writer->mode, dest);
+			else
+				memcpy(dest, src, rowBytes);
+			writer->used += rowBytes;
+		}
+		else {
+			if (writer->mode >= 3) {
+				SwizzleRow(src, writer->width, writer->mode, writer->row);
+				src = writer->row;
+			}
+			writer->used += EncodeRow(src, writer->width, writer->mode, dest);
+		}
+	}
+}
 
-// mode equal the number of components for each pixel
-	mode = info->pixelDepth / 8;
-// total is the number of bytes we'll have to read
-	total = info->height * info->width * mode;
+static void CloseWriter(TgaWriter* writer)
+{
+	free(writer->buffer);
+	free(writer->row);
+}
+
+// type 2 for RGB(A), 3 for greyscale, plus 8 when run length encoded.  Everything
+// else in the header is zero.
+static void PackHeader(int width, int height, unsigned char pixelDepth, bool rle, unsigned char* header)
+{
+	memset(header, 0, HEADER_SIZE);
+	header[HEADER_IMAGE_TYPE] = (unsigned char)((((pixelDepth == 24) || (pixelDepth == 32)) ? 2 : 3) + (rle ? 8 : 0));
+	header[HEADER_WIDTH] = (unsigned char)(width & 0xff);
+	header[HEADER_WIDTH + 1] = (unsigned char)(width >> 8);
+	header[HEADER_HEIGHT] = (unsigned char)(height & 0xff);
+	header[HEADER_HEIGHT + 1] = (unsigned char)(height >> 8);
+	header[HEADER_PIXEL_DEPTH] = pixelDepth;
+}
 
-	fread(info->imageData,sizeof(unsigned char),total,file);
+// opens the file and writes the header, then leaves the pixels to writeRows
+static int SaveImage(const char* filename,
+					 int width,
+					 int height,
+					 unsigned char pixelDepth,
+					 bool rle,
+					 const std::function<void(TgaWriter*)>& writeRows)
+{
+	TgaWriter writer;
+	FILE *file;
 
-// mode=3 or 4 implies that the image is RGB(A). However TGA
-// stores it as BGR(A) so we'll have to swap R and B.
-	if (mode >= 3)
-		for (i=0; i < total; i+= mode) {
-			aux = info->imageData[i];
-			info->imageData[i] = info->imageData[i+2];
-			info->imageData[i+2] = aux;
+	if (width > 65535 || height > 65535)
+		return(TGA_ERROR_TOO_LARGE);
+
+	if (!OpenWriter(&writer, width, pixelDepth / 8, rle)) {
+		CloseWriter(&writer);
+		return(TGA_ERROR_MEMORY);
+	}
+
+	file = fopen(filename, "wb");
+	if (file == NULL) {
+		CloseWriter(&writer);
+		return(TGA_ERROR_FILE_OPEN);
+	}
+	writer.file = file;
+
+// the header goes out with the first block of pixels
+	PackHeader(width, height, pixelDepth, rle, writer.buffer);
+	writer.used = HEADER_SIZE;
+	writeRows(&writer);
+	Flush(&writer);
+
+	bool ok = writer.ok;
+	CloseWriter(&writer);
+	if (fclose(file) != 0)
+		ok = false;
+	return(ok ? TGA_OK : TGA_ERROR_WRITING_FILE);
+}
+
+// saves an array of pixels as a TGA image
+int TGA_Save(const char* filename,
+			 int width,
+			 int height,
+			 unsigned char pixelDepth,
+			 const unsigned char* imageData,
+			 bool rle)
+{
+	return SaveImage(filename, width, height, pixelDepth, rle, [&](TgaWriter* writer) {
+		WriteRows(writer, imageData, height);
+	});
+}
+
+// saves an image a band of rows at a time
+int TGA_SaveRows(const char* filename,
+				 int width,
+				 int height,
+				 unsigned char pixelDepth,
+				 const RowSource& source,
+				 int bandRows,
+				 bool rle)
+{
+	if (bandRows > height)
+		bandRows = height;
+	const size_t bandBytes = (size_t)bandRows * width * (pixelDepth / 8);
+	unsigned char* band = (unsigned char *)malloc(bandBytes > 0 ? bandBytes : 1);
+	if (band == NULL)
+		return(TGA_ERROR_MEMORY);
+
+	int status = SaveImage(filename, width, height, pixelDepth, rle, [&](TgaWriter* writer) {
+		for (int y = 0; y < height && writer->ok; y += bandRows) {
+			int rows = (height - y < bandRows) ? height - y : bandRows;
+			source(y, rows, band);
+			WriteRows(writer, band, rows);
+		}
+	});
+	free(band);
+	return(status);
+}
+
+// reads the file a block at a time for the run length decoder
+struct TgaReader
+{
+	FILE* file;
+	unsigned char buffer[kBufferSize];
+	size_t pos, end;
+};
+
+static bool Read(TgaReader* reader, unsigned char* dest, size_t size)
+{
+	while (size > 0) {
+		if (reader->pos == reader->end) {
+			reader->pos = 0;
+			reader->end = fread(reader->buffer, 1, sizeof(reader->buffer), reader->file);
+			if (reader->end == 0)
+				return false;
 		}
+		size_t count = reader->end - reader->pos;
+		if (count > size)
+			count = size;
+		memcpy(dest, reader->buffer + reader->pos, count);
+		reader->pos += count;
+		dest += count;
+		size -= count;
+	}
+	return true;
+}
+
+// expands total bytes of packets, which may cross rows, into dest.
+static bool DecodeRLE(FILE *file, int mode, size_t total, unsigned char* dest)
+{
+	TgaReader* reader = (TgaReader *)malloc(sizeof(TgaReader));
+	if (reader == NULL)
+		return false;
+	reader->file = file;
+	reader->pos = reader->end = 0;
+
+	size_t used = 0;
+	bool ok = true;
+	while (used < total && ok) {
+		unsigned char packet;
+		ok = Read(reader, &packet, 1);
+		size_t count = (size_t)(packet & 0x7f) + 1;
+		if (!ok || count * mode > total - used) {
+			ok = false;
+		}
+		else if (packet & 0x80) {
+			ok = Read(reader, dest + used, mode);
+			for (size_t i = 1; i < count; ++i)
+				memcpy(dest + used + i * mode, dest + used, mode);
+		}
+		else {
+			ok = Read(reader, dest + used, count * mode);
+		}
+		used += count * mode;
+	}
+	free(reader);
+	return ok;
 }
 
 // this is the function to call when we want to load
 // an image
 TGA_Info* TGA_Load(const char* filename)
 {
+	unsigned char header[HEADER_SIZE];
 	FILE *file;
 	TGA_Info *info;
-	int mode,total;
+	int mode;
+	size_t total, skip;
 
 // allocate memory for the info struct and check!
 	info = (TGA_Info *)malloc(sizeof(TGA_Info));
 	if (info == NULL)
 		return(NULL);
-
+	memset(info, 0, sizeof(TGA_Info));
 
 // open the file for reading (binary mode)
 	file = fopen(filename, "rb");
@@ -74,122 +347,79 @@ TGA_Info* TGA_Load(const char* filename)
 		return(info);
 	}
 
-// load the header
-	tgaLoadHeader(file,info);
-
-// check for errors when loading the header
-	if (ferror(file)) {
+// load the header in one go, we only keep the fields that matter!
+	if (fread(header, 1, HEADER_SIZE, file) != HEADER_SIZE) {
 		info->status = TGA_ERROR_READING_FILE;
 		fclose(file);
 		return(info);
 	}
+	info->type = header[HEADER_IMAGE_TYPE];
+	info->width = header[HEADER_WIDTH] | (header[HEADER_WIDTH + 1] << 8);
+	info->height = header[HEADER_HEIGHT] | (header[HEADER_HEIGHT + 1] << 8);
+	info->pixelDepth = header[HEADER_PIXEL_DEPTH];
 
 // check if the image is color indexed
-	if (info->type == 1) {
+	if (info->type == 1 || info->type == 9) {
 		info->status = TGA_ERROR_INDEXED_COLOR;
 		fclose(file);
 		return(info);
 	}
-// check for other types (compressed images)
-	if ((info->type != 2) && (info->type !=3)) {
+// check for the types and depths we can't read
+	mode = info->pixelDepth / 8;
+	if ((info->type != 2 && info->type != 3 && info->type != 10 && info->type != 11) ||
+		mode < 1 || mode > 4 || (info->pixelDepth & 7) != 0) {
 		info->status = TGA_ERROR_COMPRESSED_FILE;
 		fclose(file);
 		return(info);
 	}
 
-// mode equals the number of image components
-	mode = info->pixelDepth / 8;
-// total is the number of bytes to read
-	total = info->height * info->width * mode;
-// allocate memory for image pixels
-	info->imageData = (unsigned char *)malloc(sizeof(unsigned char) *
-											  total);
+// skip the image id and any color map, which true color images may still have
+	skip = header[HEADER_ID_LENGTH];
+	if (header[HEADER_COLOR_MAP_TYPE] != 0)
+		skip += (size_t)(header[HEADER_COLOR_MAP_LENGTH] | (header[HEADER_COLOR_MAP_LENGTH + 1] << 8)) *
+			((header[HEADER_COLOR_MAP_DEPTH] + 7) / 8);
+	if (skip > 0 && fseek(file, (long)skip, SEEK_CUR) != 0) {
+		info->status = TGA_ERROR_READING_FILE;
+		fclose(file);
+		return(info);
+	}
 
-// check to make sure we have the memory required
+// allocate memory for image pixels
+	total = (size_t)info->width * info->height * mode;
+	info->imageData = (unsigned char *)malloc(total > 0 ? total : 1);
 	if (info->imageData == NULL) {
 		info->status = TGA_ERROR_MEMORY;
 		fclose(file);
 		return(info);
 	}
-// finally load the image pixels
-	tgaLoadImageData(file,info);
 
-// check for errors when reading the pixels
-	if (ferror(file)) {
+// load the image pixels, then swap B and R of RGB(A) images back
+	bool ok;
+	if (info->type >= 9)
+		ok = DecodeRLE(file, mode, total, info->imageData);
+	else
+		ok = fread(info->imageData, 1, total, file) == total;
+	fclose(file);
+	if (!ok) {
 		info->status = TGA_ERROR_READING_FILE;
-		fclose(file);
 		return(info);
 	}
-	fclose(file);
+	if (mode >= 3)
+		for (int y = 0; y < info->height; ++y) {
+			unsigned char* row = info->imageData + (size_t)y * info->width * mode;
+			SwizzleRow(row, info->width, mode, row);
+		}
+
 	info->status = TGA_OK;
 	return(info);
 }
 
-// saves an array of pixels as a TGA image
-int TGA_Save(const char* filename,
-			 short int width,
-			 short int height,
-			 unsigned char pixelDepth,
-			 unsigned char* imageData)
-{
-    unsigned char cGarbage = 0, type,mode,aux;
-    short int iGarbage = 0;
-    int i;
-    FILE *file;
-
-// open file and check for errors
-    file = fopen(filename, "wb");
-    if (file == NULL) {
-        return(TGA_ERROR_FILE_OPEN);
-    }
-
-// compute image type: 2 for RGB(A), 3 for greyscale
-    mode = pixelDepth / 8;
-    if ((pixelDepth == 24) || (pixelDepth == 32))
-        type = 2;
-    else
-        type = 3;
-
-// write the header
-    fwrite(&cGarbage, sizeof(unsigned char), 1, file);
-    fwrite(&cGarbage, sizeof(unsigned char), 1, file);
-
-    fwrite(&type, sizeof(unsigned char), 1, file);
-
-    fwrite(&iGarbage, sizeof(short int), 1, file);
-    fwrite(&iGarbage, sizeof(short int), 1, file);
-    fwrite(&cGarbage, sizeof(unsigned char), 1, file);
-    fwrite(&iGarbage, sizeof(short int), 1, file);
-    fwrite(&iGarbage, sizeof(short int), 1, file);
-
-    fwrite(&width, sizeof(short int), 1, file);
-    fwrite(&height, sizeof(short int), 1, file);
-    fwrite(&pixelDepth, sizeof(unsigned char), 1, file);
-
-    fwrite(&cGarbage, sizeof(unsigned char), 1, file);
-
-// convert the image data from RGB(a) to BGR(A)
-    if (mode >= 3)
-        for (i=0; i < width * height * mode ; i+= mode) {
-            aux = imageData[i];
-            imageData[i] = imageData[i+2];
-            imageData[i+2] = aux;
-        }
-
-// save the image data
-    fwrite(imageData, sizeof(unsigned char),
-           width * height * mode, file);
-    fclose(file);
-
-    return(TGA_OK);
-}
-
 // releases the memory used for the image
 void TGA_Destroy(TGA_Info *info) {
 
-    if (info != NULL) {
-        if (info->imageData != NULL)
-            free(info->imageData);
-        free(info);
-    }
+	if (info != NULL) {
+		if (info->imageData != NULL)
+			free(info->imageData);
+		free(info);
+	}
 }
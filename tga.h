@@ -4,13 +4,17 @@
 #ifndef TGAH
 #define TGAH
 
+#include "stream.h"
+
 enum
 {
 	TGA_ERROR_FILE_OPEN,
 	TGA_ERROR_READING_FILE,
 	TGA_ERROR_INDEXED_COLOR,
 	TGA_ERROR_MEMORY,
-	TGA_ERROR_COMPRESSED_FILE,
+	TGA_ERROR_COMPRESSED_FILE,	// an image type or pixel depth other than the ones below
+	TGA_ERROR_TOO_LARGE,
+	TGA_ERROR_WRITING_FILE,
 	TGA_OK
 };
 
@@ -18,20 +22,35 @@ struct TGA_Info
 {
 	int status;
 	unsigned char type, pixelDepth;
-	short int width, height;
+	int width, height;
 	unsigned char* imageData;
 };
 
+// loads 8, 16, 24 or 32 bit images, uncompressed (type 2 and 3) or run length
+// encoded (type 10 and 11).  Color images are returned as RGB(A).
 TGA_Info* TGA_Load(const char *filename);
 
 void TGA_Destroy(TGA_Info *info);
 
+// saves RGB(A) or greyscale pixels, imageData is left untouched.  With rle set the
+// file is run length encoded, type 10 or 11, one row at a time.
 int TGA_Save(const char* filename,
-			 short int width,
-			 short int height,
+			 int width,
+			 int height,
 			 unsigned char pixelDepth,
-			 unsigned char* imageData);
+			 const unsigned char* imageData,
+			 bool rle = false);
+
+// saves a width x height image read from source in bands of bandRows rows, so it
+// never has to be in memory as a whole.  Rows are written in the order source
+// gives them, the same as TGA_Save.  The header only holds 16 bit sizes, larger
+// images return TGA_ERROR_TOO_LARGE.
+int TGA_SaveRows(const char* filename,
+				 int width,
+				 int height,
+				 unsigned char pixelDepth,
+				 const RowSource& source,
+				 int bandRows,
+				 bool rle = false);
 
 #endif
-
-
@@ -0,0 +1,226 @@
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+struct TraceEvent
+{
+    const char* name;
+    std::string detail;
+    int64_t start;      // microseconds since TRACE_Enable
+    int64_t duration;
+    int thread;
+};
+
+struct TracePhase
+{
+    const char* name;
+    uint64_t calls;
+    int64_t total;      // microseconds, summed over every thread
+};
+
+static bool s_enabled = false;
+static bool s_events = false;
+static std::chrono::steady_clock::time_point s_epoch;
+static std::atomic<uint64_t> s_counters[TRACE_NUM_COUNTERS];
+static std::atomic<int> s_nextThread(0);
+static std::mutex s_mutex;
+static std::vector<TraceEvent> s_eventList;
+static std::vector<TracePhase> s_phases;
+
+static const char* kCounterNames[TRACE_NUM_COUNTERS] =
+{
+    "glyphs rendered", "glyphs from cache", "glyphs sharing a slot", "kerning pairs", "files written", "bytes written"
+};
+
+static int64_t Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+}
+
+// small ids in the order threads first record something, easier to read than the os ids
+static int ThreadId()
+{
+    static thread_local int id = -1;
+    if (id < 0)
+        id = s_nextThread++;
+    return id;
+}
+
+void TRACE_Enable(bool events)
+{
+    s_enabled = true;
+    s_events = events;
+    s_epoch = std::chrono::steady_clock::now();
+    for (int i = 0; i < TRACE_NUM_COUNTERS; ++i)
+        s_counters[i] = 0;
+    ThreadId();
+}
+
+bool TRACE_Enabled()
+{
+    return s_enabled;
+}
+
+void TRACE_Count(TraceCounter counter, uint64_t value)
+{
+    if (s_enabled)
+        s_counters[counter] += value;
+}
+
+void TRACE_CountFile(const char* filename)
+{
+    if (!s_enabled)
+        return;
+    s_counters[TRACE_FILES_WRITTEN] += 1;
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(filename, &st) == 0)
+        s_counters[TRACE_BYTES_WRITTEN] += (uint64_t)st.st_size;
+#else
+    struct stat st;
+    if (stat(filename, &st) == 0)
+        s_counters[TRACE_BYTES_WRITTEN] += (uint64_t)st.st_size;
+#endif
+}
+
+TraceScope::TraceScope(const char* name, const char* detail) :
+    m_name(name), m_detail(detail), m_start(0)
+{
+    if (s_enabled)
+        m_start = Now();
+}
+
+TraceScope::~TraceScope()
+{
+    if (!s_enabled)
+        return;
+
+    const int64_t duration = Now() - m_start;
+    const int thread = ThreadId();
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    // names are literals, so the same phase always has the same pointer
+    size_t i = 0;
+    while (i < s_phases.size() && s_phases[i].name != m_name)
+        i++;
+    if (i == s_phases.size())
+    {
+        TracePhase phase = { m_name, 0, 0 };
+        s_phases.push_back(phase);
+    }
+    s_phases[i].calls++;
+    s_phases[i].total += duration;
+
+    if (s_events)
+    {
+        TraceEvent event;
+        event.name = m_name;
+        if (m_detail)
+            event.detail = m_detail;
+        event.start = m_start;
+        event.duration = duration;
+        event.thread = thread;
+        s_eventList.push_back(event);
+    }
+}
+
+uint64_t TRACE_PeakRSS()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (uint64_t)counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void TRACE_PrintStats(FILE* fp)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    fprintf(fp, "Stats : %.1f ms wall, phases that run side by side add up their threads\n", Now() / 1000.0);
+    for (size_t i = 0; i < s_phases.size(); ++i)
+        fprintf(fp, "    %-24s %6llu calls %10.1f ms\n", s_phases[i].name, (unsigned long long)s_phases[i].calls,
+                s_phases[i].total / 1000.0);
+    for (int i = 0; i < TRACE_NUM_COUNTERS; ++i)
+        fprintf(fp, "    %-24s %llu\n", kCounterNames[i], (unsigned long long)s_counters[i].load());
+    fprintf(fp, "    %-24s %.1f MB\n", "peak rss", TRACE_PeakRSS() / (1024.0 * 1024.0));
+}
+
+static void WriteJSONString(FILE* fp, const char* text)
+{
+    fputc('"', fp);
+    for (const char* c = text; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', fp);
+        if ((unsigned char)*c >= 0x20)
+            fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+bool TRACE_WriteChrome(const char* filename)
+{
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL)
+        return false;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    const int64_t end = Now();
+    fprintf(fp, "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n");
+    fprintf(fp, "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": { \"name\": \"swiftglyph\" } }");
+    for (size_t i = 0; i < s_eventList.size(); ++i)
+    {
+        const TraceEvent& event = s_eventList[i];
+        fprintf(fp, ",\n{ \"name\": ");
+        WriteJSONString(fp, event.name);
+        fprintf(fp, ", \"cat\": \"swiftglyph\", \"ph\": \"X\", \"ts\": %lld, \"dur\": %lld, \"pid\": 1, \"tid\": %d",
+                (long long)event.start, (long long)event.duration, event.thread);
+        if (!event.detail.empty())
+        {
+            fprintf(fp, ", \"args\": { \"detail\": ");
+            WriteJSONString(fp, event.detail.c_str());
+            fprintf(fp, " }");
+        }
+        fprintf(fp, " }");
+    }
+
+    // counters only have their totals, shown as a single step at the end of the run
+    for (int i = 0; i < TRACE_NUM_COUNTERS; ++i)
+    {
+        fprintf(fp, ",\n{ \"name\": \"%s\", \"ph\": \"C\", \"ts\": %lld, \"pid\": 1, \"args\": { \"value\": %llu } }",
+                kCounterNames[i], (long long)end, (unsigned long long)s_counters[i].load());
+    }
+    fprintf(fp, ",\n{ \"name\": \"peak rss MB\", \"ph\": \"C\", \"ts\": %lld, \"pid\": 1, \"args\": { \"value\": %.1f } }",
+            (long long)end, TRACE_PeakRSS() / (1024.0 * 1024.0));
+    fprintf(fp, "\n]\n}\n");
+    return fclose(fp) == 0;
+}
@@ -0,0 +1,62 @@
+// Phase timers and counters behind -stats and -trace.
+
+#ifndef TRACEH
+#define TRACEH
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum TraceCounter
+{
+    TRACE_GLYPHS_RENDERED,      // glyphs rasterized by FreeType
+    TRACE_GLYPHS_CACHED,        // glyphs taken from the -cache directory instead
+    TRACE_GLYPHS_SHARED,        // glyphs packed into the atlas slot of an identical bitmap
+    TRACE_KERNING_PAIRS,        // non-zero kerning pairs found
+    TRACE_FILES_WRITTEN,
+    TRACE_BYTES_WRITTEN,
+    TRACE_NUM_COUNTERS
+};
+
+// turns on the per phase totals printed by TRACE_PrintStats and, with events set,
+// the timeline written by TRACE_WriteChrome.  Until then scopes and counters cost
+// a single flag test.  Call before any other thread starts.
+void TRACE_Enable(bool events);
+bool TRACE_Enabled();
+
+void TRACE_Count(TraceCounter counter, uint64_t value);
+
+// counts a finished output file and its size on disk.
+void TRACE_CountFile(const char* filename);
+
+// times the enclosing block under name, which must be a string literal.  detail,
+// if not NULL, is copied into the trace event, e.g. the file being written.
+// Scopes may nest and may run on any thread.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name, const char* detail = NULL);
+    ~TraceScope();
+
+private:
+    const char* m_name;
+    const char* m_detail;
+    int64_t m_start;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_DETAIL(name, detail) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, detail)
+
+// peak resident set size of the process in bytes, 0 where it isn't available.
+uint64_t TRACE_PeakRSS();
+
+// the total time and calls of every phase in the order they first ran, then the
+// counters and peak rss.
+void TRACE_PrintStats(FILE* fp);
+
+// writes every scope as a complete event and the counters as counter events in
+// chrome trace event format, for chrome://tracing, perfetto or speedscope.
+bool TRACE_WriteChrome(const char* filename);
+
+#endif